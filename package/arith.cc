@@ -11,97 +11,54 @@
 #include "ptpd.hh"
 
 
+/* 
+ * TimeNs is the time the servo computes with, as a signed count of
+ * nanoseconds. unlike TimeInternal it needs no normalizing, and the
+ * conversions below are exact
+ */
+TimeNs 
+internalTimeToNs(const TimeInternal * internal)
+{
+	return (TimeNs)internal->seconds * 1000000000 + internal->nanoseconds;
+}
+
 void 
-integer64_to_internalTime(Integer64 bigint, TimeInternal * internal)
+nsToInternalTime(TimeNs ns, TimeInternal * internal)
 {
-	int s_msb;
-	double ns_msb;
-	int entire;
-	char *p_lsb, *p_msb;
-	bool negative = FALSE;
-
-	p_lsb = (char *)&bigint.lsb;
-	/* lsb type is unsigned int */
-	p_msb = (char *)&bigint.msb;
-	/* msb type is int */
-	/* Test if bigint is a negative number */
-	negative = ((bigint.msb & 0x80000000) == 0x80000000);
-
-	if (!negative) {
-		/* Positive case */
-
-		/* fractional nanoseconds are excluded (see 5.3.2) */
-		bigint.lsb = bigint.lsb >> 16;
-		/*
-		 * copy two least significant octet of msb to most
-		 * significant octet of lsb
-		 */
-		*(p_lsb + 2) = *p_msb;
-		*(p_lsb + 3) = *(p_msb + 1);
-		bigint.msb = bigint.msb >> 16;
-		internal->nanoseconds = bigint.lsb % 1000000000;
-		internal->seconds = bigint.lsb / 1000000000;
-
-		/* (2^32 / 10^9) = 4,294967296 */
-		s_msb = 4 * bigint.msb;
-		ns_msb = 0.294967296 * (double)bigint.msb;
-		entire = (int)ns_msb;
-		s_msb += entire;
-		ns_msb -= entire;
-		ns_msb *= 1000000000;
-		internal->nanoseconds = (float)internal->nanoseconds + 
-			(float)ns_msb;
-		internal->seconds += s_msb;
-		normalizeTime(internal);
+	/* both parts take the sign of 'ns', as normalizeTime() leaves them */
+	internal->seconds = ns / 1000000000;
+	internal->nanoseconds = ns % 1000000000;
+}
 
-	}
-	/* End of positive Case */
-
-	else {				/* Negative case */
-
-		/* Take the two complement */
-		bigint.lsb = ~bigint.lsb;
-		bigint.msb = ~bigint.msb;
-
-		if (bigint.lsb == 0xffffffff) {
-			bigint.lsb = 0;
-			bigint.msb++;
-		} else {
-			bigint.lsb++;
-		}
-
-		/* fractional nanoseconds are excluded (see 5.3.2) */
-		bigint.lsb = bigint.lsb >> 16;
-		/*
-		 * copy two least significant octet of msb to most
-		 * significant octet of lsb
-		 */
-		*(p_lsb + 2) = *p_msb;
-		*(p_lsb + 3) = *(p_msb + 1);
-		bigint.msb = bigint.msb >> 16;
-
-		internal->nanoseconds = bigint.lsb % 1000000000;
-		internal->seconds = bigint.lsb / 1000000000;
-
-		/* (2^32 / 10^9) = 4,294967296 */
-		s_msb = 4 * bigint.msb;
-		ns_msb = 0.294967296 * (double)bigint.msb;
-		entire = (int)ns_msb;
-		s_msb += entire;
-		ns_msb -= entire;
-		ns_msb *= 1000000000;
-
-		internal->nanoseconds = (float)internal->nanoseconds + 
-			(float)ns_msb;
-		internal->seconds += s_msb;
-		normalizeTime(internal);
-
-		internal->nanoseconds = -internal->nanoseconds;
-		internal->seconds = -internal->seconds;
-	}
-	/* End of negative Case */
+/* the correctionField is in 2^-16 ns (5.3.2) */
+TimeNs 
+integer64ToNs(Integer64 bigint)
+{
+	int64_t scaled = (int64_t)(((uint64_t)(UInteger32)bigint.msb << 32) |
+				   bigint.lsb);
+
+	/* fractional nanoseconds are excluded, towards zero as before */
+	return scaled / 65536;
 }
 
+/* 
+ * FALSE if the seconds of 'external' don't fit, TimeNs reaches until
+ * the year 2262
+ */
+bool 
+timestampToNs(const PTP_Timestamp * external, TimeNs * ns)
+{
+	uint64_t seconds = ((uint64_t)external->secondsField.msb << 32) |
+		external->secondsField.lsb;
+
+	if (seconds > INT64_MAX / 1000000000) {
+		DBG("Clock servo canno't be executed : "
+		    "seconds field is higher than 64 bits of nanoseconds \n");
+		return FALSE;
+	}
+	*ns = (TimeNs)seconds * 1000000000 + external->nanosecondsField;
+	return TRUE;
+}
 
 void 
 fromInternalTime(TimeInternal * internal, PTP_Timestamp * external)
@@ -129,21 +86,6 @@ fromInternalTime(TimeInternal * internal, PTP_Timestamp * external)
 
 }
 
-void 
-toInternalTime(TimeInternal * internal, PTP_Timestamp * external)
-{
-
-	/* Program will not run after 2038... */
-	if (external->secondsField.lsb < INT_MAX) {
-		internal->seconds = external->secondsField.lsb;
-		internal->nanoseconds = external->nanosecondsField;
-	} else {
-		DBG("Clock servo canno't be executed : "
-		    "seconds field is higher than signed integer (32bits) \n");
-		return;
-	}
-}
-
 void 
 normalizeTime(TimeInternal * r)
 {
@@ -177,24 +119,16 @@ subTime(TimeInternal * r, TimeInternal * x, TimeInternal * y)
 	normalizeTime(r);
 }
 
-/// Divide an internal time value
+/// Compare two normalized internal time values
 ///
-/// @param r the time to convert
-/// @param divisor 
+/// @param a 
+/// @param b 
 ///
-void
-divTime(TimeInternal *r, int divisor)
+/// @return TRUE if a is earlier than b
+///
+bool
+timeBefore(const TimeInternal *a, const TimeInternal *b)
 {
-
-	uint64_t nanoseconds;
-
-	if (divisor <= 0)
-		return;
-
-	nanoseconds = ((uint64_t)r->seconds * 1000000000) + r->nanoseconds;
-	nanoseconds /= divisor;
-
-	r->seconds = nanoseconds / 1000000000;
-	r->nanoseconds = nanoseconds % 1000000000;
-
+	return a->seconds < b->seconds ||
+		(a->seconds == b->seconds && a->nanoseconds < b->nanoseconds);
 }
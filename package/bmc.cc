@@ -65,8 +65,7 @@ void initData(RunTimeOpts *rtOpts, PtpClock *ptpClock)
 
 	ptpClock->logMinDelayReqInterval = DEFAULT_DELAYREQ_INTERVAL;
 
-	ptpClock->peerMeanPathDelay.seconds = 0;
-	ptpClock->peerMeanPathDelay.nanoseconds = 0;
+	ptpClock->peerMeanPathDelay = 0;
 
 	ptpClock->logAnnounceInterval = rtOpts->announceInterval;
 	ptpClock->announceReceiptTimeout = DEFAULT_ANNOUNCE_RECEIPT_TIMEOUT;
@@ -93,10 +92,8 @@ void m1(PtpClock *ptpClock)
 {
 	/*Current data set update*/
 	ptpClock->stepsRemoved = 0;
-	ptpClock->offsetFromMaster.nanoseconds = 0;
-	ptpClock->offsetFromMaster.seconds = 0;
-	ptpClock->meanPathDelay.nanoseconds = 0;
-	ptpClock->meanPathDelay.seconds = 0;
+	ptpClock->offsetFromMaster = 0;
+	ptpClock->meanPathDelay = 0;
 
 	/*Parent data set*/
 	memcpy(ptpClock->parentPortIdentity.clockIdentity,
@@ -118,6 +115,9 @@ void m1(PtpClock *ptpClock)
 
 	/*Time Properties data set*/
 	ptpClock->timeSource = INTERNAL_OSCILLATOR;
+
+	/* our Announce now carries this data set */
+	msgPackTemplates(ptpClock);
 }
 
 
@@ -155,6 +155,9 @@ void s1(MsgHeader *header,MsgAnnounce *announce,PtpClock *ptpClock)
 	ptpClock->frequencyTraceable = ((header->flagField[1] & 0x20) == 0x20);
 	ptpClock->ptpTimescale = ((header->flagField[1] & 0x08) == 0x08);
 	ptpClock->timeSource = announce->timeSource;
+
+	/* our Announce now carries this data set */
+	msgPackTemplates(ptpClock);
 }
 
 
@@ -51,12 +51,26 @@
 
 
 #define DEFAULT_MAX_FOREIGN_RECORDS  	5
+#define DEFAULT_UNICAST_DURATION	300    /* in s, requested and most granted */
+#define DEFAULT_UNICAST_MAX_SLAVES	1024
+#define UNICAST_RETRY_INTERVAL		1      /* in s, until a request is granted */
+#define STATE_SAVE_INTERVAL		60     /* in s, between checkpoints to the state file */
+#define STATE_MAX_AGE			86400  /* in s, older state files are ignored */
+#define UNICAST_MAX_BURST		256    /* unicast messages sent per step */
+#define UNICAST_SYNC_RING		1024   /* Syncs awaiting their send time, power of 2 */
 #define DEFAULT_PARENTS_STATS			FALSE
+#define SERVO_LINREG_WINDOW		16     /* samples the regression servo fits */
+#define DEFAULT_KALMAN_PROCESS_NOISE	1      /* ppb/sqrt(s) of frequency wander */
+#define DEFAULT_KALMAN_MEASUREMENT_NOISE 0     /* ns, 0 = learned from the delay */
+#define FAST_LOCK_SAMPLES		8      /* Syncs the first frequency estimate is fitted to */
+#define CONVERGED_OFFSET		10000  /* in ns, offset within which the clock has converged */
+#define CONVERGED_SAMPLES		4      /* ... for so many Syncs in a row */
 
 /* features, only change to refelect changes in implementation */
 #define NUMBER_PORTS      	1
 #define VERSION_PTP       	2
 #define TWO_STEP_FLAG    	0x02
+#define UNICAST_FLAG    	0x04
 #define BOUNDARY_CLOCK    	FALSE
 #define SLAVE_ONLY		FALSE
 #define NO_ADJUST		FALSE
@@ -77,6 +91,8 @@
 #define PDELAY_RESP_LENGTH 				54
 #define PDELAY_RESP_FOLLOW_UP_LENGTH  			54
 #define MANAGEMENT_LENGTH				48
+#define SIGNALING_LENGTH				44
+#define MESSAGE_TEMPLATE_LENGTH				ANNOUNCE_LENGTH /* the longest of them */
 /** \}*/
 
 /*Enumeration defined in tables of the spec*/
@@ -123,6 +139,8 @@ enum {
   SYNC_INTERVAL_TIMER,/**<\brief Timer handling Interval between master sends two Syncs messages */
   ANNOUNCE_RECEIPT_TIMER,/**<\brief Timer handling announce receipt timeout*/
   ANNOUNCE_INTERVAL_TIMER, /**<\brief Timer handling interval before master sends two announce messages*/
+  UNICAST_REQUEST_TIMER, /**<\brief Timer handling when a unicast slave renews its grants (non-spec)*/
+  STATE_SAVE_TIMER, /**<\brief Timer handling checkpoints to the state file (non-spec)*/
   TIMER_ARRAY_SIZE  /* this one is non-spec */
 };
 
@@ -155,4 +173,33 @@ enum {
   PTP_ETHER,PTP_DEFAULT
 };
 
+/**
+ * \brief TLV types of unicast negotiation (Table 34 and 16.1 in the spec)*/
+enum {
+	REQUEST_UNICAST_TRANSMISSION=0x0004,
+	GRANT_UNICAST_TRANSMISSION,
+	CANCEL_UNICAST_TRANSMISSION,
+	ACKNOWLEDGE_CANCEL_UNICAST_TRANSMISSION
+};
+
+#define TLV_HEADER_LENGTH				4
+#define REQUEST_UNICAST_TLV_LENGTH			6
+#define GRANT_UNICAST_TLV_LENGTH			8
+#define CANCEL_UNICAST_TLV_LENGTH			2
+#define GRANT_RENEWAL_INVITED				0x01
+
+/**
+ * \brief Message streams a unicast master grants (non-spec)*/
+enum {
+	UNICAST_ANNOUNCE=0, UNICAST_SYNC, UNICAST_DELAY_RESP,
+	UNICAST_GRANT_TYPES
+};
+
+/**
+ * \brief Clock servos, see servo.c (non-spec)*/
+enum {
+	SERVO_PI=0, SERVO_LINREG, SERVO_KALMAN,
+	SERVO_TYPES
+};
+
 #endif /*CONSTANTS_H_*/
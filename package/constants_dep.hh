@@ -19,10 +19,21 @@
 #error Not ported to this architecture, please update.
 #endif
 
+/* the event loop (net.c) is built on epoll and timerfd */
+#if !defined(linux)
+#error The epoll/timerfd event loop is only implemented for linux.
+#endif
+
 #ifdef	linux
 #include<netinet/in.h>
 #include<net/if.h>
 #include<net/if_arp.h>
+#include<sys/epoll.h>
+#include<sys/timerfd.h>
+#include<linux/net_tstamp.h>
+#include<linux/errqueue.h>
+#include<netpacket/packet.h>
+#include<linux/filter.h>
 
 #define IFACE_NAME_LENGTH         IF_NAMESIZE
 #define NET_ADDRESS_LENGTH        INET_ADDRSTRLEN
@@ -69,6 +80,8 @@
 
 #define CLOCK_IDENTITY_LENGTH 8
 #define ADJ_FREQ_MAX  512000
+/* kernel PLL time constant, the loop settles in about 2^(2+n) s */
+#define KERNEL_PLL_CONSTANT  0
 
 /* UDP/IPv4 dependent */
 
@@ -86,8 +99,41 @@
 #define DEFAULT_PTP_DOMAIN_ADDRESS     "224.0.1.129"
 #define PEER_PTP_DOMAIN_ADDRESS     "224.0.0.107"
 
+/* UDP/IPv6 dependent, see Annex E of the spec */
+
+#define NET_ADDRESS6_LENGTH       INET6_ADDRSTRLEN
+
+/* FF0X::181, X is the multicast scope (printf format, scope argument) */
+#define DEFAULT_PTP_DOMAIN_ADDRESS6   "FF%02X::181"
+#define PEER_PTP_DOMAIN_ADDRESS6      "FF02::6B"
+#define DEFAULT_IPV6_SCOPE            0x0E   /* global */
+
 #define MM_STARTING_BOUNDARY_HOPS  0x7fff
 
+/* IEEE 802.3 (Ethernet) dependent, see Annex F of the spec */
+
+#define PTP_ETHER_TYPE           0x88F7
+#define ETHER_ADDRESS_LENGTH     6
+#define ETHER_HEADER_LENGTH      14
+
+#define DEFAULT_PTP_ETHER_ADDRESS  { 0x01, 0x1B, 0x19, 0x00, 0x00, 0x00 }
+#define PEER_PTP_ETHER_ADDRESS     { 0x01, 0x80, 0xC2, 0x00, 0x00, 0x0E }
+
+/* event loop: NetPath.ready bits, and how many events one netSelect() takes */
+#define NET_EVENT_READY    0x01
+#define NET_GENERAL_READY  0x02
+#define NET_TXTS_READY     0x04   /* send time stamps on the error queue */
+#define NET_MAX_EVENTS     4
+
+/* receive batching: messages per recvmmsg() call, and control buffer per message */
+#define NET_MAX_BATCH      32
+#define DEFAULT_RX_BATCH   8
+#define NET_CONTROL_SIZE   256
+
+/* socket filter: room for the program, and the offset of the PTP message */
+#define NET_FILTER_LENGTH  32
+#define UDP_HEADER_LENGTH  8
+
 /* others */
 
 #define SCREEN_BUFSZ  128
@@ -176,6 +176,18 @@ typedef struct {
 }MsgSignaling;
 
 
+/* brief Unicast negotiation TLV fields (Tables 73 to 76 of the spec) */
+/*Request/Grant/Cancel/Acknowledge cancel unicast transmission TLV*/
+typedef struct {
+	Enumeration16 tlvType;
+	UInteger16 lengthField;
+	Enumeration4 messageType;
+	Integer8 logInterMessagePeriod;
+	UInteger32 durationField;
+	UInteger8 flags;  /* GRANT_RENEWAL_INVITED, grant only */
+}MsgUnicastTLV;
+
+
 /* brief Management message fields (Table 37 of the spec) */
 /*management Message*/
 typedef struct {
@@ -188,19 +200,39 @@ typedef struct {
 
 
 
-/* brief Time structure to handle Linux time information */
+/* brief Structure used as a timer, deadline is on the monotonic clock */
 typedef struct {
-  Integer32 seconds;
-  Integer32 nanoseconds;
-} TimeInternal;
+  TimeInternal interval;
+  TimeInternal deadline;
+  bool running;
+  bool expire;
+} IntervalTimer;
 
 
-/* brief Structure used as a timer */
+/* brief One message stream granted to a unicast slave (spec 16.1) */
 typedef struct {
-  float interval;
-  float left;
-  bool expire;
-} IntervalTimer;
+  bool granted;
+  Integer8 logInterMessagePeriod;
+  TimeInternal expiry;     /* on the monotonic clock */
+  Integer32 heapPos;       /* index in the send schedule, -1 if none */
+} UnicastGrant;
+
+/* brief A slave with grants from this master, see unicast.c */
+typedef struct {
+  PortIdentity portIdentity;
+  NetAddress addr;
+  UnicastGrant grant[UNICAST_GRANT_TYPES];
+} UnicastSlave;
+
+/* 
+ * brief An entry of the send schedule, a binary min-heap on deadline:
+ * the next Announce/Sync to send, or the expiry of a DelayResp grant
+ */
+typedef struct {
+  TimeInternal deadline;
+  Integer32 slave;
+  UInteger8 grant;
+} UnicastEvent;
 
 
 /* brief ForeignMasterRecord is used to manage foreign masters */
@@ -242,8 +274,8 @@ typedef struct {
 
 	/*Dynamic members*/
 	UInteger16 stepsRemoved;
-	TimeInternal offsetFromMaster;
-	TimeInternal meanPathDelay;
+	TimeNs offsetFromMaster;
+	TimeNs meanPathDelay;
 
 	/* Parent data set */
 
@@ -277,7 +309,7 @@ typedef struct {
 	/*Dynamic members*/
 	Enumeration8 portState;
 	Integer8 logMinDelayReqInterval;
-	TimeInternal peerMeanPathDelay;
+	TimeNs peerMeanPathDelay;
  
 	/*Configurable members*/
 	Integer8 logAnnounceInterval;
@@ -300,6 +332,9 @@ typedef struct {
 
 
 	MsgHeader msgTmpHeader;
+	NetAddress msgTmpSource;   /* sender of the message being handled */
+	Octet *msgRecv;            /* the message being handled, read in place */
+	NetAddress parentAddr;     /* where the parent's Sync/Announce come from */
 	
 	//union {
 		MsgSync  sync;
@@ -317,26 +352,28 @@ typedef struct {
 
 	Octet msgObuf[PACKET_SIZE];
 	Octet msgIbuf[PACKET_SIZE];
+	/* the messages we send, pre-encoded by messageType, see msgPackTemplates() */
+	Octet msgTemplate[16][MESSAGE_TEMPLATE_LENGTH];
 
-	TimeInternal  master_to_slave_delay;
-	TimeInternal  slave_to_master_delay;
+	TimeNs  master_to_slave_delay;
+	TimeNs  slave_to_master_delay;
 	Integer32     observed_drift;
 
-	TimeInternal  pdelay_req_receive_time;
-	TimeInternal  pdelay_req_send_time;
-	TimeInternal  pdelay_resp_receive_time;
-	TimeInternal  pdelay_resp_send_time;
-	TimeInternal  sync_receive_time;
-	TimeInternal  delay_req_send_time;
-	TimeInternal  delay_req_receive_time;
+	TimeNs  pdelay_req_receive_time;
+	TimeNs  pdelay_req_send_time;
+	TimeNs  pdelay_resp_receive_time;
+	TimeNs  pdelay_resp_send_time;
+	TimeNs  sync_receive_time;
+	TimeNs  delay_req_send_time;
+	TimeNs  delay_req_receive_time;
 	MsgHeader	PdelayReqHeader;
 	MsgHeader 	delayReqHeader;
-	TimeInternal	pdelayMS;
-	TimeInternal	pdelaySM;
-	TimeInternal  delayMS;
-	TimeInternal	delaySM;
-	TimeInternal  lastSyncCorrectionField;
-	TimeInternal  lastPdelayRespCorrectionField;
+	TimeNs	pdelayMS;
+	TimeNs	pdelaySM;
+	TimeNs  delayMS;
+	TimeNs	delaySM;
+	TimeNs  lastSyncCorrectionField;
+	TimeNs  lastPdelayRespCorrectionField;
 
 
 	double  R;
@@ -346,17 +383,49 @@ typedef struct {
 	UInteger16  sentDelayReqSequenceId;
 	UInteger16  sentSyncSequenceId;
 	UInteger16  sentAnnounceSequenceId;
+	UInteger16  sentSignalingSequenceId;
 	UInteger16  recvPDelayReqSequenceId;
 	UInteger16  recvSyncSequenceId;
 	bool  waitingForFollow;
 
 	offset_from_master_filter  ofm_filt;
 	one_way_delay_filter  owd_filt;
+	linreg_servo  linreg;
+	kalman_servo  kalman;
+	servo_startup  startup;
+
+	/* what the state file had to say, see stateLoad() */
+	bool warmStart;
+	PortIdentity warmStartParent;
+	TimeNs warmStartDelay;
+	Integer32  adjustment;  /* ppb the clock is slowed by, last given to adjFreq() */
+	Integer32  kernelStatus;  /* adjtimex status before KERNEL_PLL took the clock */
 
 	bool message_activity;
+	bool csvHeaderPrinted;
+
+	/* messages received and sent, indexed by messageType */
+	UInteger32 rxMessages[16];
+	UInteger32 txMessages[16];
 
 	IntervalTimer  itimer[TIMER_ARRAY_SIZE];
 
+	/* unicast negotiation, master side: grant table and send schedule */
+	UnicastSlave *unicastSlaves;   /* rtOpts->unicastMaxSlaves entries */
+	Integer32 *unicastFreeList;    /* unused entries of unicastSlaves */
+	Integer32 unicastFreeCount;
+	Integer32 *unicastHash;        /* portIdentity -> slave, -1 if empty */
+	Integer32 unicastHashMask;     /* hash table size - 1 */
+	UnicastEvent *unicastHeap;
+	Integer32 unicastHeapSize;
+	/* slave of each Sync waiting for its send time, by sequenceId */
+	Integer32 unicastSyncSlave[UNICAST_SYNC_RING];
+	UInteger16 unicastSyncSeq[UNICAST_SYNC_RING];
+
+	/* unicast negotiation, slave side */
+	bool unicastGranted[UNICAST_GRANT_TYPES];
+	UInteger32 unicastGrantedDuration;
+
 	NetPath netPath;
 
 	/*Usefull to init network stuff*/
@@ -388,18 +457,31 @@ typedef struct {
 	bool csvStats;
 	bool displayPackets;
 	Octet unicastAddress[MAXHOSTNAMELEN];
+	Enumeration8 servo;  /* SERVO_PI, SERVO_LINREG, SERVO_KALMAN */
+	bool fastLock;       /* estimate the frequency before the servo runs */
+	bool kernelPll;      /* the kernel PLL disciplines the clock, not the servo */
+	Integer32 kalmanProcessNoise;      /* ppb/sqrt(s) */
+	Integer32 kalmanMeasurementNoise;  /* ns, 0 = learned */
 	Integer16 ap, ai;
 	Integer16 s;
 	TimeInternal inboundLatency, outboundLatency;
 	Integer16 max_foreign_records;
 	bool ethernet_mode;
+	bool ipv6_mode;
+	UInteger8 ipv6Scope;  /* X in the FF0X::181 multicast group */
 	bool E2E_mode;
+	bool hybrid_mode;  /* E2E with DelayReq/DelayResp unicast to and from the parent */
+	bool unicastNegotiation;     /* grants instead of multicast, unicastAddress is the master */
+	UInteger32 unicastDuration;  /* in s, grant duration asked for, or the most granted */
+	Integer32 unicastMaxSlaves;
 	bool offset_first_updated;
 	char logFile[PATH_MAX];
 	int logFd;
 	bool useSysLog;
 	int ttl;
+	int rxBatch;     /* messages taken per socket per wakeup */
 	char recordFile[PATH_MAX];
+	char stateFile[PATH_MAX];  /* drift, delay and parent kept across restarts */
 	FILE *recordFP;
 
 	bool probe;      // Management probes not implemented yet
@@ -57,11 +57,149 @@ typedef struct {
 } one_way_delay_filter;
 
 
+CLICK_DECLS
+class PTPd2PackageElement;
+CLICK_ENDDECLS
+CLICK_USING_DECLS
+
+/* brief Time structure to handle Linux time information */
+typedef struct {
+  Integer32 seconds;
+  Integer32 nanoseconds;
+} TimeInternal;
+
+/* brief Signed time in nanoseconds, what the servo and protocol compute with */
+typedef int64_t TimeNs;
+
+/**
+* \brief State of the linear-regression servo
+*
+* It fits a line through the last offsets against local time. The frequency
+* adjustments made since the first sample are added back to each offset, so
+* the slope is the frequency error of the free running clock.
+ */
+typedef struct {
+  TimeNs  time[SERVO_LINREG_WINDOW];    /* local time of the sample */
+  double  offset[SERVO_LINREG_WINDOW];  /* in ns, with 'correction' added */
+  Integer32  count, next;
+  TimeNs  lastTime;
+  double  correction;                   /* in ns, taken off by the adjustments */
+} linreg_servo;
+
+/**
+* \brief State of the Kalman filter servo
+*
+* The state is the offset from master (ns) and the frequency error of the free
+* running clock (ppb), with their covariance p. The measurement noise is the
+* variance of the master to slave delay, less the offset predicted, unless it
+* is configured.
+ */
+typedef struct {
+  double  phase, freq;
+  double  p00, p01, p11;
+  double  delayMean, delayVar;   /* in ns and ns^2 */
+  Integer32  count;
+  TimeNs  lastTime;
+} kalman_servo;
+
+/**
+* \brief State of the fast initial lock
+*
+* After initClock() the frequency is held while FAST_LOCK_SAMPLES Syncs arrive.
+* The slope of a line fitted through their master to slave delays is the
+* frequency error: it is corrected at once, the offset stepped once, and only
+* then the servo takes over. 'start' and 'convergence' time how long it takes
+* until the offset stays within CONVERGED_OFFSET.
+ */
+typedef struct {
+  bool  locked;                        /* the servo is in charge */
+  Integer32  count;
+  TimeNs  time[FAST_LOCK_SAMPLES];     /* local time of the Sync */
+  TimeNs  delay[FAST_LOCK_SAMPLES];    /* its master to slave delay */
+  TimeNs  start;                       /* monotonic, 0 before initClock() */
+  TimeNs  convergence;                 /* in ns from 'start', 0 until converged */
+  Integer32  converged;                /* Syncs in a row within CONVERGED_OFFSET */
+} servo_startup;
+
+
+/**
+* \brief A transport address, ready to be passed to sendto()
+*
+* 'in' for UDP/IPv4, 'in6' for UDP/IPv6, 'll' for Ethernet. 'len' is the size of the socket
+* address in use, 0 when no address is set.
+ */
+typedef struct {
+  union {
+    struct sockaddr sa;
+    struct sockaddr_in in;
+    struct sockaddr_in6 in6;
+    struct sockaddr_ll ll;
+  };
+  socklen_t len;
+} NetAddress;
+
+
+/**
+* \brief One message of a receive batch, see netRecvBatch()
+*
+* 'length' is 0 when the message must be skipped (truncated, or no
+* receive time stamp). 'from' is the address it was sent from.
+ */
+typedef struct {
+  Octet buf[PACKET_SIZE];
+  ssize_t length;
+  TimeInternal time;
+  NetAddress from;
+} NetRxMessage;
+
+/**
+* \brief One queued outgoing message, see netSend() and netFlush()
+ */
+typedef struct {
+  Octet buf[PACKET_SIZE];
+  UInteger16 length;
+  Integer32 sock;
+  NetAddress addr;
+} NetTxMessage;
+
 /**
 * \brief Struct used to store network datas
+*
+* When 'element' is set the engine runs in packet mode: messages come in
+* and go out through the ports of that element instead of the sockets.
+*
+* 'epollFd' watches the sockets and 'timerFd', which is armed for the
+* next protocol timer deadline; it is the only descriptor the caller has
+* to wait on. 'ready' holds the NET_*_READY bits from the last netSelect().
+*
+* 'transport' is UDP_IPV4, UDP_IPV6 or IEE_802_3. On Ethernet all messages go
+* through 'eventSock', a packet socket, and 'generalSock' is not open;
+* 'hwAddr' is the source address of the frames built in packet mode.
+*
+* With 'txTimestamping' multicast loopback is off and the send time of
+* an event message is read back with netRecvTxTimestamp().
  */
 typedef struct {
-  Integer32 eventSock, generalSock, multicastAddr, peerMulticastAddr,unicastAddr;
+  Integer32 eventSock, generalSock;
+  NetAddress multicastAddr, peerMulticastAddr, unicastAddr;
+  Enumeration8 transport;
+  Octet hwAddr[ETHER_ADDRESS_LENGTH];
+  Integer32 epollFd, timerFd;
+  UInteger8 ready;
+  bool txTimestamping;  /* event send times come from the error queue */
+  PTPd2PackageElement *element;
+
+  /* receive batch for recvmmsg() */
+  NetRxMessage rx[NET_MAX_BATCH];
+  struct mmsghdr rxHdr[NET_MAX_BATCH];
+  struct iovec rxIov[NET_MAX_BATCH];
+  char rxControl[NET_MAX_BATCH][NET_CONTROL_SIZE];
+
+  /* transmit queue, flushed with sendmmsg() once per engine step */
+  NetTxMessage tx[NET_MAX_BATCH];
+  int txCount;
+  struct mmsghdr txHdr[NET_MAX_BATCH];
+  struct iovec txIov[NET_MAX_BATCH];
 } NetPath;
 
 #endif /*DATATYPES_DEP_H_*/
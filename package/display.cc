@@ -35,6 +35,13 @@ timeInternal_display(TimeInternal * timeInternal)
 	DBGV("nanoseconds %d \n", timeInternal->nanoseconds);
 }
 
+/** \brief Display a TimeNs*/
+void 
+timeNs_display(TimeNs timeNs)
+{
+	DBGV("nanoseconds : %lld \n", (long long)timeNs);
+}
+
 /** \brief Display a PTP_Timestamp Structure*/
 void 
 PTP_Timestamp_display(PTP_Timestamp * PTP_Timestamp)
@@ -75,24 +82,27 @@ clockUUID_display(Octet * sourceUuid)
 void 
 netPath_display(NetPath * net)
 {
-	struct in_addr addr;
+	char buf[64];
 
 	DBGV("eventSock : %d \n", net->eventSock);
 	DBGV("generalSock : %d \n", net->generalSock);
-	addr.s_addr = net->multicastAddr;
-	DBGV("multicastAdress : %s \n", inet_ntoa(addr));
-	addr.s_addr = net->peerMulticastAddr;
-	DBGV("peerMulticastAddress : %s \n", inet_ntoa(addr));
-	addr.s_addr = net->unicastAddr;
-	DBGV("unicastAddress : %s \n", inet_ntoa(addr));
+	snprint_NetAddress(buf, sizeof(buf), &net->multicastAddr);
+	DBGV("multicastAdress : %s \n", buf);
+	snprint_NetAddress(buf, sizeof(buf), &net->peerMulticastAddr);
+	DBGV("peerMulticastAddress : %s \n", buf);
+	snprint_NetAddress(buf, sizeof(buf), &net->unicastAddr);
+	DBGV("unicastAddress : %s \n", buf);
 }
 
 /**\brief Display a IntervalTimer Structure*/
 void 
 intervalTimer_display(IntervalTimer * ptimer)
 {
-	DBGV("interval : %d \n", ptimer->interval);
-	DBGV("left : %d \n", ptimer->left);
+	DBGV("interval : %d.%09d \n", ptimer->interval.seconds,
+	     ptimer->interval.nanoseconds);
+	DBGV("deadline : %d.%09d \n", ptimer->deadline.seconds,
+	     ptimer->deadline.nanoseconds);
+	DBGV("running : %d \n", ptimer->running);
 	DBGV("expire : %d \n", ptimer->expire);
 }
 
@@ -279,6 +289,10 @@ displayRunTimeOpts(RunTimeOpts * rtOpts)
 	DBGV("displayStats : %d \n", rtOpts->displayStats);
 	DBGV("csvStats : %d \n", rtOpts->csvStats);
 	iFaceName_display(rtOpts->ifaceName);
+	DBGV("servo : %s \n", servoName(rtOpts));
+	DBGV("fastLock : %d \n", rtOpts->fastLock);
+	DBGV("kalman noise : %d ppb/sqrt(s) %d ns \n", 
+	     rtOpts->kalmanProcessNoise, rtOpts->kalmanMeasurementNoise);
 	DBGV("ap : %d \n", rtOpts->ap);
 	DBGV("aI : %d \n", rtOpts->ai);
 	DBGV("s : %d \n", rtOpts->s);
@@ -288,6 +302,11 @@ displayRunTimeOpts(RunTimeOpts * rtOpts)
 	timeInternal_display(&(rtOpts->outboundLatency));
 	DBGV("max_foreign_records : %d \n", rtOpts->max_foreign_records);
 	DBGV("ethernet mode : %d \n", rtOpts->ethernet_mode);
+	DBGV("ipv6 mode : %d (scope %x) \n", rtOpts->ipv6_mode, rtOpts->ipv6Scope);
+	DBGV("hybrid mode : %d \n", rtOpts->hybrid_mode);
+	DBGV("unicast negotiation : %d \n", rtOpts->unicastNegotiation);
+	DBGV("unicast duration : %u \n", rtOpts->unicastDuration);
+	DBGV("unicast max slaves : %d \n", rtOpts->unicastMaxSlaves);
 	DBGV("\n");
 }
 
@@ -321,9 +340,9 @@ displayCurrent(PtpClock * ptpClock)
 
 	DBGV("stepsremoved : %d \n", ptpClock->stepsRemoved);
 	DBGV("Offset from master : \n");
-	timeInternal_display(&ptpClock->offsetFromMaster);
+	timeNs_display(ptpClock->offsetFromMaster);
 	DBGV("Mean path delay : \n");
-	timeInternal_display(&ptpClock->meanPathDelay);
+	timeNs_display(ptpClock->meanPathDelay);
 	DBGV("\n");
 }
 
@@ -379,7 +398,7 @@ displayPort(PtpClock * ptpClock)
 	DBGV("port state : %d \n", ptpClock->portState);
 	DBGV("logMinDelayReqInterval : %d \n", ptpClock->logMinDelayReqInterval);
 	DBGV("peerMeanPathDelay : \n");
-	timeInternal_display(&ptpClock->peerMeanPathDelay);
+	timeNs_display(ptpClock->peerMeanPathDelay);
 	DBGV("logAnnounceInterval : %d \n", ptpClock->logAnnounceInterval);
 	DBGV("announceReceiptTimeout : %d \n", ptpClock->announceReceiptTimeout);
 	DBGV("logSyncInterval : %d \n", ptpClock->logSyncInterval);
@@ -443,25 +462,25 @@ displayOthers(PtpClock * ptpClock)
 	DBGV("---Ptp Others Data Set-- \n");
 	DBGV("\n");
 	DBGV("master_to_slave_delay : \n");
-	timeInternal_display(&ptpClock->master_to_slave_delay);
+	timeNs_display(ptpClock->master_to_slave_delay);
 	DBGV("\n");
 	DBGV("slave_to_master_delay : \n");
-	timeInternal_display(&ptpClock->slave_to_master_delay);
+	timeNs_display(ptpClock->slave_to_master_delay);
 	DBGV("\n");
 	DBGV("delay_req_receive_time : \n");
-	timeInternal_display(&ptpClock->pdelay_req_receive_time);
+	timeNs_display(ptpClock->pdelay_req_receive_time);
 	DBGV("\n");
 	DBGV("delay_req_send_time : \n");
-	timeInternal_display(&ptpClock->pdelay_req_send_time);
+	timeNs_display(ptpClock->pdelay_req_send_time);
 	DBGV("\n");
 	DBGV("delay_resp_receive_time : \n");
-	timeInternal_display(&ptpClock->pdelay_resp_receive_time);
+	timeNs_display(ptpClock->pdelay_resp_receive_time);
 	DBGV("\n");
 	DBGV("delay_resp_send_time : \n");
-	timeInternal_display(&ptpClock->pdelay_resp_send_time);
+	timeNs_display(ptpClock->pdelay_resp_send_time);
 	DBGV("\n");
 	DBGV("sync_receive_time : \n");
-	timeInternal_display(&ptpClock->sync_receive_time);
+	timeNs_display(ptpClock->sync_receive_time);
 	DBGV("\n");
 	DBGV("R : %f \n", ptpClock->R);
 	DBGV("sentPdelayReq : %d \n", ptpClock->sentPDelayReq);
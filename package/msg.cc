@@ -5,33 +5,335 @@
  * 
  * @brief  Functions to pack and unpack messages.
  * 
- * See spec annex d
+ * See spec annex d. The wire layout of each message is declared once,
+ * in the field tables below, and MsgCodec generates the pack and unpack
+ * code from them at compile time.
  */
 
 #include "ptpd.hh"
 
+/* how a field is encoded on the wire (spec 5.3 and annex D) */
+enum {
+	FIELD_U8=0,       /* one octet */
+	FIELD_U16,        /* two octets, network order */
+	FIELD_U32,        /* four octets, network order */
+	FIELD_LO4,        /* low nibble of an octet */
+	FIELD_HI4,        /* high nibble of an octet */
+	FIELD_OCTETS,     /* octet string, copied as is */
+	FIELD_RESERVED    /* packed as zeros, not unpacked */
+};
+
+/* one field of a message: where it is on the wire and in the struct */
+typedef struct {
+	UInteger16 wire;      /* offset in the message */
+	UInteger8 encoding;
+	UInteger8 size;       /* octets on the wire */
+	size_t member;        /* offsetof() in the unpacked struct */
+} MsgField;
+
+#define MSG_U8(type, member, wire) \
+	{ wire, FIELD_U8, 1, offsetof(type, member) }
+#define MSG_U16(type, member, wire) \
+	{ wire, FIELD_U16, 2, offsetof(type, member) }
+#define MSG_U32(type, member, wire) \
+	{ wire, FIELD_U32, 4, offsetof(type, member) }
+#define MSG_LO4(type, member, wire) \
+	{ wire, FIELD_LO4, 1, offsetof(type, member) }
+#define MSG_HI4(type, member, wire) \
+	{ wire, FIELD_HI4, 1, offsetof(type, member) }
+#define MSG_OCTETS(type, member, wire, size) \
+	{ wire, FIELD_OCTETS, size, offsetof(type, member) }
+/* packed as zeros, a nibble field in the same octet comes after it */
+#define MSG_RESERVED(wire, size) \
+	{ wire, FIELD_RESERVED, size, 0 }
+
+#define MSG_TIMESTAMP(type, member, wire) \
+	MSG_U16(type, member.secondsField.msb, wire), \
+	MSG_U32(type, member.secondsField.lsb, wire + 2), \
+	MSG_U32(type, member.nanosecondsField, wire + 6)
+#define MSG_PORT_IDENTITY(type, member, wire) \
+	MSG_OCTETS(type, member.clockIdentity, wire, CLOCK_IDENTITY_LENGTH), \
+	MSG_U16(type, member.portNumber, wire + CLOCK_IDENTITY_LENGTH)
+
+/* the table and its number of fields, as MsgCodec takes them */
+#define MSG_FIELDS(fields) fields, sizeof(fields) / sizeof(fields[0])
+
+
+/*Header (Table 18)*/
+static constexpr MsgField headerFields[] = {
+	MSG_RESERVED(0, 2),
+	MSG_HI4(MsgHeader, transportSpecific, 0),
+	MSG_LO4(MsgHeader, messageType, 0),
+	MSG_LO4(MsgHeader, versionPTP, 1),
+	MSG_U16(MsgHeader, messageLength, 2),
+	MSG_U8(MsgHeader, domainNumber, 4),
+	MSG_RESERVED(5, 1),
+	MSG_OCTETS(MsgHeader, flagField, 6, FLAG_FIELD_LENGTH),
+	MSG_U32(MsgHeader, correctionfield.msb, 8),
+	MSG_U32(MsgHeader, correctionfield.lsb, 12),
+	MSG_RESERVED(16, 4),
+	MSG_PORT_IDENTITY(MsgHeader, sourcePortIdentity, 20),
+	MSG_U16(MsgHeader, sequenceId, 30),
+	MSG_U8(MsgHeader, controlField, 32),
+	MSG_U8(MsgHeader, logMessageInterval, 33),
+};
+
+/* the header fields each message sets, the others stay as msgPackHeader() left them */
+static constexpr MsgField messageFields[] = {
+	MSG_LO4(MsgHeader, messageType, 0),
+	MSG_U16(MsgHeader, messageLength, 2),
+	MSG_U32(MsgHeader, correctionfield.msb, 8),
+	MSG_U32(MsgHeader, correctionfield.lsb, 12),
+	MSG_U16(MsgHeader, sequenceId, 30),
+	MSG_U8(MsgHeader, controlField, 32),
+	MSG_U8(MsgHeader, logMessageInterval, 33),
+};
+
+/* what a send patches into a template */
+static constexpr MsgField correctionFields[] = {
+	MSG_U32(Integer64, msb, 8),
+	MSG_U32(Integer64, lsb, 12),
+};
+
+static constexpr MsgField timestampFields[] = {
+	MSG_U16(PTP_Timestamp, secondsField.msb, 34),
+	MSG_U32(PTP_Timestamp, secondsField.lsb, 36),
+	MSG_U32(PTP_Timestamp, nanosecondsField, 40),
+};
+
+static constexpr MsgField requestingFields[] = {
+	MSG_OCTETS(PortIdentity, clockIdentity, 44, CLOCK_IDENTITY_LENGTH),
+	MSG_U16(PortIdentity, portNumber, 52),
+};
+
+/*Announce (Table 25)*/
+static constexpr MsgField announceFields[] = {
+	MSG_TIMESTAMP(MsgAnnounce, originPTP_Timestamp, 34),
+	MSG_U16(MsgAnnounce, currentUtcOffset, 44),
+	MSG_RESERVED(46, 1),
+	MSG_U8(MsgAnnounce, grandmasterPriority1, 47),
+	MSG_U8(MsgAnnounce, grandmasterClockQuality.clockClass, 48),
+	MSG_U8(MsgAnnounce, grandmasterClockQuality.clockAccuracy, 49),
+	MSG_U16(MsgAnnounce, grandmasterClockQuality.offsetScaledLogVariance, 50),
+	MSG_U8(MsgAnnounce, grandmasterPriority2, 52),
+	MSG_OCTETS(MsgAnnounce, grandmasterIdentity, 53, CLOCK_IDENTITY_LENGTH),
+	MSG_U16(MsgAnnounce, stepsRemoved, 61),
+	MSG_U8(MsgAnnounce, timeSource, 63),
+};
+
+/*Sync and DelayReq (Table 26)*/
+static constexpr MsgField syncFields[] = {
+	MSG_TIMESTAMP(MsgSync, originPTP_Timestamp, 34),
+};
+
+static constexpr MsgField delayReqFields[] = {
+	MSG_TIMESTAMP(MsgDelayReq, originPTP_Timestamp, 34),
+};
+
+/*FollowUp (Table 27)*/
+static constexpr MsgField followUpFields[] = {
+	MSG_TIMESTAMP(MsgFollowUp, preciseOriginPTP_Timestamp, 34),
+};
+
+/*DelayResp (Table 28)*/
+static constexpr MsgField delayRespFields[] = {
+	MSG_TIMESTAMP(MsgDelayResp, receivePTP_Timestamp, 34),
+	MSG_PORT_IDENTITY(MsgDelayResp, requestingPortIdentity, 44),
+};
+
+/*PdelayReq (Table 29)*/
+static constexpr MsgField pdelayReqFields[] = {
+	MSG_TIMESTAMP(MsgPDelayReq, originPTP_Timestamp, 34),
+	MSG_RESERVED(44, 10),
+};
+
+/*PdelayResp (Table 30)*/
+static constexpr MsgField pdelayRespFields[] = {
+	MSG_TIMESTAMP(MsgPDelayResp, requestReceiptPTP_Timestamp, 34),
+	MSG_PORT_IDENTITY(MsgPDelayResp, requestingPortIdentity, 44),
+};
+
+/*PdelayRespFollowUp (Table 31)*/
+static constexpr MsgField pdelayRespFollowUpFields[] = {
+	MSG_TIMESTAMP(MsgPDelayRespFollowUp, responseOriginPTP_Timestamp, 34),
+	MSG_PORT_IDENTITY(MsgPDelayRespFollowUp, requestingPortIdentity, 44),
+};
+
+/*Signaling (Table 33), the TLVs follow*/
+static constexpr MsgField signalingFields[] = {
+	MSG_PORT_IDENTITY(MsgSignaling, targetPortIdentity, 34),
+};
+
+/*Management (Table 37), the TLV follows*/
+static constexpr MsgField managementFields[] = {
+	MSG_PORT_IDENTITY(MsgManagement, targetPortIdentity, 34),
+	MSG_U8(MsgManagement, startingBoundaryHops, 44),
+	MSG_U8(MsgManagement, boundaryHops, 45),
+	MSG_RESERVED(46, 2),
+	MSG_LO4(MsgManagement, actionField, 46),
+};
+
+/*Unicast negotiation TLVs (Tables 73 to 76), each one extends the last*/
+static constexpr MsgField cancelUnicastFields[] = {
+	MSG_U16(MsgUnicastTLV, tlvType, 0),
+	MSG_U16(MsgUnicastTLV, lengthField, 2),
+	MSG_RESERVED(4, 2),
+	MSG_HI4(MsgUnicastTLV, messageType, 4),
+};
+
+static constexpr MsgField requestUnicastFields[] = {
+	MSG_U16(MsgUnicastTLV, tlvType, 0),
+	MSG_U16(MsgUnicastTLV, lengthField, 2),
+	MSG_RESERVED(4, 1),
+	MSG_HI4(MsgUnicastTLV, messageType, 4),
+	MSG_U8(MsgUnicastTLV, logInterMessagePeriod, 5),
+	MSG_U32(MsgUnicastTLV, durationField, 6),
+};
+
+static constexpr MsgField grantUnicastFields[] = {
+	MSG_U16(MsgUnicastTLV, tlvType, 0),
+	MSG_U16(MsgUnicastTLV, lengthField, 2),
+	MSG_RESERVED(4, 1),
+	MSG_HI4(MsgUnicastTLV, messageType, 4),
+	MSG_U8(MsgUnicastTLV, logInterMessagePeriod, 5),
+	MSG_U32(MsgUnicastTLV, durationField, 6),
+	MSG_RESERVED(10, 1),
+	MSG_U8(MsgUnicastTLV, flags, 11),
+};
+
+
+/*
+ * Pack and unpack the fields F[I] to F[N-1] of a message of type T
+ * that is 'Length' octets long. Each field is a compile time constant,
+ * so this unrolls into the loads, stores and byte swaps of the table.
+ * The copies go through memcpy(), which makes them alignment safe and
+ * still compiles to single moves.
+ */
+template<typename T, const MsgField *F, size_t N, UInteger16 Length, 
+	 size_t I = 0>
+struct MsgCodec {
+	static_assert(F[I].wire + F[I].size <= Length,
+		      "field beyond the end of the message");
+	static_assert(F[I].encoding == FIELD_RESERVED ||
+		      F[I].member + F[I].size <= sizeof(T),
+		      "field beyond the end of the struct");
+
+	static inline void 
+	unpack(const char *buf, T *msg)
+	{
+		const char *wire = buf + F[I].wire;
+		char *member = (char *)msg + F[I].member;
+		UInteger16 u16;
+		UInteger32 u32;
+
+		switch (F[I].encoding) {
+		case FIELD_U8:
+			*(UInteger8 *)member = *(const UInteger8 *)wire;
+			break;
+		case FIELD_U16:
+			memcpy(&u16, wire, 2);
+			u16 = flip16(u16);
+			memcpy(member, &u16, 2);
+			break;
+		case FIELD_U32:
+			memcpy(&u32, wire, 4);
+			u32 = flip32(u32);
+			memcpy(member, &u32, 4);
+			break;
+		case FIELD_LO4:
+			*(UInteger8 *)member = *(const UInteger8 *)wire & 0x0F;
+			break;
+		case FIELD_HI4:
+			*(UInteger8 *)member = *(const UInteger8 *)wire >> 4;
+			break;
+		case FIELD_OCTETS:
+			memcpy(member, wire, F[I].size);
+			break;
+		default:
+			break;
+		}
+		MsgCodec<T, F, N, Length, I + 1>::unpack(buf, msg);
+	}
+
+	static inline void 
+	pack(char *buf, const T *msg)
+	{
+		char *wire = buf + F[I].wire;
+		const char *member = (const char *)msg + F[I].member;
+		UInteger16 u16;
+		UInteger32 u32;
+
+		switch (F[I].encoding) {
+		case FIELD_U8:
+			*(UInteger8 *)wire = *(const UInteger8 *)member;
+			break;
+		case FIELD_U16:
+			memcpy(&u16, member, 2);
+			u16 = flip16(u16);
+			memcpy(wire, &u16, 2);
+			break;
+		case FIELD_U32:
+			memcpy(&u32, member, 4);
+			u32 = flip32(u32);
+			memcpy(wire, &u32, 4);
+			break;
+		case FIELD_LO4:
+			*(UInteger8 *)wire = (*(UInteger8 *)wire & 0xF0) | 
+				(*(const UInteger8 *)member & 0x0F);
+			break;
+		case FIELD_HI4:
+			*(UInteger8 *)wire = (*(UInteger8 *)wire & 0x0F) | 
+				(*(const UInteger8 *)member << 4);
+			break;
+		case FIELD_OCTETS:
+			memcpy(wire, member, F[I].size);
+			break;
+		case FIELD_RESERVED:
+			memset(wire, 0, F[I].size);
+			break;
+		}
+		MsgCodec<T, F, N, Length, I + 1>::pack(buf, msg);
+	}
+};
+
+/* past the last field */
+template<typename T, const MsgField *F, size_t N, UInteger16 Length>
+struct MsgCodec<T, F, N, Length, N> {
+	static inline void unpack(const char *buf, T *msg) {}
+	static inline void pack(char *buf, const T *msg) {}
+};
+
+
+/* pack the header fields that differ between messages */
+static void 
+msgPackMessageFields(char *buf, Enumeration4 messageType, 
+		     UInteger16 messageLength, Integer64 *correctionfield,
+		     UInteger16 sequenceId, UInteger8 controlField, 
+		     Integer8 logMessageInterval)
+{
+	MsgHeader header;
+
+	header.messageType = messageType;
+	header.messageLength = messageLength;
+	if (correctionfield) {
+		header.correctionfield = *correctionfield;
+	} else {
+		header.correctionfield.msb = 0;
+		header.correctionfield.lsb = 0;
+	}
+	header.sequenceId = sequenceId;
+	header.controlField = controlField;
+	header.logMessageInterval = logMessageInterval;
+	MsgCodec<MsgHeader, MSG_FIELDS(messageFields), HEADER_LENGTH>::pack(
+		buf, &header);
+}
+
 /*Unpack Header from IN buffer to msgTmpHeader field */
 void 
 msgUnpackHeader(char *buf, MsgHeader * header)
 {
-	header->transportSpecific = (*(Nibble *) (buf + 0)) >> 4;
-	header->messageType = (*(Enumeration4 *) (buf + 0)) & 0x0F;
-	header->versionPTP = (*(UInteger4 *) (buf + 1)) & 0x0F;
-	/* force reserved bit to zero if not */
-	header->messageLength = flip16(*(UInteger16 *) (buf + 2));
-	header->domainNumber = (*(UInteger8 *) (buf + 4));
-	memcpy(header->flagField, (buf + 6), FLAG_FIELD_LENGTH);
-	memcpy(&header->correctionfield.msb, (buf + 8), 4);
-	memcpy(&header->correctionfield.lsb, (buf + 12), 4);
-	header->correctionfield.msb = flip32(header->correctionfield.msb);
-	header->correctionfield.lsb = flip32(header->correctionfield.lsb);
-	memcpy(header->sourcePortIdentity.clockIdentity, (buf + 20), 
-	       CLOCK_IDENTITY_LENGTH);
-	header->sourcePortIdentity.portNumber = 
-		flip16(*(UInteger16 *) (buf + 28));
-	header->sequenceId = flip16(*(UInteger16 *) (buf + 30));
-	header->controlField = (*(UInteger8 *) (buf + 32));
-	header->logMessageInterval = (*(Integer8 *) (buf + 33));
+	MsgCodec<MsgHeader, MSG_FIELDS(headerFields), HEADER_LENGTH>::unpack(
+		buf, header);
 
 #ifdef PTPD_DBG
 	msgHeader_display(header);
@@ -42,22 +344,20 @@ msgUnpackHeader(char *buf, MsgHeader * header)
 void 
 msgPackHeader(char *buf, PtpClock * ptpClock)
 {
-	Nibble transport = 0x80;
+	MsgHeader header;
 
 	/* (spec annex D) */
-	*(UInteger8 *) (buf + 0) = transport;
-	*(UInteger4 *) (buf + 1) = ptpClock->versionNumber;
-	*(UInteger8 *) (buf + 4) = ptpClock->domainNumber;
-
+	memset(&header, 0, sizeof(header));
+	header.transportSpecific = 0x08;
+	header.versionPTP = ptpClock->versionNumber;
+	header.domainNumber = ptpClock->domainNumber;
 	if (ptpClock->twoStepFlag)
-		*(UInteger8 *) (buf + 6) = TWO_STEP_FLAG;
-
-	memset((buf + 8), 0, 8);
-	memcpy((buf + 20), ptpClock->portIdentity.clockIdentity, 
-	       CLOCK_IDENTITY_LENGTH);
-	*(UInteger16 *) (buf + 28) = flip16(ptpClock->portIdentity.portNumber);
-	*(UInteger8 *) (buf + 33) = 0x7F;
+		header.flagField[0] = TWO_STEP_FLAG;
+	header.sourcePortIdentity = ptpClock->portIdentity;
+	header.logMessageInterval = 0x7F;
 	/* Default value(spec Table 24) */
+	MsgCodec<MsgHeader, MSG_FIELDS(headerFields), HEADER_LENGTH>::pack(
+		buf, &header);
 }
 
 
@@ -66,34 +366,25 @@ msgPackHeader(char *buf, PtpClock * ptpClock)
 void 
 msgPackSync(char *buf, PTP_Timestamp * originPTP_Timestamp, PtpClock * ptpClock)
 {
-	/* changes in header */
-	*(char *)(buf + 0) = *(char *)(buf + 0) & 0xF0;
-	/* RAZ messageType */
-	*(char *)(buf + 0) = *(char *)(buf + 0) | 0x00;
-	/* Table 19 */
-	*(UInteger16 *) (buf + 2) = flip16(SYNC_LENGTH);
-	*(UInteger16 *) (buf + 30) = flip16(ptpClock->sentSyncSequenceId);
-	*(UInteger8 *) (buf + 32) = 0x00;
-	/* Table 23 */
-	*(Integer8 *) (buf + 33) = ptpClock->logSyncInterval;
-	memset((buf + 8), 0, 8);
+	MsgSync sync;
+
+	/* Table 19, Table 23 */
+	msgPackMessageFields(buf, SYNC, SYNC_LENGTH, NULL, 
+			     ptpClock->sentSyncSequenceId, 0x00,
+			     ptpClock->logSyncInterval);
 
 	/* Sync message */
-	*(UInteger16 *) (buf + 34) = flip16(originPTP_Timestamp->secondsField.msb);
-	*(UInteger32 *) (buf + 36) = flip32(originPTP_Timestamp->secondsField.lsb);
-	*(UInteger32 *) (buf + 40) = flip32(originPTP_Timestamp->nanosecondsField);
+	sync.originPTP_Timestamp = *originPTP_Timestamp;
+	MsgCodec<MsgSync, MSG_FIELDS(syncFields), SYNC_LENGTH>::pack(
+		buf, &sync);
 }
 
 /*Unpack Sync message from IN buffer */
 void 
 msgUnpackSync(char *buf, MsgSync * sync)
 {
-	sync->originPTP_Timestamp.secondsField.msb = 
-		flip16(*(UInteger16 *) (buf + 34));
-	sync->originPTP_Timestamp.secondsField.lsb = 
-		flip32(*(UInteger32 *) (buf + 36));
-	sync->originPTP_Timestamp.nanosecondsField = 
-		flip32(*(UInteger32 *) (buf + 40));
+	MsgCodec<MsgSync, MSG_FIELDS(syncFields), SYNC_LENGTH>::unpack(
+		buf, sync);
 
 #ifdef PTPD_DBG
 	msgSync_display(sync);
@@ -106,54 +397,33 @@ msgUnpackSync(char *buf, MsgSync * sync)
 void 
 msgPackAnnounce(char *buf, PtpClock * ptpClock)
 {
-	/* changes in header */
-	*(char *)(buf + 0) = *(char *)(buf + 0) & 0xF0;
-	/* RAZ messageType */
-	*(char *)(buf + 0) = *(char *)(buf + 0) | 0x0B;
-	/* Table 19 */
-	*(UInteger16 *) (buf + 2) = flip16(ANNOUNCE_LENGTH);
-	*(UInteger16 *) (buf + 30) = flip16(ptpClock->sentAnnounceSequenceId);
-	*(UInteger8 *) (buf + 32) = 0x05;
-	/* Table 23 */
-	*(Integer8 *) (buf + 33) = ptpClock->logAnnounceInterval;
+	MsgAnnounce announce;
+
+	/* Table 19, Table 23 */
+	msgPackMessageFields(buf, ANNOUNCE, ANNOUNCE_LENGTH, NULL, 
+			     ptpClock->sentAnnounceSequenceId, 0x05,
+			     ptpClock->logAnnounceInterval);
 
 	/* Announce message */
-	memset((buf + 34), 0, 10);
-	*(Integer16 *) (buf + 44) = flip16(ptpClock->currentUtcOffset);
-	*(UInteger8 *) (buf + 47) = ptpClock->grandmasterPriority1;
-	*(UInteger8 *) (buf + 48) = ptpClock->clockQuality.clockClass;
-	*(Enumeration8 *) (buf + 49) = ptpClock->clockQuality.clockAccuracy;
-	*(UInteger16 *) (buf + 50) = 
-		flip16(ptpClock->clockQuality.offsetScaledLogVariance);
-	*(UInteger8 *) (buf + 52) = ptpClock->grandmasterPriority2;
-	memcpy((buf + 53), ptpClock->grandmasterIdentity, CLOCK_IDENTITY_LENGTH);
-	*(UInteger16 *) (buf + 61) = flip16(ptpClock->stepsRemoved);
-	*(Enumeration8 *) (buf + 63) = ptpClock->timeSource;
+	memset(&announce.originPTP_Timestamp, 0, sizeof(PTP_Timestamp));
+	announce.currentUtcOffset = ptpClock->currentUtcOffset;
+	announce.grandmasterPriority1 = ptpClock->grandmasterPriority1;
+	announce.grandmasterClockQuality = ptpClock->clockQuality;
+	announce.grandmasterPriority2 = ptpClock->grandmasterPriority2;
+	memcpy(announce.grandmasterIdentity, ptpClock->grandmasterIdentity, 
+	       CLOCK_IDENTITY_LENGTH);
+	announce.stepsRemoved = ptpClock->stepsRemoved;
+	announce.timeSource = ptpClock->timeSource;
+	MsgCodec<MsgAnnounce, MSG_FIELDS(announceFields), ANNOUNCE_LENGTH>::pack(
+		buf, &announce);
 }
 
 /*Unpack Announce message from IN buffer of ptpClock to msgtmp.Announce*/
 void 
 msgUnpackAnnounce(char *buf, MsgAnnounce * announce)
 {
-	announce->originPTP_Timestamp.secondsField.msb = 
-		flip16(*(UInteger16 *) (buf + 34));
-	announce->originPTP_Timestamp.secondsField.lsb = 
-		flip32(*(UInteger32 *) (buf + 36));
-	announce->originPTP_Timestamp.nanosecondsField = 
-		flip32(*(UInteger32 *) (buf + 40));
-	announce->currentUtcOffset = flip16(*(UInteger16 *) (buf + 44));
-	announce->grandmasterPriority1 = *(UInteger8 *) (buf + 47);
-	announce->grandmasterClockQuality.clockClass = 
-		*(UInteger8 *) (buf + 48);
-	announce->grandmasterClockQuality.clockAccuracy = 
-		*(Enumeration8 *) (buf + 49);
-	announce->grandmasterClockQuality.offsetScaledLogVariance = 
-		flip16(*(UInteger16 *) (buf + 50));
-	announce->grandmasterPriority2 = *(UInteger8 *) (buf + 52);
-	memcpy(announce->grandmasterIdentity, (buf + 53), 
-	       CLOCK_IDENTITY_LENGTH);
-	announce->stepsRemoved = flip16(*(UInteger16 *) (buf + 61));
-	announce->timeSource = *(Enumeration8 *) (buf + 63);
+	MsgCodec<MsgAnnounce, MSG_FIELDS(announceFields), ANNOUNCE_LENGTH>::unpack(
+		buf, announce);
 	
 #ifdef PTPD_DBG
 	msgAnnounce_display(announce);
@@ -164,37 +434,26 @@ msgUnpackAnnounce(char *buf, MsgAnnounce * announce)
 void 
 msgPackFollowUp(char *buf, PTP_Timestamp * preciseOriginPTP_Timestamp, PtpClock * ptpClock)
 {
-	/* changes in header */
-	*(char *)(buf + 0) = *(char *)(buf + 0) & 0xF0;
-	/* RAZ messageType */
-	*(char *)(buf + 0) = *(char *)(buf + 0) | 0x08;
-	/* Table 19 */
-	*(UInteger16 *) (buf + 2) = flip16(FOLLOW_UP_LENGTH);
-	*(UInteger16 *) (buf + 30) = flip16(ptpClock->sentSyncSequenceId - 1);
+	MsgFollowUp follow;
+
+	/* Table 19, Table 23 */
 	/* sentSyncSequenceId has already been incremented in "issueSync" */
-	*(UInteger8 *) (buf + 32) = 0x02;
-	/* Table 23 */
-	*(Integer8 *) (buf + 33) = ptpClock->logSyncInterval;
+	msgPackMessageFields(buf, FOLLOW_UP, FOLLOW_UP_LENGTH, NULL, 
+			     ptpClock->sentSyncSequenceId - 1, 0x02,
+			     ptpClock->logSyncInterval);
 
 	/* Follow_up message */
-	*(UInteger16 *) (buf + 34) = 
-		flip16(preciseOriginPTP_Timestamp->secondsField.msb);
-	*(UInteger32 *) (buf + 36) = 
-		flip32(preciseOriginPTP_Timestamp->secondsField.lsb);
-	*(UInteger32 *) (buf + 40) = 
-		flip32(preciseOriginPTP_Timestamp->nanosecondsField);
+	follow.preciseOriginPTP_Timestamp = *preciseOriginPTP_Timestamp;
+	MsgCodec<MsgFollowUp, MSG_FIELDS(followUpFields), FOLLOW_UP_LENGTH>::pack(
+		buf, &follow);
 }
 
 /*Unpack Follow_up message from IN buffer of ptpClock to msgtmp.follow*/
 void 
 msgUnpackFollowUp(char *buf, MsgFollowUp * follow)
 {
-	follow->preciseOriginPTP_Timestamp.secondsField.msb = 
-		flip16(*(UInteger16 *) (buf + 34));
-	follow->preciseOriginPTP_Timestamp.secondsField.lsb = 
-		flip32(*(UInteger32 *) (buf + 36));
-	follow->preciseOriginPTP_Timestamp.nanosecondsField = 
-		flip32(*(UInteger32 *) (buf + 40));
+	MsgCodec<MsgFollowUp, MSG_FIELDS(followUpFields), FOLLOW_UP_LENGTH>::unpack(
+		buf, follow);
 
 #ifdef PTPD_DBG
 	msgFollowUp_display(follow);
@@ -207,118 +466,242 @@ msgUnpackFollowUp(char *buf, MsgFollowUp * follow)
 void 
 msgPackPDelayReq(char *buf, PTP_Timestamp * originPTP_Timestamp, PtpClock * ptpClock)
 {
-	/* changes in header */
-	*(char *)(buf + 0) = *(char *)(buf + 0) & 0xF0;
-	/* RAZ messageType */
-	*(char *)(buf + 0) = *(char *)(buf + 0) | 0x02;
-	/* Table 19 */
-	*(UInteger16 *) (buf + 2) = flip16(PDELAY_REQ_LENGTH);
-	*(UInteger16 *) (buf + 30) = flip16(ptpClock->sentPDelayReqSequenceId);
-	*(UInteger8 *) (buf + 32) = 0x05;
-	/* Table 23 */
-	*(Integer8 *) (buf + 33) = 0x7F;
-	/* Table 24 */
-	memset((buf + 8), 0, 8);
+	MsgPDelayReq preq;
 
-	/* Pdelay_req message */
-	*(UInteger16 *) (buf + 34) = flip16(originPTP_Timestamp->secondsField.msb);
-	*(UInteger32 *) (buf + 36) = flip32(originPTP_Timestamp->secondsField.lsb);
-	*(UInteger32 *) (buf + 40) = flip32(originPTP_Timestamp->nanosecondsField);
+	/* Table 19, Table 23, Table 24 */
+	msgPackMessageFields(buf, PDELAY_REQ, PDELAY_REQ_LENGTH, NULL, 
+			     ptpClock->sentPDelayReqSequenceId, 0x05, 0x7F);
 
-	memset((buf + 44), 0, 10);
-	/* RAZ reserved octets */
+	/* Pdelay_req message, reserved octets are cleared */
+	preq.originPTP_Timestamp = *originPTP_Timestamp;
+	MsgCodec<MsgPDelayReq, MSG_FIELDS(pdelayReqFields), PDELAY_REQ_LENGTH>::pack(
+		buf, &preq);
 }
 
 /*pack delayReq message into OUT buffer of ptpClock*/
 void 
 msgPackDelayReq(char *buf, PTP_Timestamp * originPTP_Timestamp, PtpClock * ptpClock)
 {
-	/* changes in header */
-	*(char *)(buf + 0) = *(char *)(buf + 0) & 0xF0;
-	/* RAZ messageType */
-	*(char *)(buf + 0) = *(char *)(buf + 0) | 0x01;
-	/* Table 19 */
-	*(UInteger16 *) (buf + 2) = flip16(DELAY_REQ_LENGTH);
-	*(UInteger16 *) (buf + 30) = flip16(ptpClock->sentDelayReqSequenceId);
-	*(UInteger8 *) (buf + 32) = 0x01;
-	/* Table 23 */
-	*(Integer8 *) (buf + 33) = 0x7F;
-	/* Table 24 */
-	memset((buf + 8), 0, 8);
-
-	/* Pdelay_req message */
-	*(UInteger16 *) (buf + 34) = flip16(originPTP_Timestamp->secondsField.msb);
-	*(UInteger32 *) (buf + 36) = flip32(originPTP_Timestamp->secondsField.lsb);
-	*(UInteger32 *) (buf + 40) = flip32(originPTP_Timestamp->nanosecondsField);
+	MsgDelayReq req;
+
+	/* Table 19, Table 23, Table 24 */
+	msgPackMessageFields(buf, DELAY_REQ, DELAY_REQ_LENGTH, NULL, 
+			     ptpClock->sentDelayReqSequenceId, 0x01, 0x7F);
+
+	/* Delay_req message */
+	req.originPTP_Timestamp = *originPTP_Timestamp;
+	MsgCodec<MsgDelayReq, MSG_FIELDS(delayReqFields), DELAY_REQ_LENGTH>::pack(
+		buf, &req);
 }
 
-/*pack delayResp message into OUT buffer of ptpClock*/
+/* set or clear the unicastFlag (Table 20) of the message in 'buf' */
 void 
-msgPackDelayResp(char *buf, MsgHeader * header, PTP_Timestamp * receivePTP_Timestamp, PtpClock * ptpClock)
+msgPackUnicastFlag(char *buf, bool unicast)
 {
-	/* changes in header */
-	*(char *)(buf + 0) = *(char *)(buf + 0) & 0xF0;
-	/* RAZ messageType */
-	*(char *)(buf + 0) = *(char *)(buf + 0) | 0x09;
-	/* Table 19 */
-	*(UInteger16 *) (buf + 2) = flip16(DELAY_RESP_LENGTH);
-	*(UInteger8 *) (buf + 4) = header->domainNumber;
-	memset((buf + 8), 0, 8);
+	if (unicast)
+		*(UInteger8 *) (buf + 6) |= UNICAST_FLAG;
+	else
+		*(UInteger8 *) (buf + 6) &= ~UNICAST_FLAG;
+}
 
-	/* Copy correctionField of PdelayReqMessage */
-	*(Integer32 *) (buf + 8) = flip32(header->correctionfield.msb);
-	*(Integer32 *) (buf + 12) = flip32(header->correctionfield.lsb);
+/* set the messageLength of a message that carries TLVs */
+void 
+msgPackMessageLength(char *buf, UInteger16 length)
+{
+	length = flip16(length);
+	memcpy(buf + 2, &length, 2);
+}
 
-	*(UInteger16 *) (buf + 30) = flip16(header->sequenceId);
-	
-	*(UInteger8 *) (buf + 32) = 0x03;
-	/* Table 23 */
-	*(Integer8 *) (buf + 33) = ptpClock->logMinDelayReqInterval;
-	/* Table 24 */
+/* set the sequenceId of a message, each send of a template does */
+void 
+msgPackSequenceId(char *buf, UInteger16 sequenceId)
+{
+	sequenceId = flip16(sequenceId);
+	memcpy(buf + 30, &sequenceId, 2);
+}
 
-	/* Pdelay_resp message */
-	*(UInteger16 *) (buf + 34) = 
-		flip16(receivePTP_Timestamp->secondsField.msb);
-	*(UInteger32 *) (buf + 36) = flip32(receivePTP_Timestamp->secondsField.lsb);
-	*(UInteger32 *) (buf + 40) = flip32(receivePTP_Timestamp->nanosecondsField);
-	memcpy((buf + 44), header->sourcePortIdentity.clockIdentity, 
-	       CLOCK_IDENTITY_LENGTH);
-	*(UInteger16 *) (buf + 52) = 
-		flip16(header->sourcePortIdentity.portNumber);
+/* set the correctionField of a message */
+void 
+msgPackCorrectionField(char *buf, Integer64 * correctionfield)
+{
+	MsgCodec<Integer64, MSG_FIELDS(correctionFields), HEADER_LENGTH>::pack(
+		buf, correctionfield);
 }
 
+/* set the time stamp of a message, all of them carry it at the same place */
+void 
+msgPackTimestamp(char *buf, PTP_Timestamp * timestamp)
+{
+	MsgCodec<PTP_Timestamp, MSG_FIELDS(timestampFields), SYNC_LENGTH>::pack(
+		buf, timestamp);
+}
 
+/* set the requestingPortIdentity of a DelayResp, PdelayResp or PdelayRespFollowUp */
+void 
+msgPackRequestingPortIdentity(char *buf, PortIdentity * requesting)
+{
+	MsgCodec<PortIdentity, MSG_FIELDS(requestingFields), DELAY_RESP_LENGTH>::pack(
+		buf, requesting);
+}
 
+/*Pack Signaling message into OUT buffer of ptpClock, TLVs come after it*/
+void 
+msgPackSignaling(char *buf, PortIdentity * target, PtpClock * ptpClock)
+{
+	MsgSignaling signaling;
 
+	/* Table 19, Table 23 */
+	msgPackMessageFields(buf, SIGNALING, SIGNALING_LENGTH, NULL, 
+			     ptpClock->sentSignalingSequenceId, 0x05, 0x7F);
 
-/*pack PdelayResp message into OUT buffer of ptpClock*/
+	/* Signaling message */
+	signaling.targetPortIdentity = *target;
+	MsgCodec<MsgSignaling, MSG_FIELDS(signalingFields), SIGNALING_LENGTH>::pack(
+		buf, &signaling);
+}
+
+/*Unpack Signaling message from IN buffer, the TLVs are left in place*/
 void 
-msgPackPDelayResp(char *buf, MsgHeader * header, PTP_Timestamp * requestReceiptPTP_Timestamp, PtpClock * ptpClock)
+msgUnpackSignaling(char *buf, MsgSignaling * signaling)
 {
-	/* changes in header */
-	*(char *)(buf + 0) = *(char *)(buf + 0) & 0xF0;
-	/* RAZ messageType */
-	*(char *)(buf + 0) = *(char *)(buf + 0) | 0x03;
-	/* Table 19 */
-	*(UInteger16 *) (buf + 2) = flip16(PDELAY_RESP_LENGTH);
-	*(UInteger8 *) (buf + 4) = header->domainNumber;
-	memset((buf + 8), 0, 8);
+	MsgCodec<MsgSignaling, MSG_FIELDS(signalingFields), SIGNALING_LENGTH>::unpack(
+		buf, signaling);
+	signaling->tlv = buf + SIGNALING_LENGTH;
+}
 
+/*
+ * Pack Management message into OUT buffer of ptpClock, its TLV is
+ * packed after it by the caller, which also sets the sequenceId and
+ * the messageLength. return the number of bytes it takes
+ */
+UInteger16 
+msgPackManagement(char *buf, MsgManagement * manage, PtpClock * ptpClock)
+{
+	/* Table 19, Table 23 */
+	msgPackMessageFields(buf, MANAGEMENT, MANAGEMENT_LENGTH, NULL, 
+			     0, 0x04, 0x7F);
+
+	/* Management message */
+	MsgCodec<MsgManagement, MSG_FIELDS(managementFields), MANAGEMENT_LENGTH>::pack(
+		buf, manage);
+	return MANAGEMENT_LENGTH;
+}
 
-	*(UInteger16 *) (buf + 30) = flip16(header->sequenceId);
+/*Unpack Management message from IN buffer, the TLV is left in place*/
+void 
+msgUnpackManagement(char *buf, MsgManagement * manage)
+{
+	MsgCodec<MsgManagement, MSG_FIELDS(managementFields), MANAGEMENT_LENGTH>::unpack(
+		buf, manage);
+	manage->tlv = buf + MANAGEMENT_LENGTH;
+}
 
-	*(UInteger8 *) (buf + 32) = 0x05;
-	/* Table 23 */
-	*(Integer8 *) (buf + 33) = 0x7F;
-	/* Table 24 */
+/*
+ * Pack a unicast negotiation TLV at buf (spec 16.1.4), return the
+ * number of bytes it takes
+ */
+UInteger16 
+msgPackUnicastTLV(char *buf, MsgUnicastTLV * tlv)
+{
+	MsgUnicastTLV packed = *tlv;
+
+	switch (tlv->tlvType) {
+	case REQUEST_UNICAST_TRANSMISSION:
+		packed.lengthField = REQUEST_UNICAST_TLV_LENGTH;
+		MsgCodec<MsgUnicastTLV, MSG_FIELDS(requestUnicastFields),
+			TLV_HEADER_LENGTH + REQUEST_UNICAST_TLV_LENGTH>::pack(
+				buf, &packed);
+		break;
+	case GRANT_UNICAST_TRANSMISSION:
+		packed.lengthField = GRANT_UNICAST_TLV_LENGTH;
+		MsgCodec<MsgUnicastTLV, MSG_FIELDS(grantUnicastFields),
+			TLV_HEADER_LENGTH + GRANT_UNICAST_TLV_LENGTH>::pack(
+				buf, &packed);
+		break;
+	default:
+		packed.lengthField = CANCEL_UNICAST_TLV_LENGTH;
+		MsgCodec<MsgUnicastTLV, MSG_FIELDS(cancelUnicastFields),
+			TLV_HEADER_LENGTH + CANCEL_UNICAST_TLV_LENGTH>::pack(
+				buf, &packed);
+		break;
+	}
+	return TLV_HEADER_LENGTH + packed.lengthField;
+}
 
-	/* Pdelay_resp message */
-	*(UInteger16 *) (buf + 34) = flip16(requestReceiptPTP_Timestamp->secondsField.msb);
-	*(UInteger32 *) (buf + 36) = flip32(requestReceiptPTP_Timestamp->secondsField.lsb);
-	*(UInteger32 *) (buf + 40) = flip32(requestReceiptPTP_Timestamp->nanosecondsField);
-	memcpy((buf + 44), header->sourcePortIdentity.clockIdentity, CLOCK_IDENTITY_LENGTH);
-	*(UInteger16 *) (buf + 52) = flip16(header->sourcePortIdentity.portNumber);
+/*
+ * Unpack the TLV at buf, 'length' bytes of the message are left from
+ * there. return the number of bytes it takes, 0 if it is cut short
+ */
+UInteger16 
+msgUnpackUnicastTLV(char *buf, ssize_t length, MsgUnicastTLV * tlv)
+{
+	UInteger16 lengthField;
+
+	if (length < TLV_HEADER_LENGTH)
+		return 0;
+	memcpy(&lengthField, buf + 2, 2);
+	lengthField = flip16(lengthField);
+	if (TLV_HEADER_LENGTH + lengthField > length)
+		return 0;
+
+	memset(tlv, 0, sizeof(*tlv));
+	if (lengthField >= GRANT_UNICAST_TLV_LENGTH)
+		MsgCodec<MsgUnicastTLV, MSG_FIELDS(grantUnicastFields),
+			TLV_HEADER_LENGTH + GRANT_UNICAST_TLV_LENGTH>::unpack(
+				buf, tlv);
+	else if (lengthField >= REQUEST_UNICAST_TLV_LENGTH)
+		MsgCodec<MsgUnicastTLV, MSG_FIELDS(requestUnicastFields),
+			TLV_HEADER_LENGTH + REQUEST_UNICAST_TLV_LENGTH>::unpack(
+				buf, tlv);
+	else if (lengthField >= CANCEL_UNICAST_TLV_LENGTH)
+		MsgCodec<MsgUnicastTLV, MSG_FIELDS(cancelUnicastFields),
+			TLV_HEADER_LENGTH + CANCEL_UNICAST_TLV_LENGTH>::unpack(
+				buf, tlv);
+	else {
+		memcpy(&tlv->tlvType, buf + 0, 2);
+		tlv->tlvType = flip16(tlv->tlvType);
+		tlv->lengthField = lengthField;
+	}
+	return TLV_HEADER_LENGTH + lengthField;
+}
+
+/*pack delayResp message into OUT buffer of ptpClock*/
+void 
+msgPackDelayResp(char *buf, MsgHeader * header, PTP_Timestamp * receivePTP_Timestamp, PtpClock * ptpClock)
+{
+	MsgDelayResp resp;
+
+	/* Table 19, Table 23, correctionField of the DelayReq */
+	msgPackMessageFields(buf, DELAY_RESP, DELAY_RESP_LENGTH, 
+			     &header->correctionfield, header->sequenceId, 
+			     0x03, ptpClock->logMinDelayReqInterval);
+
+	/* Delay_resp message */
+	resp.receivePTP_Timestamp = *receivePTP_Timestamp;
+	resp.requestingPortIdentity = header->sourcePortIdentity;
+	MsgCodec<MsgDelayResp, MSG_FIELDS(delayRespFields), DELAY_RESP_LENGTH>::pack(
+		buf, &resp);
+}
+
+
+
+
+
+/*pack PdelayResp message into OUT buffer of ptpClock*/
+void 
+msgPackPDelayResp(char *buf, MsgHeader * header, PTP_Timestamp * requestReceiptPTP_Timestamp, PtpClock * ptpClock)
+{
+	MsgPDelayResp presp;
+
+	/* Table 19, Table 23, Table 24 */
+	msgPackMessageFields(buf, PDELAY_RESP, PDELAY_RESP_LENGTH, NULL, 
+			     header->sequenceId, 0x05, 0x7F);
 
+	/* Pdelay_resp message */
+	presp.requestReceiptPTP_Timestamp = *requestReceiptPTP_Timestamp;
+	presp.requestingPortIdentity = header->sourcePortIdentity;
+	MsgCodec<MsgPDelayResp, MSG_FIELDS(pdelayRespFields), PDELAY_RESP_LENGTH>::pack(
+		buf, &presp);
 }
 
 
@@ -326,12 +709,8 @@ msgPackPDelayResp(char *buf, MsgHeader * header, PTP_Timestamp * requestReceiptP
 void 
 msgUnpackDelayReq(char *buf, MsgDelayReq * delayreq)
 {
-	delayreq->originPTP_Timestamp.secondsField.msb = 
-		flip16(*(UInteger16 *) (buf + 34));
-	delayreq->originPTP_Timestamp.secondsField.lsb = 
-		flip32(*(UInteger32 *) (buf + 36));
-	delayreq->originPTP_Timestamp.nanosecondsField = 
-		flip32(*(UInteger32 *) (buf + 40));
+	MsgCodec<MsgDelayReq, MSG_FIELDS(delayReqFields), DELAY_REQ_LENGTH>::unpack(
+		buf, delayreq);
 
 #ifdef PTPD_DBG
 	msgDelayReq_display(delayreq);
@@ -344,12 +723,8 @@ msgUnpackDelayReq(char *buf, MsgDelayReq * delayreq)
 void 
 msgUnpackPDelayReq(char *buf, MsgPDelayReq * pdelayreq)
 {
-	pdelayreq->originPTP_Timestamp.secondsField.msb = 
-		flip16(*(UInteger16 *) (buf + 34));
-	pdelayreq->originPTP_Timestamp.secondsField.lsb = 
-		flip32(*(UInteger32 *) (buf + 36));
-	pdelayreq->originPTP_Timestamp.nanosecondsField = 
-		flip32(*(UInteger32 *) (buf + 40));
+	MsgCodec<MsgPDelayReq, MSG_FIELDS(pdelayReqFields), PDELAY_REQ_LENGTH>::unpack(
+		buf, pdelayreq);
 
 #ifdef PTPD_DBG
 	msgPDelayReq_display(pdelayreq);
@@ -362,16 +737,8 @@ msgUnpackPDelayReq(char *buf, MsgPDelayReq * pdelayreq)
 void 
 msgUnpackDelayResp(char *buf, MsgDelayResp * resp)
 {
-	resp->receivePTP_Timestamp.secondsField.msb = 
-		flip16(*(UInteger16 *) (buf + 34));
-	resp->receivePTP_Timestamp.secondsField.lsb = 
-		flip32(*(UInteger32 *) (buf + 36));
-	resp->receivePTP_Timestamp.nanosecondsField = 
-		flip32(*(UInteger32 *) (buf + 40));
-	memcpy(resp->requestingPortIdentity.clockIdentity, 
-	       (buf + 44), CLOCK_IDENTITY_LENGTH);
-	resp->requestingPortIdentity.portNumber = 
-		flip16(*(UInteger16 *) (buf + 52));
+	MsgCodec<MsgDelayResp, MSG_FIELDS(delayRespFields), DELAY_RESP_LENGTH>::unpack(
+		buf, resp);
 
 #ifdef PTPD_DBG
 	msgDelayResp_display(resp);
@@ -383,16 +750,8 @@ msgUnpackDelayResp(char *buf, MsgDelayResp * resp)
 void 
 msgUnpackPDelayResp(char *buf, MsgPDelayResp * presp)
 {
-	presp->requestReceiptPTP_Timestamp.secondsField.msb = 
-		flip16(*(UInteger16 *) (buf + 34));
-	presp->requestReceiptPTP_Timestamp.secondsField.lsb = 
-		flip32(*(UInteger32 *) (buf + 36));
-	presp->requestReceiptPTP_Timestamp.nanosecondsField = 
-		flip32(*(UInteger32 *) (buf + 40));
-	memcpy(presp->requestingPortIdentity.clockIdentity, 
-	       (buf + 44), CLOCK_IDENTITY_LENGTH);
-	presp->requestingPortIdentity.portNumber = 
-		flip16(*(UInteger16 *) (buf + 52));
+	MsgCodec<MsgPDelayResp, MSG_FIELDS(pdelayRespFields), PDELAY_RESP_LENGTH>::unpack(
+		buf, presp);
 
 #ifdef PTPD_DBG
 	msgPDelayResp_display(presp);
@@ -403,54 +762,66 @@ msgUnpackPDelayResp(char *buf, MsgPDelayResp * presp)
 void 
 msgPackPDelayRespFollowUp(char *buf, MsgHeader * header, PTP_Timestamp * responseOriginPTP_Timestamp, PtpClock * ptpClock)
 {
-	/* changes in header */
-	*(char *)(buf + 0) = *(char *)(buf + 0) & 0xF0;
-	/* RAZ messageType */
-	*(char *)(buf + 0) = *(char *)(buf + 0) | 0x0A;
-	/* Table 19 */
-	*(UInteger16 *) (buf + 2) = flip16(PDELAY_RESP_FOLLOW_UP_LENGTH);
-	*(UInteger16 *) (buf + 30) = flip16(ptpClock->PdelayReqHeader.sequenceId);
-	*(UInteger8 *) (buf + 32) = 0x05;
-	/* Table 23 */
-	*(Integer8 *) (buf + 33) = 0x7F;
-	/* Table 24 */
-
-	/* Copy correctionField of PdelayReqMessage */
-	*(Integer32 *) (buf + 8) = flip32(header->correctionfield.msb);
-	*(Integer32 *) (buf + 12) = flip32(header->correctionfield.lsb);
+	MsgPDelayRespFollowUp prespfollow;
+
+	/* Table 19, Table 23, correctionField of the PdelayReq */
+	msgPackMessageFields(buf, PDELAY_RESP_FOLLOW_UP, 
+			     PDELAY_RESP_FOLLOW_UP_LENGTH, 
+			     &header->correctionfield, 
+			     ptpClock->PdelayReqHeader.sequenceId, 0x05, 0x7F);
 
 	/* Pdelay_resp_follow_up message */
-	*(UInteger16 *) (buf + 34) = 
-		flip16(responseOriginPTP_Timestamp->secondsField.msb);
-	*(UInteger32 *) (buf + 36) = 
-		flip32(responseOriginPTP_Timestamp->secondsField.lsb);
-	*(UInteger32 *) (buf + 40) = 
-		flip32(responseOriginPTP_Timestamp->nanosecondsField);
-	memcpy((buf + 44), header->sourcePortIdentity.clockIdentity, 
-	       CLOCK_IDENTITY_LENGTH);
-	*(UInteger16 *) (buf + 52) = 
-		flip16(header->sourcePortIdentity.portNumber);
+	prespfollow.responseOriginPTP_Timestamp = *responseOriginPTP_Timestamp;
+	prespfollow.requestingPortIdentity = header->sourcePortIdentity;
+	MsgCodec<MsgPDelayRespFollowUp, MSG_FIELDS(pdelayRespFollowUpFields), 
+		PDELAY_RESP_FOLLOW_UP_LENGTH>::pack(buf, &prespfollow);
 }
 
 /*Unpack PdelayResp message from IN buffer of ptpClock to msgtmp.presp*/
 void 
 msgUnpackPDelayRespFollowUp(char *buf, MsgPDelayRespFollowUp * prespfollow)
 {
-	prespfollow->responseOriginPTP_Timestamp.secondsField.msb = 
-		flip16(*(UInteger16 *) (buf + 34));
-	prespfollow->responseOriginPTP_Timestamp.secondsField.lsb = 
-		flip32(*(UInteger32 *) (buf + 36));
-	prespfollow->responseOriginPTP_Timestamp.nanosecondsField = 
-		flip32(*(UInteger32 *) (buf + 40));
-	memcpy(prespfollow->requestingPortIdentity.clockIdentity, 
-	       (buf + 44), CLOCK_IDENTITY_LENGTH);
-	prespfollow->requestingPortIdentity.portNumber = 
-		flip16(*(UInteger16 *) (buf + 52));
+	MsgCodec<MsgPDelayRespFollowUp, MSG_FIELDS(pdelayRespFollowUpFields), 
+		PDELAY_RESP_FOLLOW_UP_LENGTH>::unpack(buf, prespfollow);
 }
 
 
+/**
+ * Pre-encode every message we send, but Signaling, into
+ * ptpClock->msgTemplate. A send then only patches the sequenceId, time
+ * stamp, correctionField and requestingPortIdentity of its template.
+ * Called again whenever the data sets the messages carry change.
+ *
+ * @param ptpClock The central clock structure
+ */
+void 
+msgPackTemplates(PtpClock * ptpClock)
+{
+	PTP_Timestamp zero;
+	MsgHeader header;
+	int i;
+
+	memset(&zero, 0, sizeof(zero));
+	memset(&header, 0, sizeof(header));
+	for (i = 0; i < 16; i++)
+		msgPackHeader(ptpClock->msgTemplate[i], ptpClock);
+
+	msgPackSync(ptpClock->msgTemplate[SYNC], &zero, ptpClock);
+	msgPackDelayReq(ptpClock->msgTemplate[DELAY_REQ], &zero, ptpClock);
+	msgPackPDelayReq(ptpClock->msgTemplate[PDELAY_REQ], &zero, ptpClock);
+	msgPackPDelayResp(ptpClock->msgTemplate[PDELAY_RESP], &header, &zero,
+			  ptpClock);
+	msgPackFollowUp(ptpClock->msgTemplate[FOLLOW_UP], &zero, ptpClock);
+	msgPackDelayResp(ptpClock->msgTemplate[DELAY_RESP], &header, &zero,
+			 ptpClock);
+	msgPackPDelayRespFollowUp(ptpClock->msgTemplate[PDELAY_RESP_FOLLOW_UP],
+				  &header, &zero, ptpClock);
+	msgPackAnnounce(ptpClock->msgTemplate[ANNOUNCE], ptpClock);
+}
+
 /** 
- * Dump the most recent packet in the daemon
+ * Dump the packet being handled by the daemon. The handlers only read
+ * the fields they use, so it is unpacked here.
  * 
  * @param ptpClock The central clock structure
  */
@@ -460,26 +831,36 @@ void msgDump(PtpClock *ptpClock)
 #if defined(freebsd)
 	static int dumped = 0;
 #endif /* FreeBSD */
+	Octet *buf = ptpClock->msgRecv;
+
+	if (!buf)
+		return;
 
+	msgUnpackHeader(buf, &ptpClock->msgTmpHeader);
 	msgDebugHeader(&ptpClock->msgTmpHeader);
 	switch (ptpClock->msgTmpHeader.messageType) {
 	case SYNC:
+		msgUnpackSync(buf, &ptpClock->sync);
 		msgDebugSync(&ptpClock->sync);
 		break;
     
 	case ANNOUNCE:
+		msgUnpackAnnounce(buf, &ptpClock->announce);
 		msgDebugAnnounce(&ptpClock->announce);
 		break;
     
 	case FOLLOW_UP:
+		msgUnpackFollowUp(buf, &ptpClock->follow);
 		msgDebugFollowUp(&ptpClock->follow);
 		break;
     
 	case DELAY_REQ:
+		msgUnpackDelayReq(buf, &ptpClock->req);
 		msgDebugDelayReq(&ptpClock->req);
 		break;
     
 	case DELAY_RESP:
+		msgUnpackDelayResp(buf, &ptpClock->resp);
 		msgDebugDelayResp(&ptpClock->resp);
 		break;
     
@@ -8,36 +8,41 @@
  */
 
 #include "ptpd.hh"
+#include "ptpd2pack.hh"
 #include <netdb.h>
+#include <click/ip6address.hh>
+#include <clicknet/ether.h>
 
-/* shut down the UDP stuff */
+/* shut down the UDP or Ethernet stuff */
 bool 
 netShutdown(NetPath * netPath)
 {
 	struct ip_mreq imr;
 
-	/* Close General Multicast */
-	imr.imr_multiaddr.s_addr = netPath->multicastAddr;
-	imr.imr_interface.s_addr = htonl(INADDR_ANY);
-
-	setsockopt(netPath->eventSock, IPPROTO_IP, IP_DROP_MEMBERSHIP, 
-		   &imr, sizeof(struct ip_mreq));
-	setsockopt(netPath->generalSock, IPPROTO_IP, IP_DROP_MEMBERSHIP, 
-		   &imr, sizeof(struct ip_mreq));
-
-	/* Close Peer Multicast */
-	imr.imr_multiaddr.s_addr = netPath->peerMulticastAddr;
-	imr.imr_interface.s_addr = htonl(INADDR_ANY);
-
-	setsockopt(netPath->eventSock, IPPROTO_IP, IP_DROP_MEMBERSHIP, 
-		   &imr, sizeof(struct ip_mreq));
-	setsockopt(netPath->generalSock, IPPROTO_IP, IP_DROP_MEMBERSHIP, 
-		   &imr, sizeof(struct ip_mreq));
-
+	/* other sockets leave their groups when they are closed */
+	if (netPath->transport == UDP_IPV4) {
+		/* Close General Multicast */
+		imr.imr_multiaddr = netPath->multicastAddr.in.sin_addr;
+		imr.imr_interface.s_addr = htonl(INADDR_ANY);
+
+		setsockopt(netPath->eventSock, IPPROTO_IP, IP_DROP_MEMBERSHIP, 
+			   &imr, sizeof(struct ip_mreq));
+		setsockopt(netPath->generalSock, IPPROTO_IP, IP_DROP_MEMBERSHIP, 
+			   &imr, sizeof(struct ip_mreq));
+
+		/* Close Peer Multicast */
+		imr.imr_multiaddr = netPath->peerMulticastAddr.in.sin_addr;
+		imr.imr_interface.s_addr = htonl(INADDR_ANY);
+
+		setsockopt(netPath->eventSock, IPPROTO_IP, IP_DROP_MEMBERSHIP, 
+			   &imr, sizeof(struct ip_mreq));
+		setsockopt(netPath->generalSock, IPPROTO_IP, IP_DROP_MEMBERSHIP, 
+			   &imr, sizeof(struct ip_mreq));
+	}
 
-	netPath->multicastAddr = 0;
-	netPath->unicastAddr = 0;
-	netPath->peerMulticastAddr = 0;
+	memset(&netPath->multicastAddr, 0, sizeof(NetAddress));
+	memset(&netPath->unicastAddr, 0, sizeof(NetAddress));
+	memset(&netPath->peerMulticastAddr, 0, sizeof(NetAddress));
 
 	/* Close sockets */
 	if (netPath->eventSock > 0)
@@ -48,6 +53,17 @@ netShutdown(NetPath * netPath)
 		close(netPath->generalSock);
 	netPath->generalSock = -1;
 
+	/* closing the descriptors also drops their epoll registrations */
+	if (netPath->timerFd > 0)
+		close(netPath->timerFd);
+	netPath->timerFd = -1;
+
+	if (netPath->epollFd > 0)
+		close(netPath->epollFd);
+	netPath->epollFd = -1;
+	netPath->ready = 0;
+	netPath->txCount = 0;
+
 	return TRUE;
 }
 
@@ -235,8 +251,423 @@ findIface(Octet * ifaceName, UInteger8 * communicationTechnology,
 }
 
 
+/* a UDP/IPv4 address; netSend() sets the port of each message */
+void 
+netInetAddress(NetAddress * addr, in_addr_t s_addr)
+{
+	memset(addr, 0, sizeof(NetAddress));
+	addr->in.sin_family = AF_INET;
+	addr->in.sin_addr.s_addr = s_addr;
+	addr->len = sizeof(struct sockaddr_in);
+}
+
+/* a UDP/IPv6 address; 'ifindex' scopes link-local addresses */
+void 
+netInet6Address(NetAddress * addr, const struct in6_addr * in6, int ifindex)
+{
+	memset(addr, 0, sizeof(NetAddress));
+	addr->in6.sin6_family = AF_INET6;
+	addr->in6.sin6_addr = *in6;
+	addr->in6.sin6_scope_id = ifindex;
+	addr->len = sizeof(struct sockaddr_in6);
+}
+
+/* look up a UDP/IPv6 host name or address */
+static bool 
+netInet6Lookup(NetAddress * addr, const char *host, int ifindex)
+{
+	struct addrinfo hints, *res;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET6;
+	hints.ai_socktype = SOCK_DGRAM;
+	if (getaddrinfo(host, NULL, &hints, &res) != 0) {
+		ERROR("failed to encode address: %s\n", host);
+		return FALSE;
+	}
+	netInet6Address(addr, &((struct sockaddr_in6 *)res->ai_addr)->sin6_addr, 
+			ifindex);
+	freeaddrinfo(res);
+	return TRUE;
+}
+
+/* an Ethernet address on interface 'ifindex' (0 in packet mode) */
+void 
+netEtherAddress(NetAddress * addr, const UInteger8 * mac, int ifindex)
+{
+	memset(addr, 0, sizeof(NetAddress));
+	addr->ll.sll_family = AF_PACKET;
+	addr->ll.sll_protocol = htons(PTP_ETHER_TYPE);
+	addr->ll.sll_ifindex = ifindex;
+	addr->ll.sll_halen = ETHER_ADDRESS_LENGTH;
+	memcpy(addr->ll.sll_addr, mac, ETHER_ADDRESS_LENGTH);
+	addr->len = sizeof(struct sockaddr_ll);
+}
+
+/* 
+ * create the epoll instance and the deadline timerfd, and register the
+ * open sockets with it once; netSelect() then only waits on 'epollFd'
+ */
+static bool 
+netInitReactor(NetPath * netPath)
+{
+	struct epoll_event ev;
+
+	if ((netPath->epollFd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+		PERROR("failed to create epoll instance");
+		return FALSE;
+	}
+	if ((netPath->timerFd = timerfd_create(CLOCK_MONOTONIC, 
+					       TFD_NONBLOCK | TFD_CLOEXEC)) < 0) {
+		PERROR("failed to create timer descriptor");
+		return FALSE;
+	}
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = netPath->timerFd;
+	if (epoll_ctl(netPath->epollFd, EPOLL_CTL_ADD, netPath->timerFd, &ev) < 0) {
+		PERROR("failed to watch timer descriptor");
+		return FALSE;
+	}
+	if (netPath->eventSock >= 0) {
+		ev.data.fd = netPath->eventSock;
+		if (epoll_ctl(netPath->epollFd, EPOLL_CTL_ADD, 
+			      netPath->eventSock, &ev) < 0) {
+			PERROR("failed to watch event socket");
+			return FALSE;
+		}
+	}
+	if (netPath->generalSock >= 0) {
+		ev.data.fd = netPath->generalSock;
+		if (epoll_ctl(netPath->epollFd, EPOLL_CTL_ADD, 
+			      netPath->generalSock, &ev) < 0) {
+			PERROR("failed to watch general socket");
+			return FALSE;
+		}
+	}
+	netPath->ready = 0;
+	return TRUE;
+}
+
+/* 
+ * make PTP_Timestamps available through recvmsg() on the UDP sockets,
+ * with nanosecond resolution: software SO_TIMESTAMPING where the
+ * kernel has it, SO_TIMESTAMPNS otherwise. with SO_TIMESTAMPING the
+ * event socket also reports the send time of each message on its
+ * error queue, see netRecvTxTimestamp()
+ */
+static bool 
+netInitTimestamping(NetPath * netPath)
+{
+	int temp, tsFlags;
+
+	netPath->txTimestamping = FALSE;
+#if defined(linux)
+	temp = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+	tsFlags = temp | SOF_TIMESTAMPING_TX_SOFTWARE;
+	if (setsockopt(netPath->eventSock, SOL_SOCKET, SO_TIMESTAMPING, 
+		       &tsFlags, sizeof(int)) < 0
+	    || setsockopt(netPath->generalSock, SOL_SOCKET, SO_TIMESTAMPING, 
+			  &temp, sizeof(int)) < 0) {
+		DBG("SO_TIMESTAMPING not available, using SO_TIMESTAMPNS\n");
+		/* no stray send time stamps on the error queue */
+		temp = 0;
+		setsockopt(netPath->eventSock, SOL_SOCKET, SO_TIMESTAMPING, 
+			   &temp, sizeof(int));
+		temp = 1;
+		if (setsockopt(netPath->eventSock, SOL_SOCKET, SO_TIMESTAMPNS, 
+			       &temp, sizeof(int)) < 0
+		    || setsockopt(netPath->generalSock, SOL_SOCKET, 
+				  SO_TIMESTAMPNS, &temp, sizeof(int)) < 0) {
+			PERROR("failed to enable receive time stamps");
+			return FALSE;
+		}
+	} else
+		netPath->txTimestamping = TRUE;
+#else /* FreeBSD */
+	temp = 1;
+	if (setsockopt(netPath->eventSock, SOL_SOCKET, SO_BINTIME, 
+		       &temp, sizeof(int)) < 0
+	    || setsockopt(netPath->generalSock, SOL_SOCKET, SO_BINTIME, 
+			  &temp, sizeof(int)) < 0) {
+		PERROR("failed to enable receive time stamps");
+		return FALSE;
+	}
+#endif
+	return TRUE;
+}
+
+/* 
+ * set up packet mode: no sockets, only the destination addresses that
+ * are put in the annotations of the packets the element emits
+ */
+static bool 
+netInitPackets(NetPath * netPath, RunTimeOpts * rtOpts)
+{
+	static const UInteger8 ptpEther[] = DEFAULT_PTP_ETHER_ADDRESS;
+	static const UInteger8 peerEther[] = PEER_PTP_ETHER_ADDRESS;
+	struct in_addr netAddr;
+	char addrStr[NET_ADDRESS6_LENGTH];
+
+	close(netPath->eventSock);
+	netPath->eventSock = -1;
+	close(netPath->generalSock);
+	netPath->generalSock = -1;
+
+	if (netPath->transport == IEE_802_3) {
+		netEtherAddress(&netPath->multicastAddr, ptpEther, 0);
+		netEtherAddress(&netPath->peerMulticastAddr, peerEther, 0);
+		memset(&netPath->unicastAddr, 0, sizeof(NetAddress));
+		return netInitReactor(netPath);
+	}
+	if (netPath->transport == UDP_IPV6) {
+		if (rtOpts->unicastAddress[0]) {
+			if (!netInet6Lookup(&netPath->unicastAddr, 
+					    rtOpts->unicastAddress, 0))
+				return FALSE;
+		} else
+			memset(&netPath->unicastAddr, 0, sizeof(NetAddress));
+		snprintf(addrStr, sizeof(addrStr), DEFAULT_PTP_DOMAIN_ADDRESS6, 
+			 rtOpts->ipv6Scope);
+		if (!netInet6Lookup(&netPath->multicastAddr, addrStr, 0)
+		    || !netInet6Lookup(&netPath->peerMulticastAddr, 
+				       PEER_PTP_DOMAIN_ADDRESS6, 0))
+			return FALSE;
+		return netInitReactor(netPath);
+	}
+
+	if (rtOpts->unicastAddress[0]) {
+		if (!inet_aton(rtOpts->unicastAddress, &netAddr)) {
+			ERROR("failed to encode uni-cast address: %s\n",
+			      rtOpts->unicastAddress);
+			return FALSE;
+		}
+		netInetAddress(&netPath->unicastAddr, netAddr.s_addr);
+	} else
+		memset(&netPath->unicastAddr, 0, sizeof(NetAddress));
+
+	if (!inet_aton(DEFAULT_PTP_DOMAIN_ADDRESS, &netAddr)) {
+		ERROR("failed to encode multi-cast address: %s\n", 
+		      DEFAULT_PTP_DOMAIN_ADDRESS);
+		return FALSE;
+	}
+	netInetAddress(&netPath->multicastAddr, netAddr.s_addr);
+
+	if (!inet_aton(PEER_PTP_DOMAIN_ADDRESS, &netAddr)) {
+		ERROR("failed to encode multi-cast address: %s\n", 
+		      PEER_PTP_DOMAIN_ADDRESS);
+		return FALSE;
+	}
+	netInetAddress(&netPath->peerMulticastAddr, netAddr.s_addr);
+
+	return netInitReactor(netPath);
+}
+
+/* 
+ * start the UDP/IPv6 stuff: the same two sockets and time stamping as
+ * for UDP/IPv4, on FF0X::181 and FF02::6B. see the 'ipv6(7)' man page
+ */
+static bool 
+netInitInet6(NetPath * netPath, RunTimeOpts * rtOpts)
+{
+	struct sockaddr_in6 addr;
+	struct ipv6_mreq mreq;
+	char addrStr[NET_ADDRESS6_LENGTH];
+	const NetAddress *groups[2];
+	int i, ifindex, temp;
+
+	close(netPath->eventSock);
+	netPath->eventSock = -1;
+	close(netPath->generalSock);
+	netPath->generalSock = -1;
+
+	if (!(ifindex = if_nametoindex(rtOpts->ifaceName))) {
+		PERROR("failed to get interface index");
+		return FALSE;
+	}
+	if ((netPath->eventSock = socket(PF_INET6, SOCK_DGRAM, IPPROTO_UDP)) < 0
+	    || (netPath->generalSock = socket(PF_INET6, SOCK_DGRAM, 
+					      IPPROTO_UDP)) < 0) {
+		PERROR("failed to initalize sockets");
+		return FALSE;
+	}
+
+	temp = 1;
+	if (setsockopt(netPath->eventSock, IPPROTO_IPV6, IPV6_V6ONLY, 
+		       &temp, sizeof(int)) < 0
+	    || setsockopt(netPath->generalSock, IPPROTO_IPV6, IPV6_V6ONLY, 
+			  &temp, sizeof(int)) < 0) {
+		PERROR("failed to restrict sockets to IPv6");
+		return FALSE;
+	}
+	if (setsockopt(netPath->eventSock, SOL_SOCKET, SO_REUSEADDR, 
+		       &temp, sizeof(int)) < 0
+	    || setsockopt(netPath->generalSock, SOL_SOCKET, SO_REUSEADDR, 
+			  &temp, sizeof(int)) < 0) {
+		DBG("failed to set socket reuse\n");
+	}
+	/* bind sockets, to any address for multi-cast and uni-cast */
+	memset(&addr, 0, sizeof(addr));
+	addr.sin6_family = AF_INET6;
+	addr.sin6_addr = in6addr_any;
+	addr.sin6_port = htons(PTP_EVENT_PORT);
+	if (bind(netPath->eventSock, (struct sockaddr *)&addr, 
+		 sizeof(struct sockaddr_in6)) < 0) {
+		PERROR("failed to bind event socket");
+		return FALSE;
+	}
+	addr.sin6_port = htons(PTP_GENERAL_PORT);
+	if (bind(netPath->generalSock, (struct sockaddr *)&addr, 
+		 sizeof(struct sockaddr_in6)) < 0) {
+		PERROR("failed to bind general socket");
+		return FALSE;
+	}
+
+	if (rtOpts->unicastAddress[0]) {
+		if (!netInet6Lookup(&netPath->unicastAddr, 
+				    rtOpts->unicastAddress, ifindex))
+			return FALSE;
+	} else
+		memset(&netPath->unicastAddr, 0, sizeof(NetAddress));
+
+	snprintf(addrStr, sizeof(addrStr), DEFAULT_PTP_DOMAIN_ADDRESS6, 
+		 rtOpts->ipv6Scope);
+	if (!netInet6Lookup(&netPath->multicastAddr, addrStr, ifindex)
+	    || !netInet6Lookup(&netPath->peerMulticastAddr, 
+			       PEER_PTP_DOMAIN_ADDRESS6, ifindex))
+		return FALSE;
+
+	/* multicast send only on specified interface */
+	if (setsockopt(netPath->eventSock, IPPROTO_IPV6, IPV6_MULTICAST_IF, 
+		       &ifindex, sizeof(int)) < 0
+	    || setsockopt(netPath->generalSock, IPPROTO_IPV6, IPV6_MULTICAST_IF, 
+			  &ifindex, sizeof(int)) < 0) {
+		PERROR("failed to enable multi-cast on the interface");
+		return FALSE;
+	}
+	/* join both multicast groups (for receiving) on specified interface */
+	groups[0] = &netPath->multicastAddr;
+	groups[1] = &netPath->peerMulticastAddr;
+	for (i = 0; i < 2; i++) {
+		mreq.ipv6mr_multiaddr = groups[i]->in6.sin6_addr;
+		mreq.ipv6mr_interface = ifindex;
+		if (setsockopt(netPath->eventSock, IPPROTO_IPV6, IPV6_ADD_MEMBERSHIP, 
+			       &mreq, sizeof(struct ipv6_mreq)) < 0
+		    || setsockopt(netPath->generalSock, IPPROTO_IPV6, 
+				  IPV6_ADD_MEMBERSHIP, &mreq, 
+				  sizeof(struct ipv6_mreq)) < 0) {
+			PERROR("failed to join the multi-cast group");
+			return FALSE;
+		}
+	}
+
+	if (setsockopt(netPath->eventSock, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, 
+		       &rtOpts->ttl, sizeof(int)) < 0
+	    || setsockopt(netPath->generalSock, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, 
+			  &rtOpts->ttl, sizeof(int)) < 0) {
+		PERROR("failed to set the multi-cast hop limit");
+		return FALSE;
+	}
+
+	if (!netInitTimestamping(netPath))
+		return FALSE;
+
+	/* as for UDP/IPv4, only loop back when there are no send time stamps */
+	temp = !netPath->txTimestamping;
+	if (setsockopt(netPath->eventSock, IPPROTO_IPV6, IPV6_MULTICAST_LOOP, 
+		       &temp, sizeof(int)) < 0
+	    || setsockopt(netPath->generalSock, IPPROTO_IPV6, IPV6_MULTICAST_LOOP, 
+			  &temp, sizeof(int)) < 0) {
+		PERROR("failed to set multi-cast loopback");
+		return FALSE;
+	}
+	return netInitReactor(netPath);
+}
+
+/* 
+ * start the Ethernet stuff: one packet socket, bound to the PTP
+ * ethertype on the interface, carries both event and general
+ * messages. see the 'packet(7)' man page
+ */
+static bool 
+netInitEthernet(NetPath * netPath, RunTimeOpts * rtOpts)
+{
+	static const UInteger8 ptpEther[] = DEFAULT_PTP_ETHER_ADDRESS;
+	static const UInteger8 peerEther[] = PEER_PTP_ETHER_ADDRESS;
+	struct sockaddr_ll addr;
+	struct packet_mreq mreq;
+	int ifindex, tsFlags;
+
+	close(netPath->eventSock);
+	netPath->eventSock = -1;
+	close(netPath->generalSock);
+	netPath->generalSock = -1;
+
+	if (!(ifindex = if_nametoindex(rtOpts->ifaceName))) {
+		PERROR("failed to get interface index");
+		return FALSE;
+	}
+	if ((netPath->eventSock = socket(PF_PACKET, SOCK_DGRAM, 
+					 htons(PTP_ETHER_TYPE))) < 0) {
+		PERROR("failed to initalize packet socket");
+		return FALSE;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sll_family = AF_PACKET;
+	addr.sll_protocol = htons(PTP_ETHER_TYPE);
+	addr.sll_ifindex = ifindex;
+	if (bind(netPath->eventSock, (struct sockaddr *)&addr, 
+		 sizeof(struct sockaddr_ll)) < 0) {
+		PERROR("failed to bind packet socket");
+		return FALSE;
+	}
+
+	netEtherAddress(&netPath->multicastAddr, ptpEther, ifindex);
+	netEtherAddress(&netPath->peerMulticastAddr, peerEther, ifindex);
+	memset(&netPath->unicastAddr, 0, sizeof(NetAddress));
+	if (rtOpts->unicastAddress[0])
+		ERROR("uni-cast address ignored on Ethernet\n");
+
+	/* join both multicast groups (for receiving) on the interface */
+	memset(&mreq, 0, sizeof(mreq));
+	mreq.mr_ifindex = ifindex;
+	mreq.mr_type = PACKET_MR_MULTICAST;
+	mreq.mr_alen = ETHER_ADDRESS_LENGTH;
+	memcpy(mreq.mr_address, ptpEther, ETHER_ADDRESS_LENGTH);
+	if (setsockopt(netPath->eventSock, SOL_PACKET, PACKET_ADD_MEMBERSHIP, 
+		       &mreq, sizeof(mreq)) < 0) {
+		PERROR("failed to join the multi-cast group");
+		return FALSE;
+	}
+	memcpy(mreq.mr_address, peerEther, ETHER_ADDRESS_LENGTH);
+	if (setsockopt(netPath->eventSock, SOL_PACKET, PACKET_ADD_MEMBERSHIP, 
+		       &mreq, sizeof(mreq)) < 0) {
+		PERROR("failed to join the peer multi-cast group");
+		return FALSE;
+	}
+
+	/* 
+	 * our own frames are not looped back to a packet socket, so the
+	 * send times of event messages must come from the error queue
+	 */
+	tsFlags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_TX_SOFTWARE |
+		SOF_TIMESTAMPING_SOFTWARE;
+	if (setsockopt(netPath->eventSock, SOL_SOCKET, SO_TIMESTAMPING, 
+		       &tsFlags, sizeof(int)) < 0) {
+		PERROR("failed to enable time stamping, Ethernet needs "
+		       "SO_TIMESTAMPING");
+		return FALSE;
+	}
+	netPath->txTimestamping = TRUE;
+
+	return netInitReactor(netPath);
+}
+
+
 /** 
- * start all of the UDP stuff 
+ * start all of the UDP/IPv4 stuff, or UDP/IPv6 with rtOpts->ipv6_mode,
+ * or Ethernet with rtOpts->ethernet_mode
  * must specify 'subdomainName', and optionally 'ifaceName', 
  * if not then pass ifaceName == "" 
  * on socket options, see the 'socket(7)' and 'ip' man pages 
@@ -265,15 +696,39 @@ netInit(NetPath * netPath, RunTimeOpts * rtOpts, PtpClock * ptpClock)
 		PERROR("failed to initalize sockets");
 		return FALSE;
 	}
-	/* find a network interface */
+	if (rtOpts->ethernet_mode)
+		netPath->transport = IEE_802_3;
+	else if (rtOpts->ipv6_mode)
+		netPath->transport = UDP_IPV6;
+	else
+		netPath->transport = UDP_IPV4;
+	netPath->txTimestamping = FALSE;
+
+	/* 
+	 * find a network interface; only UDP/IPv4 needs it to have an
+	 * IPv4 address, the others need it to be named instead
+	 */
 	if (!(interfaceAddr.s_addr = 
 	      findIface(rtOpts->ifaceName, 
 			&ptpClock->port_communication_technology,
-			ptpClock->port_uuid_field, netPath)))
+			ptpClock->port_uuid_field, netPath))
+	    && !(netPath->transport != UDP_IPV4 && rtOpts->ifaceName[0]))
 		return FALSE;
+	memcpy(netPath->hwAddr, ptpClock->port_uuid_field, ETHER_ADDRESS_LENGTH);
 
 	DBG("Local IP address used : %s \n", inet_ntoa(interfaceAddr));
 
+	/*
+	 * in packet mode the element's ports carry the messages: the
+	 * sockets were only needed to look up the interface
+	 */
+	if (netPath->element)
+		return netInitPackets(netPath, rtOpts);
+	if (netPath->transport == IEE_802_3)
+		return netInitEthernet(netPath, rtOpts);
+	if (netPath->transport == UDP_IPV6)
+		return netInitInet6(netPath, rtOpts);
+
 	temp = 1;			/* allow address reuse */
 	if (setsockopt(netPath->eventSock, SOL_SOCKET, SO_REUSEADDR, 
 		       &temp, sizeof(int)) < 0
@@ -311,19 +766,19 @@ netInit(NetPath * netPath, RunTimeOpts * rtOpts, PtpClock * ptpClock)
 				       "address");
 				return FALSE;
 			}
-			netPath->unicastAddr = 
-				*(uint32_t *)host->h_addr_list[0];
+			netInetAddress(&netPath->unicastAddr, 
+				       *(uint32_t *)host->h_addr_list[0]);
 		} else {
 			/* Maybe it's a dotted quad. */
 			if (!inet_aton(rtOpts->unicastAddress, &netAddr)) {
 				ERROR("failed to encode uni-cast address: %s\n",
 				      rtOpts->unicastAddress);
 				return FALSE;
-				netPath->unicastAddr = netAddr.s_addr;
 			}
+			netInetAddress(&netPath->unicastAddr, netAddr.s_addr);
                 }
         } else
-                netPath->unicastAddr = 0;
+                memset(&netPath->unicastAddr, 0, sizeof(NetAddress));
  
 	/* Init General multicast IP address */
 	memcpy(addrStr, DEFAULT_PTP_DOMAIN_ADDRESS, NET_ADDRESS_LENGTH);
@@ -332,7 +787,7 @@ netInit(NetPath * netPath, RunTimeOpts * rtOpts, PtpClock * ptpClock)
 		ERROR("failed to encode multi-cast address: %s\n", addrStr);
 		return FALSE;
 	}
-	netPath->multicastAddr = netAddr.s_addr;
+	netInetAddress(&netPath->multicastAddr, netAddr.s_addr);
 
 	/* multicast send only on specified interface */
 	imr.imr_multiaddr.s_addr = netAddr.s_addr;
@@ -362,7 +817,7 @@ netInit(NetPath * netPath, RunTimeOpts * rtOpts, PtpClock * ptpClock)
 		ERROR("failed to encode multi-cast address: %s\n", addrStr);
 		return FALSE;
 	}
-	netPath->peerMulticastAddr = netAddr.s_addr;
+	netInetAddress(&netPath->peerMulticastAddr, netAddr.s_addr);
 
 	/* multicast send only on specified interface */
 	imr.imr_multiaddr.s_addr = netAddr.s_addr;
@@ -395,322 +850,591 @@ netInit(NetPath * netPath, RunTimeOpts * rtOpts, PtpClock * ptpClock)
 		PERROR("failed to set the multi-cast time-to-live");
 		return FALSE;
 	}
-	/* enable loopback */
-	temp = 1;
+	if (!netInitTimestamping(netPath))
+		return FALSE;
+
+	/* 
+	 * without send time stamps we learn the send time of our event
+	 * messages from the looped back copy, so only loop then
+	 */
+	temp = !netPath->txTimestamping;
 	if (setsockopt(netPath->eventSock, IPPROTO_IP, IP_MULTICAST_LOOP, 
 		       &temp, sizeof(int)) < 0
 	    || setsockopt(netPath->generalSock, IPPROTO_IP, IP_MULTICAST_LOOP, 
 			  &temp, sizeof(int)) < 0) {
-		PERROR("failed to enable multi-cast loopback");
+		PERROR("failed to set multi-cast loopback");
 		return FALSE;
 	}
-	/* make PTP_Timestamps available through recvmsg() */
-	temp = 1;
-#if defined(linux)
-	if (setsockopt(netPath->eventSock, SOL_SOCKET, SO_TIMESTAMP, 
-		       &temp, sizeof(int)) < 0
-	    || setsockopt(netPath->generalSock, SOL_SOCKET, SO_TIMESTAMP, 
-			  &temp, sizeof(int)) < 0) {
-		PERROR("failed to enable receive time stamps");
-		return FALSE;
+	return netInitReactor(netPath);
+}
+
+/* jump targets of netFilterPatch(), past the end of any program */
+#define NET_FILTER_ACCEPT  0xFE
+#define NET_FILTER_DROP    0xFF
+
+/* 
+ * point the NET_FILTER_ACCEPT and NET_FILTER_DROP jumps of 'prog' at
+ * its last two statements, which return accept and drop
+ */
+static void 
+netFilterPatch(struct sock_filter * prog, int length)
+{
+	int i;
+
+	for (i = 0; i < length; i++) {
+		if (BPF_CLASS(prog[i].code) != BPF_JMP)
+			continue;
+		if (prog[i].jt == NET_FILTER_ACCEPT)
+			prog[i].jt = length - 2 - i - 1;
+		else if (prog[i].jt == NET_FILTER_DROP)
+			prog[i].jt = length - 1 - i - 1;
+		if (prog[i].jf == NET_FILTER_ACCEPT)
+			prog[i].jf = length - 2 - i - 1;
+		else if (prog[i].jf == NET_FILTER_DROP)
+			prog[i].jf = length - 1 - i - 1;
 	}
-#else /* FreeBSD */
-	if (setsockopt(netPath->eventSock, SOL_SOCKET, SO_BINTIME, 
-		       &temp, sizeof(int)) < 0
-	    || setsockopt(netPath->generalSock, SOL_SOCKET, SO_BINTIME, 
-			  &temp, sizeof(int)) < 0) {
-		PERROR("failed to enable receive time stamps");
+}
+
+static void 
+netFilterAdd(struct sock_filter * prog, int *n, UInteger16 code, 
+	     UInteger32 k, UInteger8 jt, UInteger8 jf)
+{
+	prog[*n].code = code;
+	prog[*n].jt = jt;
+	prog[*n].jf = jf;
+	prog[*n].k = k;
+	(*n)++;
+}
+
+/* 
+ * the 32 bit word at 'id', as BPF_LD|BPF_W|BPF_ABS loads it (network
+ * byte order, converted)
+ */
+static UInteger32 
+netFilterWord(const Octet * id)
+{
+	return (UInteger32)(UInteger8)id[0] << 24 | (UInteger32)(UInteger8)id[1] << 16 |
+		(UInteger32)(UInteger8)id[2] << 8 | (UInteger8)id[3];
+}
+
+/* 
+ * attach to 'sock' a classic BPF program that lets through only the
+ * message types in 'types' (a bit per messageType) of our PTP version
+ * and domain. 'base' is where the PTP message starts in what the
+ * filter sees: after the UDP header on a UDP socket, at the start on
+ * an Ethernet SOCK_DGRAM packet socket. with 'dropSelf' our own
+ * messages are dropped too, and a DelayResp must be for our port
+ */
+static bool 
+netAttachFilter(Integer32 sock, UInteger16 types, UInteger16 base, 
+		bool dropSelf, RunTimeOpts * rtOpts, PtpClock * ptpClock)
+{
+	struct sock_filter prog[NET_FILTER_LENGTH];
+	struct sock_fprog fprog;
+	int n = 0;
+
+	/* messageType: drop unless its bit is set in 'types' */
+	netFilterAdd(prog, &n, BPF_LD|BPF_B|BPF_ABS, base + 0, 0, 0);
+	netFilterAdd(prog, &n, BPF_ALU|BPF_AND|BPF_K, 0x0F, 0, 0);
+	netFilterAdd(prog, &n, BPF_MISC|BPF_TAX, 0, 0, 0);
+	netFilterAdd(prog, &n, BPF_LD|BPF_IMM, 1, 0, 0);
+	netFilterAdd(prog, &n, BPF_ALU|BPF_LSH|BPF_X, 0, 0, 0);
+	netFilterAdd(prog, &n, BPF_JMP|BPF_JSET|BPF_K, types, 
+		     0, NET_FILTER_DROP);
+	/* versionPTP */
+	netFilterAdd(prog, &n, BPF_LD|BPF_B|BPF_ABS, base + 1, 0, 0);
+	netFilterAdd(prog, &n, BPF_ALU|BPF_AND|BPF_K, 0x0F, 0, 0);
+	netFilterAdd(prog, &n, BPF_JMP|BPF_JEQ|BPF_K, 
+		     ptpClock->versionNumber,
+		     0, NET_FILTER_DROP);
+	/* domainNumber */
+	netFilterAdd(prog, &n, BPF_LD|BPF_B|BPF_ABS, base + 4, 0, 0);
+	netFilterAdd(prog, &n, BPF_JMP|BPF_JEQ|BPF_K, 
+		     rtOpts->domainNumber,
+		     0, NET_FILTER_DROP);
+	if (dropSelf) {
+		/* sourcePortIdentity.clockIdentity */
+		netFilterAdd(prog, &n, BPF_LD|BPF_W|BPF_ABS, base + 20, 0, 0);
+		netFilterAdd(prog, &n, BPF_JMP|BPF_JEQ|BPF_K, 
+			     netFilterWord(ptpClock->clockIdentity),
+			     0, 2);
+		netFilterAdd(prog, &n, BPF_LD|BPF_W|BPF_ABS, base + 24, 0, 0);
+		netFilterAdd(prog, &n, BPF_JMP|BPF_JEQ|BPF_K, 
+			     netFilterWord(ptpClock->clockIdentity + 4),
+			     NET_FILTER_DROP, 0);
+	}
+	if (dropSelf && (types & 1 << DELAY_RESP)) {
+		/* DelayResp.requestingPortIdentity */
+		netFilterAdd(prog, &n, BPF_LD|BPF_B|BPF_ABS, base + 0, 0, 0);
+		netFilterAdd(prog, &n, BPF_ALU|BPF_AND|BPF_K, 0x0F, 0, 0);
+		netFilterAdd(prog, &n, BPF_JMP|BPF_JEQ|BPF_K, DELAY_RESP, 
+			     0, NET_FILTER_ACCEPT);
+		netFilterAdd(prog, &n, BPF_LD|BPF_W|BPF_ABS, base + 44, 0, 0);
+		netFilterAdd(prog, &n, BPF_JMP|BPF_JEQ|BPF_K, 
+			     netFilterWord(ptpClock->clockIdentity),
+			     0, NET_FILTER_DROP);
+		netFilterAdd(prog, &n, BPF_LD|BPF_W|BPF_ABS, base + 48, 0, 0);
+		netFilterAdd(prog, &n, BPF_JMP|BPF_JEQ|BPF_K, 
+			     netFilterWord(ptpClock->clockIdentity + 4),
+			     0, NET_FILTER_DROP);
+		netFilterAdd(prog, &n, BPF_LD|BPF_H|BPF_ABS, base + 52, 0, 0);
+		netFilterAdd(prog, &n, BPF_JMP|BPF_JEQ|BPF_K, 
+			     ptpClock->portIdentity.portNumber,
+			     NET_FILTER_ACCEPT, NET_FILTER_DROP);
+	}
+	/* whole message, or nothing */
+	netFilterAdd(prog, &n, BPF_RET|BPF_K, 0xFFFFFFFF, 0, 0);
+	netFilterAdd(prog, &n, BPF_RET|BPF_K, 0, 0, 0);
+	netFilterPatch(prog, n);
+
+	fprog.len = n;
+	fprog.filter = prog;
+	if (setsockopt(sock, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, 
+		       sizeof(fprog)) < 0) {
+		PERROR("failed to attach socket filter");
 		return FALSE;
 	}
-#endif
 	return TRUE;
 }
 
-/*Check if data have been received*/
-int 
-netSelect(TimeInternal * timeout, NetPath * netPath)
+/** 
+ * Have the kernel drop what the engine would only throw away: other
+ * PTP versions and domains, message types of the other delay
+ * mechanism, our own messages (unless they are how we learn the send
+ * time of event messages), and DelayResps for other slaves. Needs the
+ * clock identity, so it is called after initData(). Nothing to do in
+ * packet mode, where the configuration feeds us.
+ *
+ * @return FALSE if a filter can't be attached; messages are then all
+ * received, as without the filter
+ */
+bool 
+netSetFilter(NetPath * netPath, RunTimeOpts * rtOpts, PtpClock * ptpClock)
 {
-	int ret, nfds;
-	fd_set readfds;
-	struct timeval tv, *tv_ptr;
+	UInteger16 event = 1 << SYNC, general = 1 << FOLLOW_UP | 1 << ANNOUNCE;
+	UInteger16 base = UDP_HEADER_LENGTH;
+
+	if (netPath->element || netPath->eventSock < 0)
+		return TRUE;
 
-	if (timeout < 0)
+	if (rtOpts->E2E_mode) {
+		event |= 1 << DELAY_REQ;
+		general |= 1 << DELAY_RESP;
+	} else {
+		event |= 1 << PDELAY_REQ | 1 << PDELAY_RESP;
+		general |= 1 << PDELAY_RESP_FOLLOW_UP;
+	}
+	/* handleManagement() does nothing with management messages */
+	if (rtOpts->unicastNegotiation)
+		general |= 1 << SIGNALING;
+
+	/* on Ethernet the event socket takes everything */
+	if (netPath->generalSock < 0) {
+		base = 0;
+		event |= general;
+	}
+	if (!netAttachFilter(netPath->eventSock, event, base, 
+			     netPath->txTimestamping, rtOpts, ptpClock))
+		return FALSE;
+	if (netPath->generalSock >= 0 &&
+	    !netAttachFilter(netPath->generalSock, general, base, TRUE, 
+			     rtOpts, ptpClock))
 		return FALSE;
+	DBG("socket filters attached\n");
+	return TRUE;
+}
 
-	FD_ZERO(&readfds);
-	FD_SET(netPath->eventSock, &readfds);
-	FD_SET(netPath->generalSock, &readfds);
+/**
+ * Wait on the epoll instance for at most 'timeout' (NULL blocks).
+ * Only the sockets that are ready are recorded in netPath->ready; an
+ * expired deadline timer is drained and otherwise left to the
+ * protocol timers, which go by the monotonic clock.
+ *
+ * @return number of ready sockets, 0 on timeout, < 0 on error
+ */
+int 
+netSelect(TimeInternal * timeout, NetPath * netPath)
+{
+	int i, n, ret = 0, ms;
+	struct epoll_event events[NET_MAX_EVENTS];
+	uint64_t expirations;
 
-	if (timeout) {
-		tv.tv_sec = timeout->seconds;
-		tv.tv_usec = timeout->nanoseconds / 1000;
-		tv_ptr = &tv;
-	} else
-		tv_ptr = 0;
+	if (timeout && (timeout->seconds < 0 || timeout->nanoseconds < 0))
+		return FALSE;
 
-	if (netPath->eventSock > netPath->generalSock)
-		nfds = netPath->eventSock;
+	if (timeout)
+		/* round up so we never wake before the deadline */
+		ms = timeout->seconds * 1000 + 
+			(timeout->nanoseconds + 999999) / 1000000;
 	else
-		nfds = netPath->generalSock;
-
-	ret = select(nfds + 1, &readfds, 0, 0, tv_ptr) > 0;
+		ms = -1;
 
-	if (ret < 0) {
-		if (errno == EAGAIN || errno == EINTR)
+	netPath->ready = 0;
+	n = epoll_wait(netPath->epollFd, events, NET_MAX_EVENTS, ms);
+	if (n < 0) {
+		if (errno == EINTR)
 			return 0;
+		return n;
+	}
+
+	for (i = 0; i < n; i++) {
+		if (events[i].data.fd == netPath->eventSock) {
+			/* send time stamps wait on the error queue */
+			if (events[i].events & EPOLLERR)
+				netPath->ready |= NET_TXTS_READY;
+			if (events[i].events & EPOLLIN)
+				netPath->ready |= NET_EVENT_READY;
+			ret++;
+		} else if (events[i].data.fd == netPath->generalSock) {
+			netPath->ready |= NET_GENERAL_READY;
+			ret++;
+		} else if (events[i].data.fd == netPath->timerFd) {
+			if (read(netPath->timerFd, &expirations, 
+				 sizeof(expirations)) < 0 && errno != EAGAIN)
+				PERROR("failed to read timer descriptor");
+		}
 	}
 	return ret;
 }
 
+/**
+ * Arm the deadline timer to fire after 'delay', or disarm it when
+ * 'delay' is NULL. Re-arming also clears a pending expiration.
+ */
+bool 
+netArmTimer(TimeInternal * delay, NetPath * netPath)
+{
+	struct itimerspec its;
+
+	memset(&its, 0, sizeof(its));
+	if (delay) {
+		its.it_value.tv_sec = delay->seconds;
+		its.it_value.tv_nsec = delay->nanoseconds;
+		/* an all-zero it_value would disarm, fire right away instead */
+		if (!its.it_value.tv_sec && !its.it_value.tv_nsec)
+			its.it_value.tv_nsec = 1;
+	}
+	if (timerfd_settime(netPath->timerFd, 0, &its, NULL) < 0) {
+		PERROR("failed to arm timer descriptor");
+		return FALSE;
+	}
+	return TRUE;
+}
 
 
 
-/** 
- * store received data from network to "buf" , get and store the
- * SO_PTP_Timestamp value in "time" for an event message
- * 
- * @param buf 
- * @param time 
- * @param netPath 
- * 
- * @return 
+
+/* 
+ * get the kernel receive time stamp of a message, FALSE if there is
+ * none: better to drop the message than to record the time here, well
+ * after the receipt, which would put a spike in the offset signal sent
+ * to the clock servo
  */
-ssize_t 
-netRecvEvent(Octet * buf, TimeInternal * time, NetPath * netPath)
+static bool 
+netRecvTime(struct msghdr * msg, TimeInternal * time)
 {
-	ssize_t ret;
-	struct msghdr msg;
-	struct iovec vec[1];
-	struct sockaddr_in from_addr;
-
-	union {
-		struct cmsghdr cm;
-		char	control[CMSG_SPACE(sizeof(struct timeval))];
-	}     cmsg_un;
-
 	struct cmsghdr *cmsg;
-#if defined(linux)
+	struct timespec *ts;
 	struct timeval *tv;
-#else
-	struct timespec ts;
-#endif
-
-	vec[0].iov_base = buf;
-	vec[0].iov_len = PACKET_SIZE;
-
-	memset(&msg, 0, sizeof(msg));
-	memset(&from_addr, 0, sizeof(from_addr));
-	memset(buf, 0, PACKET_SIZE);
-	memset(&cmsg_un, 0, sizeof(cmsg_un));
 
-	msg.msg_name = (caddr_t)&from_addr;
-	msg.msg_namelen = sizeof(from_addr);
-	msg.msg_iov = vec;
-	msg.msg_iovlen = 1;
-	msg.msg_control = cmsg_un.control;
-	msg.msg_controllen = sizeof(cmsg_un.control);
-	msg.msg_flags = 0;
-
-	ret = recvmsg(netPath->eventSock, &msg, MSG_DONTWAIT);
-	if (ret <= 0) {
-		if (errno == EAGAIN || errno == EINTR)
-			return 0;
-
-		return ret;
-	}
-	if (msg.msg_flags & MSG_TRUNC) {
-		ERROR("received truncated message\n");
-		return 0;
-	}
-	/* get time stamp of packet */
-	if (!time) {
-		ERROR("null receive time stamp argument\n");
-		return 0;
-	}
-	if (msg.msg_flags & MSG_CTRUNC) {
+	if (msg->msg_flags & MSG_CTRUNC) {
 		ERROR("received truncated ancillary data\n");
-		return 0;
+		return FALSE;
 	}
-	if (msg.msg_controllen < sizeof(cmsg_un.control)) {
-		ERROR("received short ancillary data (%ld/%ld)\n",
-		    (long)msg.msg_controllen, (long)sizeof(cmsg_un.control));
 
-		return 0;
-	}
-#if defined(linux)
+	ts = 0;
 	tv = 0;
-	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; 
-	     cmsg = CMSG_NXTHDR(&msg, cmsg)) {
-		if (cmsg->cmsg_level == SOL_SOCKET && 
-		    cmsg->cmsg_type == SCM_TIMESTAMP)
+	for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; 
+	     cmsg = CMSG_NXTHDR(msg, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET)
+			continue;
+		/* SCM_TIMESTAMPING: ts[0] is the software stamp */
+		if (cmsg->cmsg_type == SCM_TIMESTAMPING || 
+		    cmsg->cmsg_type == SCM_TIMESTAMPNS)
+			ts = (struct timespec *)CMSG_DATA(cmsg);
+		else if (cmsg->cmsg_type == SCM_TIMESTAMP)
 			tv = (struct timeval *)CMSG_DATA(cmsg);
 	}
 
-	if (tv) {
+	if (ts && (ts->tv_sec || ts->tv_nsec)) {
+		time->seconds = ts->tv_sec;
+		time->nanoseconds = ts->tv_nsec;
+	} else if (tv) {
 		time->seconds = tv->tv_sec;
 		time->nanoseconds = tv->tv_usec * 1000;
-		DBGV("kernel recv time stamp %us %dns\n", 
-		     time->seconds, time->nanoseconds);
-#else /* FreeBSD has more accurate time stamps */
-	bzero(&ts, sizeof(ts));
-	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; 
-	     cmsg = CMSG_NXTHDR(&msg, cmsg)) {
-		if (cmsg->cmsg_level == SOL_SOCKET && 
-		    cmsg->cmsg_type == SCM_BINTIME)
-			bintime2timespec((struct bintime *)CMSG_DATA(cmsg),
-					 &ts);
-	}
-
-	if (ts.tv_sec != 0) {
-		time->seconds = ts.tv_sec;
-		time->nanoseconds = ts.tv_nsec;
-		DBGV("kernel recv time stamp %us %dns\n", time->seconds, time->nanoseconds);
-#endif /* Linux or FreeBSD */
 	} else {
-		/*
-		 * do not try to get by with recording the time here, better
-		 * to fail because the time recorded could be well after the
-		 * message receive, which would put a big spike in the
-		 * offset signal sent to the clock servo
-		 */
 		DBG("no receive time stamp\n");
-		return 0;
+		return FALSE;
 	}
+	DBGV("kernel recv time stamp %us %dns\n", 
+	     time->seconds, time->nanoseconds);
+	return TRUE;
+}
 
-	return ret;
+/** 
+ * receive up to 'max' messages from 'sock' with one recvmmsg() call
+ * into netPath->rx[], with their receive time stamps and sender
+ * addresses. a message that must be skipped is returned with length 0.
+ * 
+ * @param sock    netPath->eventSock or netPath->generalSock
+ * @param netPath 
+ * @param max     batch budget, at most NET_MAX_BATCH
+ * 
+ * @return number of messages in netPath->rx[], < 0 on error
+ */
+int 
+netRecvBatch(Integer32 sock, NetPath * netPath, int max)
+{
+	int i, n;
+	struct msghdr *msg;
+
+	if (max > NET_MAX_BATCH)
+		max = NET_MAX_BATCH;
+	else if (max < 1)
+		max = 1;
+
+	/* the kernel updates the lengths and flags, so reset them */
+	for (i = 0; i < max; i++) {
+		netPath->rxIov[i].iov_base = netPath->rx[i].buf;
+		netPath->rxIov[i].iov_len = PACKET_SIZE;
+
+		msg = &netPath->rxHdr[i].msg_hdr;
+		msg->msg_name = &netPath->rx[i].from.sa;
+		msg->msg_namelen = offsetof(NetAddress, len);
+		msg->msg_iov = &netPath->rxIov[i];
+		msg->msg_iovlen = 1;
+		msg->msg_control = netPath->rxControl[i];
+		msg->msg_controllen = NET_CONTROL_SIZE;
+		msg->msg_flags = 0;
+	}
+
+	n = recvmmsg(sock, netPath->rxHdr, max, MSG_DONTWAIT, NULL);
+	if (n < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return 0;
+		return n;
+	}
+
+	for (i = 0; i < n; i++) {
+		msg = &netPath->rxHdr[i].msg_hdr;
+		netPath->rx[i].length = netPath->rxHdr[i].msg_len;
+		netPath->rx[i].from.len = msg->msg_namelen;
+
+		if (msg->msg_flags & MSG_TRUNC) {
+			ERROR("received truncated message\n");
+			netPath->rx[i].length = 0;
+		} else if (!netRecvTime(msg, &netPath->rx[i].time))
+			netPath->rx[i].length = 0;
+	}
+	return n;
 }
 
+/* 
+ * offset of the PTP message in a packet from the error queue, which
+ * may come back with its UDP/IP or even Ethernet headers: the message
+ * is where its own messageLength field spans the rest of the packet
+ */
+static int 
+netFindMessage(Octet * buf, ssize_t length)
+{
+	/* 
+	 * none, Ethernet, Ethernet with VLAN tag, then UDP/IPv4 and
+	 * UDP/IPv6 each alone, behind Ethernet, and behind a VLAN tag
+	 */
+	static const int offsets[] = { 0, 14, 18, 28, 42, 46, 48, 62, 66 };
+	UInteger8 *p;
+	unsigned i;
 
+	for (i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+		if (length - offsets[i] < HEADER_LENGTH)
+			break;
+		p = (UInteger8 *)buf + offsets[i];
+		if ((p[1] & 0x0F) == VERSION_PTP && 
+		    ((p[2] << 8) | p[3]) == length - offsets[i])
+			return offsets[i];
+	}
+	return -1;
+}
 
 /** 
+ * take one send time stamp from the error queue of the event socket
  * 
- * store received data from network to "buf" get and store the
- * SO_PTP_Timestamp value in "time" for a general message
- * 
- * @param buf 
- * @param time 
  * @param netPath 
+ * @param time         set to the software send time stamp
+ * @param messageType  set to the type of the message that was sent
+ * @param sequenceId   set to its sequenceId, to match it with what we sent
  * 
- * @return 
+ * @return 1 if a time stamp was read, 0 if the queue is empty, < 0 on error
  */
-
-ssize_t 
-netRecvGeneral(Octet * buf, TimeInternal * time, NetPath * netPath)
+int 
+netRecvTxTimestamp(NetPath * netPath, TimeInternal * time, 
+		   UInteger8 * messageType, UInteger16 * sequenceId)
 {
-	ssize_t ret;
+	Octet buf[PACKET_SIZE + 64];
+	char control[NET_CONTROL_SIZE];
 	struct msghdr msg;
 	struct iovec vec[1];
-	struct sockaddr_in from_addr;
-
-	union {
-		struct cmsghdr cm;
-		char	control[CMSG_SPACE(sizeof(struct timeval))];
-	}     cmsg_un;
-
 	struct cmsghdr *cmsg;
-#if defined(linux)
-	struct timeval *tv;
-#else
-	struct timespec ts;
-#endif 
-	vec[0].iov_base = buf;
-	vec[0].iov_len = PACKET_SIZE;
-
-	memset(&msg, 0, sizeof(msg));
-	memset(&from_addr, 0, sizeof(from_addr));
-	memset(buf, 0, PACKET_SIZE);
-	memset(&cmsg_un, 0, sizeof(cmsg_un));
-
-	msg.msg_name = (caddr_t)&from_addr;
-	msg.msg_namelen = sizeof(from_addr);
-	msg.msg_iov = vec;
-	msg.msg_iovlen = 1;
-	msg.msg_control = cmsg_un.control;
-	msg.msg_controllen = sizeof(cmsg_un.control);
-	msg.msg_flags = 0;
-
-	ret = recvmsg(netPath->generalSock, &msg, MSG_DONTWAIT);
-	if (ret <= 0) {
-		if (errno == EAGAIN || errno == EINTR)
-			return 0;
+	struct timespec *ts;
+	struct sock_extended_err *serr;
+	ssize_t ret;
+	int off;
+
+	for (;;) {
+		vec[0].iov_base = buf;
+		vec[0].iov_len = sizeof(buf);
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = vec;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		ret = recvmsg(netPath->eventSock, &msg, 
+			      MSG_ERRQUEUE | MSG_DONTWAIT);
+		if (ret < 0) {
+			if (errno == EAGAIN || errno == EINTR)
+				return 0;
+			return ret;
+		}
 
-		return ret;
-	}
-	if (msg.msg_flags & MSG_TRUNC) {
-		ERROR("received truncated message\n");
-		return 0;
-	}
-	/* get time stamp of packet */
-	if (!time) {
-		ERROR("null receive time stamp argument\n");
-		return 0;
-	}
-	if (msg.msg_flags & MSG_CTRUNC) {
-		ERROR("received truncated ancillary data\n");
-		return 0;
-	}
-	if (msg.msg_controllen < sizeof(cmsg_un.control)) {
-		ERROR("received short ancillary data (%ld/%ld)\n",
-		    (long)msg.msg_controllen, (long)sizeof(cmsg_un.control));
+		ts = 0;
+		serr = 0;
+		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; 
+		     cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			if (cmsg->cmsg_level == SOL_SOCKET && 
+			    cmsg->cmsg_type == SCM_TIMESTAMPING)
+				ts = (struct timespec *)CMSG_DATA(cmsg);
+			else if ((cmsg->cmsg_level == IPPROTO_IP && 
+				  cmsg->cmsg_type == IP_RECVERR) ||
+				 (cmsg->cmsg_level == IPPROTO_IPV6 && 
+				  cmsg->cmsg_type == IPV6_RECVERR) ||
+				 (cmsg->cmsg_level == SOL_PACKET && 
+				  cmsg->cmsg_type == PACKET_TX_TIMESTAMP))
+				serr = (struct sock_extended_err *)
+					CMSG_DATA(cmsg);
+		}
+		/* skip real errors and stamps we can't use */
+		if (!ts || (serr && serr->ee_origin != SO_EE_ORIGIN_TIMESTAMPING)
+		    || (!ts->tv_sec && !ts->tv_nsec)) {
+			DBG("skipping error queue entry\n");
+			continue;
+		}
+		if ((off = netFindMessage(buf, ret)) < 0) {
+			DBG("no PTP message in error queue entry\n");
+			continue;
+		}
 
-		return 0;
+		*messageType = buf[off] & 0x0F;
+		*sequenceId = ((UInteger8)buf[off + 30] << 8) | 
+			(UInteger8)buf[off + 31];
+		time->seconds = ts->tv_sec;
+		time->nanoseconds = ts->tv_nsec;
+		DBGV("kernel send time stamp %us %dns\n", 
+		     time->seconds, time->nanoseconds);
+		return 1;
 	}
-#if defined(linux)
-	tv = 0;
-	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; 
-	     cmsg = CMSG_NXTHDR(&msg, cmsg)) {
-		if (cmsg->cmsg_level == SOL_SOCKET && 
-		    cmsg->cmsg_type == SCM_TIMESTAMP)
-			tv = (struct timeval *)CMSG_DATA(cmsg);
+}
+
+/* 
+ * send a message to 'to'. in packet mode the message becomes a Click
+ * packet on output 0 (event) or 1 (general) of the element, with the
+ * destination IP or IPv6 address in its annotation, or on Ethernet
+ * with its Ethernet header in front. otherwise it is copied to the transmit
+ * queue, which netFlush() sends at the end of the step, so 'buf' may
+ * be reused right away. 0 if the message was dropped, as the callers
+ * of netSend*() test for
+ */
+static ssize_t 
+netSend(Octet *buf, UInteger16 length, NetPath *netPath, 
+	const NetAddress *to, UInteger16 toport)
+{
+	NetTxMessage *tx;
+
+	if (netPath->element) {
+		WritablePacket *p = Packet::make(Packet::default_headroom, 
+						 buf, length, 0);
+		if (p && to->sa.sa_family == AF_PACKET)
+			p = p->push_mac_header(sizeof(click_ether));
+		if (!p) {
+			DBGV("failed to allocate packet\n");
+			return 0;
+		}
+		if (to->sa.sa_family == AF_PACKET) {
+			click_ether *ethh = (click_ether *) p->data();
+			memcpy(ethh->ether_dhost, to->ll.sll_addr, ETHER_ADDRESS_LENGTH);
+			memcpy(ethh->ether_shost, netPath->hwAddr, ETHER_ADDRESS_LENGTH);
+			ethh->ether_type = htons(PTP_ETHER_TYPE);
+		} else if (to->sa.sa_family == AF_INET6)
+			p->set_dst_ip6_anno(IP6Address(to->in6.sin6_addr.s6_addr));
+		else
+			p->set_dst_ip_anno(IPAddress(to->in.sin_addr));
+		netPath->element->send_packet(toport == PTP_EVENT_PORT ? 0 : 1, p);
+		return length;
 	}
 
-	if (tv) {
-		time->seconds = tv->tv_sec;
-		time->nanoseconds = tv->tv_usec * 1000;
-		DBGV("kernel recv time stamp %us %dns\n", 
-		     time->seconds, time->nanoseconds);
-#else /* FreeBSD has more accurate time stamps */
-	bzero(&ts, sizeof(ts));
-	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; 
-	     cmsg = CMSG_NXTHDR(&msg, cmsg)) {
-		if (cmsg->cmsg_level == SOL_SOCKET && 
-		    cmsg->cmsg_type == SCM_BINTIME)
-			bintime2timespec((struct bintime *)CMSG_DATA(cmsg),
-					 &ts);
-	}
-
-	if (ts.tv_sec != 0) {
-		time->seconds = ts.tv_sec;
-		time->nanoseconds = ts.tv_nsec;
-		DBGV("kernel recv time stamp %us %dns\n", time->seconds, time->nanoseconds);
-#endif /* Linux or FreeBSD */
-	} else {
-		/*
-		 * do not try to get by with recording the time here, better
-		 * to fail because the time recorded could be well after the
-		 * message receive, which would put a big spike in the
-		 * offset signal sent to the clock servo
-		 */
-		DBG("no receive time stamp\n");
+	if (length > PACKET_SIZE)
+		return 0;
+	if (netPath->txCount == NET_MAX_BATCH && !netFlush(netPath))
 		return 0;
-	}
 
-	return ret;
+	tx = &netPath->tx[netPath->txCount++];
+	memcpy(tx->buf, buf, length);
+	tx->length = length;
+	/* on Ethernet the event socket is the only one */
+	tx->sock = toport == PTP_EVENT_PORT || netPath->generalSock < 0 ? 
+		netPath->eventSock : netPath->generalSock;
+	tx->addr = *to;
+	if (to->sa.sa_family == AF_INET)
+		tx->addr.in.sin_port = htons(toport);
+	else if (to->sa.sa_family == AF_INET6)
+		tx->addr.in6.sin6_port = htons(toport);
+	return length;
 }
 
-ssize_t netSend(Octet *buf, UInteger16 length, Integer32 sock, Integer32 toaddr, UInteger16 toport)
+/** 
+ * send the transmit queue, one sendmmsg() per run of messages for the
+ * same socket so their order is kept
+ * 
+ * @return FALSE if a message could not be sent
+ */
+bool 
+netFlush(NetPath * netPath)
 {
-        ssize_t ret;
-        struct sockaddr_in addr;
-
-        addr.sin_family = AF_INET;
-        addr.sin_port = htons(toport);
-        addr.sin_addr.s_addr = toaddr;
+	int i, first, count, ret;
+	bool ok = TRUE;
+
+	for (i = 0; i < netPath->txCount; i++) {
+		netPath->txIov[i].iov_base = netPath->tx[i].buf;
+		netPath->txIov[i].iov_len = netPath->tx[i].length;
+		memset(&netPath->txHdr[i], 0, sizeof(netPath->txHdr[i]));
+		netPath->txHdr[i].msg_hdr.msg_name = &netPath->tx[i].addr;
+		netPath->txHdr[i].msg_hdr.msg_namelen = netPath->tx[i].addr.len;
+		netPath->txHdr[i].msg_hdr.msg_iov = &netPath->txIov[i];
+		netPath->txHdr[i].msg_hdr.msg_iovlen = 1;
+	}
 
-        ret = sendto(sock, buf, length, 0, (struct sockaddr *)&addr, sizeof(struct sockaddr_in));
-        if(ret <= 0)
-                DBGV("error sending message\n");
-        return ret;
+	for (first = 0; first < netPath->txCount; first += count) {
+		for (count = 1; first + count < netPath->txCount && 
+			     netPath->tx[first + count].sock == 
+			     netPath->tx[first].sock; count++)
+			;
+
+		for (i = 0; i < count; i += ret) {
+			ret = sendmmsg(netPath->tx[first].sock, 
+				       &netPath->txHdr[first + i], count - i, 0);
+			if (ret <= 0) {
+				if (errno != EINTR) {
+					PERROR("failed to send %d message(s)", 
+					       count - i);
+					ok = FALSE;
+					break;
+				}
+				ret = 0;
+			}
+		}
+	}
+	netPath->txCount = 0;
+	return ok;
 }
 
 ssize_t 
@@ -718,18 +1442,28 @@ netSendEvent(Octet * buf, UInteger16 length, NetPath * netPath)
 {
 	ssize_t ret;
 
-	ret = netSend(buf, length, netPath->eventSock, netPath->multicastAddr, PTP_EVENT_PORT);
+	ret = netSend(buf, length, netPath, &netPath->multicastAddr, PTP_EVENT_PORT);
 	if (ret <= 0)
 		DBG("error sending multi-cast event message\n");
 
-	if (netPath->unicastAddr) {
-		ret = netSend(buf, length, netPath->eventSock, netPath->unicastAddr, PTP_EVENT_PORT);
+	if (netPath->unicastAddr.len) {
+		ret = netSend(buf, length, netPath, &netPath->unicastAddr, PTP_EVENT_PORT);
 		if (ret <= 0)
 			DBG("error sending uni-cast event message\n");
                 // Must loop back the packet since are not using multicast. 
-		ret = netSend(buf, length, netPath->eventSock, htonl(0x7f000001), PTP_EVENT_PORT);
-		if (ret <= 0)
-			DBG("error looping back uni-cast event message\n");
+		// (the element loops event messages back itself, and with
+		// send time stamps there is nothing to loop back for)
+		if (!netPath->element && !netPath->txTimestamping) {
+			NetAddress loopback;
+
+			if (netPath->transport == UDP_IPV6)
+				netInet6Address(&loopback, &in6addr_loopback, 0);
+			else
+				netInetAddress(&loopback, htonl(INADDR_LOOPBACK));
+			ret = netSend(buf, length, netPath, &loopback, PTP_EVENT_PORT);
+			if (ret <= 0)
+				DBG("error looping back uni-cast event message\n");
+		}
 	}
 	return ret;
 }
@@ -739,12 +1473,12 @@ netSendGeneral(Octet * buf, UInteger16 length, NetPath * netPath)
 {
 	ssize_t ret;
 
-	ret = netSend(buf, length, netPath->generalSock, netPath->multicastAddr, PTP_GENERAL_PORT);
+	ret = netSend(buf, length, netPath, &netPath->multicastAddr, PTP_GENERAL_PORT);
 	if (ret <= 0)
 		DBG("error sending multi-cast general message\n");
 
-	if (netPath->unicastAddr) {
-		ret = netSend(buf, length, netPath->generalSock, netPath->unicastAddr, PTP_GENERAL_PORT);
+	if (netPath->unicastAddr.len) {
+		ret = netSend(buf, length, netPath, &netPath->unicastAddr, PTP_GENERAL_PORT);
 		if (ret <= 0)
 			DBG("error sending uni-cast general message\n");
 	}
@@ -756,12 +1490,12 @@ netSendPeerGeneral(Octet * buf, UInteger16 length, NetPath * netPath)
 {
 	ssize_t ret;
 
-	ret = netSend(buf, length, netPath->generalSock, netPath->peerMulticastAddr, PTP_GENERAL_PORT);
+	ret = netSend(buf, length, netPath, &netPath->peerMulticastAddr, PTP_GENERAL_PORT);
 	if (ret <= 0)
 		DBG("error sending multi-cast peer general message\n");
 
-	if (netPath->unicastAddr) {
-		ret = netSend(buf, length, netPath->generalSock, netPath->unicastAddr, PTP_GENERAL_PORT);
+	if (netPath->unicastAddr.len) {
+		ret = netSend(buf, length, netPath, &netPath->unicastAddr, PTP_GENERAL_PORT);
 		if (ret <= 0)
 			DBG("error sending uni-cast peer general message\n");
 	}
@@ -773,14 +1507,54 @@ netSendPeerEvent(Octet * buf, UInteger16 length, NetPath * netPath)
 {
 	ssize_t ret;
 
-	ret = netSend(buf, length, netPath->eventSock, netPath->peerMulticastAddr, PTP_EVENT_PORT);
+	ret = netSend(buf, length, netPath, &netPath->peerMulticastAddr, PTP_EVENT_PORT);
 	if (ret <= 0)
 		DBG("error sending multi-cast peer event message\n");
 
-	if (netPath->unicastAddr) {
-		ret = netSend(buf, length, netPath->eventSock, netPath->unicastAddr, PTP_EVENT_PORT);
+	if (netPath->unicastAddr.len) {
+		ret = netSend(buf, length, netPath, &netPath->unicastAddr, PTP_EVENT_PORT);
 		if (ret <= 0)
 			DBG("error sending uni-cast peer event message\n");
 	}
 	return ret;
 }
+
+/* 
+ * send an event message to 'to' only, e.g. a DelayReq to the parent in
+ * hybrid mode. like netSendEvent(), loop it back to ourselves when that
+ * is the only way to learn its send time
+ */
+ssize_t 
+netSendEventTo(Octet * buf, UInteger16 length, NetPath * netPath, 
+	       const NetAddress * to)
+{
+	ssize_t ret;
+	NetAddress loopback;
+
+	ret = netSend(buf, length, netPath, to, PTP_EVENT_PORT);
+	if (ret <= 0)
+		DBG("error sending uni-cast event message\n");
+
+	if (!netPath->element && !netPath->txTimestamping) {
+		if (netPath->transport == UDP_IPV6)
+			netInet6Address(&loopback, &in6addr_loopback, 0);
+		else
+			netInetAddress(&loopback, htonl(INADDR_LOOPBACK));
+		if (netSend(buf, length, netPath, &loopback, PTP_EVENT_PORT) <= 0)
+			DBG("error looping back uni-cast event message\n");
+	}
+	return ret;
+}
+
+/* send a general message to 'to' only, e.g. a DelayResp in hybrid mode */
+ssize_t 
+netSendGeneralTo(Octet * buf, UInteger16 length, NetPath * netPath, 
+		 const NetAddress * to)
+{
+	ssize_t ret;
+
+	ret = netSend(buf, length, netPath, to, PTP_GENERAL_PORT);
+	if (ret <= 0)
+		DBG("error sending uni-cast general message\n");
+	return ret;
+}
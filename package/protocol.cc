@@ -14,16 +14,19 @@ void doState(RunTimeOpts*,PtpClock*);
 void toState(UInteger8,RunTimeOpts*,PtpClock*);
 
 void handle(RunTimeOpts*,PtpClock*);
-void handleAnnounce(MsgHeader*,Octet*,ssize_t,bool,RunTimeOpts*,PtpClock*);
-void handleSync(MsgHeader*,Octet*,ssize_t,TimeInternal*,bool,RunTimeOpts*,PtpClock*);
-void handleFollowUp(MsgHeader*,Octet*,ssize_t,bool,RunTimeOpts*,PtpClock*);
-void handlePDelayReq(MsgHeader*,Octet*,ssize_t,TimeInternal*,bool,RunTimeOpts*,PtpClock*);
-void handleDelayReq(MsgHeader*,Octet*,ssize_t,TimeInternal*,bool,RunTimeOpts*,PtpClock*);
-void handlePDelayResp(MsgHeader*,Octet*,TimeInternal* ,ssize_t,bool,RunTimeOpts*,PtpClock*);
-void handleDelayResp(MsgHeader*,Octet*,ssize_t,bool,RunTimeOpts*,PtpClock*);
-void handlePDelayRespFollowUp(MsgHeader*,Octet*,ssize_t,bool,RunTimeOpts*,PtpClock*);
-void handleManagement(MsgHeader*,Octet*,ssize_t,bool,RunTimeOpts*,PtpClock*);
-void handleSignaling(MsgHeader*,Octet*,ssize_t,bool,RunTimeOpts*,PtpClock*);
+bool handleBatch(Integer32,RunTimeOpts*,PtpClock*);
+void handleTxTimestamp(UInteger8,UInteger16,TimeInternal*,RunTimeOpts*,PtpClock*);
+void handleMessage(Octet*,ssize_t,TimeInternal*,const NetAddress*,RunTimeOpts*,PtpClock*);
+void handleAnnounce(Octet*,ssize_t,bool,RunTimeOpts*,PtpClock*);
+void handleSync(Octet*,ssize_t,TimeInternal*,bool,RunTimeOpts*,PtpClock*);
+void handleFollowUp(Octet*,ssize_t,bool,RunTimeOpts*,PtpClock*);
+void handlePDelayReq(Octet*,ssize_t,TimeInternal*,bool,RunTimeOpts*,PtpClock*);
+void handleDelayReq(Octet*,ssize_t,TimeInternal*,bool,RunTimeOpts*,PtpClock*);
+void handlePDelayResp(Octet*,TimeInternal* ,ssize_t,bool,RunTimeOpts*,PtpClock*);
+void handleDelayResp(Octet*,ssize_t,bool,RunTimeOpts*,PtpClock*);
+void handlePDelayRespFollowUp(Octet*,ssize_t,bool,RunTimeOpts*,PtpClock*);
+void handleManagement(Octet*,ssize_t,bool,RunTimeOpts*,PtpClock*);
+void handleSignaling(Octet*,ssize_t,bool,RunTimeOpts*,PtpClock*);
 
 
 void issueAnnounce(RunTimeOpts*,PtpClock*);
@@ -37,15 +40,14 @@ void issuePDelayRespFollowUp(TimeInternal*,MsgHeader*,RunTimeOpts*,PtpClock*);
 void issueManagement(MsgHeader*,MsgManagement*,RunTimeOpts*,PtpClock*);
 
 
-void addForeign(Octet*,MsgHeader*,PtpClock*);
+void addForeign(Octet*,PtpClock*);
 
 
-/* loop forever. doState() has a switch for the actions and events to be
-   checked for 'port_state'. the actions and events may or may not change
-   'port_state' by calling toState(), but once they are done we loop around
-   again and perform the actions required for the new 'port_state'. */
-void 
-protocol(RunTimeOpts *rtOpts, PtpClock *ptpClock)
+/* power up the engine. the first doInit() is run here so that a
+   network or allocation failure is reported to the caller instead of
+   being retried from protocolStep(). */
+bool 
+protocolInit(RunTimeOpts *rtOpts, PtpClock *ptpClock)
 {
 	DBG("event POWERUP\n");
 	
@@ -53,18 +55,35 @@ protocol(RunTimeOpts *rtOpts, PtpClock *ptpClock)
 	
 	DBGV("Debug Initializing...");
 
-	for(;;)
-	{
-		if(ptpClock->portState != PTP_INITIALIZING)
-			doState(rtOpts, ptpClock);
-		else if(!doInit(rtOpts, ptpClock))
-			return;
-		
-		if(ptpClock->message_activity)
-			DBGV("activity\n");
-		/* else */
-		  /*			DBGV("no activity\n");*/
+	return doInit(rtOpts, ptpClock);
+}
+
+
+/* run one pass of the engine. doState() has a switch for the actions
+   and events to be checked for 'port_state'. the actions and events may
+   or may not change 'port_state' by calling toState(), but once they are
+   done we return to the caller, which calls us again to perform the
+   actions required for the new 'port_state'. never blocks; returns TRUE
+   if there was activity and the caller should run us again right away. */
+bool 
+protocolStep(RunTimeOpts *rtOpts, PtpClock *ptpClock)
+{
+	if(ptpClock->portState != PTP_INITIALIZING) {
+		timerUpdate(ptpClock->itimer);
+		doState(rtOpts, ptpClock);
+		/* everything this pass issued goes out in one go */
+		if(!netFlush(&ptpClock->netPath))
+			toState(PTP_FAULTY, rtOpts, ptpClock);
 	}
+	else if(!doInit(rtOpts, ptpClock))
+		return FALSE;
+	
+	if(ptpClock->message_activity)
+		DBGV("activity\n");
+	/* else */
+	  /*			DBGV("no activity\n");*/
+
+	return ptpClock->message_activity;
 }
 
 
@@ -82,6 +101,9 @@ toState(UInteger8 state, RunTimeOpts *rtOpts, PtpClock *ptpClock)
 		timerStop(SYNC_INTERVAL_TIMER, ptpClock->itimer);  
 		timerStop(ANNOUNCE_INTERVAL_TIMER, ptpClock->itimer);
 		timerStop(PDELAYREQ_INTERVAL_TIMER, ptpClock->itimer); 
+		/* unicast slaves have to ask the next master */
+		if (rtOpts->unicastNegotiation)
+			unicastReset(rtOpts, ptpClock);
 		break;
 		
 	case PTP_SLAVE:
@@ -92,6 +114,8 @@ toState(UInteger8 state, RunTimeOpts *rtOpts, PtpClock *ptpClock)
 		else
 			timerStop(PDELAYREQ_INTERVAL_TIMER, ptpClock->itimer);
 		
+		/* learned again from the next parent's Sync or Announce */
+		ptpClock->parentAddr.len = 0;
 		initClock(rtOpts, ptpClock); 
 		break;
 		
@@ -144,13 +168,17 @@ toState(UInteger8 state, RunTimeOpts *rtOpts, PtpClock *ptpClock)
 	case PTP_MASTER:
 		DBG("state PTP_MASTER\n");
 		
-		timerStart(SYNC_INTERVAL_TIMER, 
-			   pow(2,ptpClock->logSyncInterval), ptpClock->itimer);
-		DBG("SYNC INTERVAL TIMER : %f \n",
-		    pow(2,ptpClock->logSyncInterval));
-		timerStart(ANNOUNCE_INTERVAL_TIMER, 
-			   pow(2,ptpClock->logAnnounceInterval), 
-			   ptpClock->itimer);
+		/* a negotiating master only sends what it granted, see unicastRun() */
+		if (!rtOpts->unicastNegotiation) {
+			timerStart(SYNC_INTERVAL_TIMER, 
+				   pow(2,ptpClock->logSyncInterval), 
+				   ptpClock->itimer);
+			DBG("SYNC INTERVAL TIMER : %f \n",
+			    pow(2,ptpClock->logSyncInterval));
+			timerStart(ANNOUNCE_INTERVAL_TIMER, 
+				   pow(2,ptpClock->logAnnounceInterval), 
+				   ptpClock->itimer);
+		}
 		timerStart(PDELAYREQ_INTERVAL_TIMER, 
 			   pow(2,ptpClock->logMinPdelayReqInterval), 
 			   ptpClock->itimer);
@@ -178,16 +206,13 @@ toState(UInteger8 state, RunTimeOpts *rtOpts, PtpClock *ptpClock)
 	case PTP_SLAVE:
 		DBG("state PTP_SLAVE\n");
 		initClock(rtOpts, ptpClock);
+		stateWarmStart(rtOpts, ptpClock);
 		
 		ptpClock->waitingForFollow = FALSE;
-		ptpClock->pdelay_req_send_time.seconds = 0;
-		ptpClock->pdelay_req_send_time.nanoseconds = 0;
-		ptpClock->pdelay_req_receive_time.seconds = 0;
-		ptpClock->pdelay_req_receive_time.nanoseconds = 0;
-		ptpClock->pdelay_resp_send_time.seconds = 0;
-		ptpClock->pdelay_resp_send_time.nanoseconds = 0;
-		ptpClock->pdelay_resp_receive_time.seconds = 0;
-		ptpClock->pdelay_resp_receive_time.nanoseconds = 0;
+		ptpClock->pdelay_req_send_time = 0;
+		ptpClock->pdelay_req_receive_time = 0;
+		ptpClock->pdelay_resp_send_time = 0;
+		ptpClock->pdelay_resp_receive_time = 0;
 		
 		
 		timerStart(ANNOUNCE_RECEIPT_TIMER,
@@ -311,12 +336,28 @@ doInit(RunTimeOpts *rtOpts, PtpClock *ptpClock)
 	
 	/* initialize other stuff */
 	initData(rtOpts, ptpClock);
-	initTimer();
 	initClock(rtOpts, ptpClock);
+	/* an optimization only, everything is still checked in handle() */
+	if(!netSetFilter(&ptpClock->netPath, rtOpts, ptpClock))
+		WARNING("filtering PTP messages in user space only\n");
+	/* m1() also pre-encodes the messages, Signaling is packed in msgObuf */
 	m1(ptpClock);
 	msgPackHeader(ptpClock->msgObuf, ptpClock);
 	
 	toState(PTP_LISTENING, rtOpts, ptpClock);
+
+	if (rtOpts->stateFile[0])
+		timerStart(STATE_SAVE_TIMER, STATE_SAVE_INTERVAL, 
+			   ptpClock->itimer);
+
+	/* a unicast slave asks its master for the messages it wants */
+	if (rtOpts->unicastNegotiation) {
+		unicastReset(rtOpts, ptpClock);
+		if (!unicastRequest(rtOpts, ptpClock)) {
+			toState(PTP_FAULTY, rtOpts, ptpClock);
+			return FALSE;
+		}
+	}
 	
 	return TRUE;
 }
@@ -350,6 +391,19 @@ doState(RunTimeOpts *rtOpts, PtpClock *ptpClock)
 	default:
 		break;
 	}
+
+	if(rtOpts->unicastNegotiation && ptpClock->portState != PTP_FAULTY &&
+	   timerExpired(UNICAST_REQUEST_TIMER, ptpClock->itimer)) {
+		DBGV("event UNICAST_REQUEST_TIMEOUT_EXPIRES\n");
+		if(!unicastRequest(rtOpts, ptpClock))
+			toState(PTP_FAULTY, rtOpts, ptpClock);
+	}
+	
+	if(rtOpts->stateFile[0] &&
+	   timerExpired(STATE_SAVE_TIMER, ptpClock->itimer)) {
+		DBGV("event STATE_SAVE_TIMEOUT_EXPIRES\n");
+		stateSave(rtOpts, ptpClock);
+	}
 	
 	switch(ptpClock->portState)
 	{
@@ -396,6 +450,12 @@ doState(RunTimeOpts *rtOpts, PtpClock *ptpClock)
 		break;
 
 	case PTP_MASTER:
+		if(rtOpts->unicastNegotiation &&
+		   !unicastRun(rtOpts, ptpClock)) {
+			toState(PTP_FAULTY, rtOpts, ptpClock);
+			break;
+		}
+
 		if(timerExpired(SYNC_INTERVAL_TIMER, ptpClock->itimer)) {
 			DBG("event SYNC_INTERVAL_TIMEOUT_EXPIRES\n");
 			issueSync(rtOpts, ptpClock);
@@ -443,12 +503,15 @@ handle(RunTimeOpts *rtOpts, PtpClock *ptpClock)
 {
 
 	int ret;
-	ssize_t length;
-	bool isFromSelf;
-	TimeInternal time = { 0, 0 };
+	TimeInternal poll = { 0, 0 };
+
+	/* in packet mode messages are pushed in through protocolRecv() */
+	if(ptpClock->netPath.element)
+		return;
   
 	if(!ptpClock->message_activity)	{
-		ret = netSelect(0, &ptpClock->netPath);
+		/* only poll, the caller waits on netPath.epollFd */
+		ret = netSelect(&poll, &ptpClock->netPath);
 		if(ret < 0) {
 			PERROR("failed to poll sockets");
 			toState(PTP_FAULTY, rtOpts, ptpClock);
@@ -458,26 +521,184 @@ handle(RunTimeOpts *rtOpts, PtpClock *ptpClock)
 			return;
 		}
 		/* else length > 0 */
+	} else {
+		/* 
+		 * still draining after a message, try all sources; on
+		 * Ethernet everything comes in on the event socket
+		 */
+		ptpClock->netPath.ready = NET_EVENT_READY | NET_TXTS_READY;
+		if(ptpClock->netPath.generalSock >= 0)
+			ptpClock->netPath.ready |= NET_GENERAL_READY;
 	}
   
 	DBGV("handle: something\n");
+
+	/* send times first, a FollowUp may be waiting for one */
+	if(ptpClock->netPath.ready & NET_TXTS_READY) {
+		UInteger8 messageType;
+		UInteger16 sequenceId;
+		TimeInternal time;
+
+		while((ret = netRecvTxTimestamp(&ptpClock->netPath, &time,
+						&messageType, &sequenceId)) > 0)
+			handleTxTimestamp(messageType, sequenceId, &time,
+					  rtOpts, ptpClock);
+		if(ret < 0) {
+			PERROR("failed to read send time stamps");
+			toState(PTP_FAULTY, rtOpts, ptpClock);
+			return;
+		}
+	}
   
-	length = netRecvEvent(ptpClock->msgIbuf, &time, &ptpClock->netPath);
-	time.seconds += ptpClock->currentUtcOffset;
-	if(length < 0) {
+	/* event messages first, they carry the time critical stamps */
+	if((ptpClock->netPath.ready & NET_EVENT_READY) &&
+	   !handleBatch(ptpClock->netPath.eventSock, rtOpts, ptpClock)) {
 		PERROR("failed to receive on the event socket");
 		toState(PTP_FAULTY, rtOpts, ptpClock);
 		return;
-	} else if(!length) {
-		length = netRecvGeneral(ptpClock->msgIbuf, &time,
-					&ptpClock->netPath);
-		if(length < 0) {
-			PERROR("failed to receive on the general socket");
-			toState(PTP_FAULTY, rtOpts, ptpClock);
-			return;
-		} else if(!length)
+	}
+	if((ptpClock->netPath.ready & NET_GENERAL_READY) &&
+	   !handleBatch(ptpClock->netPath.generalSock, rtOpts, ptpClock)) {
+		PERROR("failed to receive on the general socket");
+		toState(PTP_FAULTY, rtOpts, ptpClock);
+	}
+}
+
+/* 
+ * receive up to rtOpts->rxBatch messages from 'sock' in one call and
+ * dispatch them in order; FALSE if the receive failed
+ */
+bool 
+handleBatch(Integer32 sock, RunTimeOpts *rtOpts, PtpClock *ptpClock)
+{
+	int i, n;
+	NetRxMessage *rx;
+
+	n = netRecvBatch(sock, &ptpClock->netPath, rtOpts->rxBatch);
+	if(n < 0)
+		return FALSE;
+
+	for(i = 0; i < n; i++) {
+		/* a message may have sent us to FAULTY, drop the rest */
+		if(ptpClock->portState == PTP_FAULTY)
+			break;
+		rx = &ptpClock->netPath.rx[i];
+		if(rx->length)
+			handleMessage(rx->buf, rx->length, &rx->time, &rx->from,
+				      rtOpts, ptpClock);
+	}
+	return TRUE;
+}
+
+/* 
+ * the event message 'messageType'/'sequenceId' we sent left at 'time',
+ * either from the send time stamp on the error queue or from the
+ * looped back copy. only the latest message of each type is wanted,
+ * so a stamp that does not match it is stale and dropped
+ */
+void 
+handleTxTimestamp(UInteger8 messageType, UInteger16 sequenceId, 
+		  TimeInternal *time, RunTimeOpts *rtOpts, PtpClock *ptpClock)
+{
+	/* the sent*SequenceId counters are bumped once the message is sent */
+	switch(messageType)
+	{
+	case SYNC:
+		if(ptpClock->portState != PTP_MASTER)
+			break;
+		/* unicast Syncs go to many slaves, each needs its FollowUp */
+		if(rtOpts->unicastNegotiation) {
+			if(!unicastTxSync(sequenceId, time, rtOpts, ptpClock))
+				toState(PTP_FAULTY, rtOpts, ptpClock);
 			return;
+		}
+		if(sequenceId != (UInteger16)(ptpClock->sentSyncSequenceId - 1))
+			break;
+		/*Add latency*/
+		addTime(time,time,&rtOpts->outboundLatency);
+		issueFollowup(time,rtOpts,ptpClock);
+		return;
+
+	case DELAY_REQ:
+		if(ptpClock->portState != PTP_SLAVE ||
+		   sequenceId != (UInteger16)(ptpClock->sentDelayReqSequenceId - 1))
+			break;
+		/*Add latency*/
+		ptpClock->delay_req_send_time = internalTimeToNs(time) + 
+			internalTimeToNs(&rtOpts->outboundLatency);
+		return;
+
+	case PDELAY_REQ:
+		if(sequenceId != (UInteger16)(ptpClock->sentPDelayReqSequenceId - 1))
+			break;
+		/*Add latency*/
+		ptpClock->pdelay_req_send_time = internalTimeToNs(time) + 
+			internalTimeToNs(&rtOpts->outboundLatency);
+		return;
+
+	case PDELAY_RESP:
+		if(sequenceId != ptpClock->PdelayReqHeader.sequenceId)
+			break;
+		/*Add latency*/
+		addTime(time,time,&rtOpts->outboundLatency);
+		issuePDelayRespFollowUp(time, &ptpClock->PdelayReqHeader,
+					rtOpts, ptpClock);
+		return;
+
+	default:
+		return;
 	}
+	DBG("handleTxTimestamp: stale time stamp for message type %d, "
+	    "sequenceId %d\n", messageType, sequenceId);
+}
+
+/* 
+ * time left until the engine has something to do without a message
+ * coming in: the earliest protocol timer or, for a negotiating master,
+ * the next unicast send. FALSE if there is nothing to wait for
+ */
+bool 
+protocolNext(RunTimeOpts *rtOpts, PtpClock *ptpClock, TimeInternal *delay)
+{
+	TimeInternal next;
+	bool running = timerNext(ptpClock->itimer, delay);
+
+	if(ptpClock->portState != PTP_MASTER || !rtOpts->unicastNegotiation ||
+	   !unicastNext(ptpClock, &next))
+		return running;
+	if(!running || timeBefore(&next, delay))
+		*delay = next;
+	return TRUE;
+}
+
+/* 
+ * handle a message received on an input port of the element, 'from'
+ * is NULL if the packet did not say who sent it
+ */
+void 
+protocolRecv(Octet *buf, ssize_t length, TimeInternal *time,
+	     const NetAddress *from, RunTimeOpts *rtOpts, PtpClock *ptpClock)
+{
+	handleMessage(buf, length, time, from, rtOpts, ptpClock);
+}
+
+/* 
+ * dispatch one received message, 'time' is its receive time stamp and
+ * 'from' (may be NULL) the address it came from
+ */
+void 
+handleMessage(Octet *msgIbuf, ssize_t length, TimeInternal *time,
+	      const NetAddress *from, RunTimeOpts *rtOpts, PtpClock *ptpClock)
+{
+	Enumeration4 messageType;
+	bool isFromSelf;
+
+	if(from)
+		ptpClock->msgTmpSource = *from;
+	else
+		ptpClock->msgTmpSource.len = 0;
+
+	time->seconds += ptpClock->currentUtcOffset;
   
 	ptpClock->message_activity = TRUE;
 
@@ -487,83 +708,84 @@ handle(RunTimeOpts *rtOpts, PtpClock *ptpClock)
 		return;
 	}
   
-	msgUnpackHeader(ptpClock->msgIbuf, &ptpClock->msgTmpHeader);
+	/* 
+	 * only the fields needed to dispatch are read here, the handlers
+	 * read what they need straight from the message
+	 */
+	messageType = msgViewMessageType(msgIbuf);
 
-	if(ptpClock->msgTmpHeader.versionPTP != ptpClock->versionNumber) {
+	if(msgViewVersionPTP(msgIbuf) != ptpClock->versionNumber) {
 		DBGV("ignore version %d message\n", 
-		     ptpClock->msgTmpHeader.versionPTP);
+		     msgViewVersionPTP(msgIbuf));
 		return;
 	}
 
-	if(ptpClock->msgTmpHeader.domainNumber != ptpClock->domainNumber) {
+	if(msgViewDomainNumber(msgIbuf) != ptpClock->domainNumber) {
 		DBGV("ignore message from domainNumber %d\n", 
-		     ptpClock->msgTmpHeader.domainNumber);
+		     msgViewDomainNumber(msgIbuf));
 		return;
 	}
 
+	ptpClock->msgRecv = msgIbuf;
+
 	/*Spec 9.5.2.2*/	
-	isFromSelf = (ptpClock->portIdentity.portNumber == ptpClock->msgTmpHeader.sourcePortIdentity.portNumber
-		      && !memcmp(ptpClock->msgTmpHeader.sourcePortIdentity.clockIdentity, ptpClock->portIdentity.clockIdentity, CLOCK_IDENTITY_LENGTH));
+	isFromSelf = msgViewIsPortIdentity(msgIbuf + 20, &ptpClock->portIdentity);
 
 	/* 
 	 * subtract the inbound latency adjustment if it is not a loop
 	 *  back and the time stamp seems reasonable 
 	 */
-	if(!isFromSelf && time.seconds > 0)
-		subTime(&time, &time, &rtOpts->inboundLatency);
+	if(!isFromSelf && time->seconds > 0)
+		subTime(time, time, &rtOpts->inboundLatency);
 
-	switch(ptpClock->msgTmpHeader.messageType)
+	if(!isFromSelf)
+		ptpClock->rxMessages[messageType]++;
+
+	switch(messageType)
 	{
 	case ANNOUNCE:
 		DBGV("received ANNOUNCE message, entering handleAnnounce()\n");
-		handleAnnounce(&ptpClock->msgTmpHeader, ptpClock->msgIbuf, 
-			       length, isFromSelf, rtOpts, ptpClock);
+		handleAnnounce(msgIbuf, length, isFromSelf, rtOpts, ptpClock);
 		break;
 	case SYNC:
 		DBGV("received SYNC message, entering handleSync()\n");
-		handleSync(&ptpClock->msgTmpHeader, ptpClock->msgIbuf, 
-			   length, &time, isFromSelf, rtOpts, ptpClock);
+		handleSync(msgIbuf, length, time, isFromSelf, rtOpts, ptpClock);
 		break;
 	case FOLLOW_UP:
 		DBGV("received FOLLOW_UP message, entering handleFollowUp()\n");
-		handleFollowUp(&ptpClock->msgTmpHeader, ptpClock->msgIbuf, 
-			       length, isFromSelf, rtOpts, ptpClock);
+		handleFollowUp(msgIbuf, length, isFromSelf, rtOpts, ptpClock);
 		break;
 	case DELAY_REQ:
 		DBGV("received DELAY_REQ message, entering handleDelayReq()\n");
-		handleDelayReq(&ptpClock->msgTmpHeader, ptpClock->msgIbuf, 
-			       length, &time, isFromSelf, rtOpts, ptpClock);
+		handleDelayReq(msgIbuf, length, time, isFromSelf, 
+			       rtOpts, ptpClock);
 		break;
 	case PDELAY_REQ:
 		DBGV("received PDELAY_REQ message, entering handlePDelayReq()\n");
-		handlePDelayReq(&ptpClock->msgTmpHeader, ptpClock->msgIbuf, 
-				length, &time, isFromSelf, rtOpts, ptpClock);
+		handlePDelayReq(msgIbuf, length, time, isFromSelf, 
+				rtOpts, ptpClock);
 		break;  
 	case DELAY_RESP:
 		DBGV("received DELAY_RESP message, entering handleDelayResp()\n");
-		handleDelayResp(&ptpClock->msgTmpHeader, ptpClock->msgIbuf, 
-				length, isFromSelf, rtOpts, ptpClock);
+		handleDelayResp(msgIbuf, length, isFromSelf, rtOpts, ptpClock);
 		break;
 	case PDELAY_RESP:
 		DBGV("received PDELAY_RESP message, entering handlePDelayResp()\n");
-		handlePDelayResp(&ptpClock->msgTmpHeader, ptpClock->msgIbuf,
-				 &time, length, isFromSelf, rtOpts, ptpClock);
+		handlePDelayResp(msgIbuf, time, length, isFromSelf, 
+				 rtOpts, ptpClock);
 		break;
 	case PDELAY_RESP_FOLLOW_UP:
 		DBGV("received PDELAY_RESP_FOLLOW_UP message, entering handlePDelayRespFollowUp()\n");
-		handlePDelayRespFollowUp(&ptpClock->msgTmpHeader, 
-					 ptpClock->msgIbuf, length, 
-					 isFromSelf, rtOpts, ptpClock);
+		handlePDelayRespFollowUp(msgIbuf, length, isFromSelf, 
+					 rtOpts, ptpClock);
 		break;
 	case MANAGEMENT:
 		DBGV("received MANAGEMENT message, entering handleManagement()\n");
-		handleManagement(&ptpClock->msgTmpHeader, ptpClock->msgIbuf, 
-				 length, isFromSelf, rtOpts, ptpClock);
+		handleManagement(msgIbuf, length, isFromSelf, rtOpts, ptpClock);
 		break;
 	case SIGNALING:
 		DBGV("received SIGNALING message, entering handleSignaling()\n");
-		handleSignaling(&ptpClock->msgTmpHeader, ptpClock->msgIbuf, 
-				length, isFromSelf, rtOpts, ptpClock);
+		handleSignaling(msgIbuf, length, isFromSelf, rtOpts, ptpClock);
 		break;
 	default:
 		DBG("handle: unrecognized message\n");
@@ -572,13 +794,15 @@ handle(RunTimeOpts *rtOpts, PtpClock *ptpClock)
 
 	if (rtOpts->displayPackets)
 		msgDump(ptpClock);
+	ptpClock->msgRecv = NULL;
 }
 
 /*spec 9.5.3*/
 void 
-handleAnnounce(MsgHeader *header, Octet *msgIbuf, ssize_t length, 
+handleAnnounce(Octet *msgIbuf, ssize_t length, 
 	       bool isFromSelf, RunTimeOpts *rtOpts, PtpClock *ptpClock)
 {
+	MsgHeader *header = &ptpClock->msgTmpHeader;
 	bool isFromCurrentParent = FALSE; 
  	
 	DBGV("HandleAnnounce : Announce message received : \n");
@@ -612,18 +836,17 @@ handleAnnounce(MsgHeader *header, Octet *msgIbuf, ssize_t length,
 		ptpClock->record_update = TRUE; 
 
 		
-		isFromCurrentParent = !memcmp(
-			ptpClock->parentPortIdentity.clockIdentity,
-			header->sourcePortIdentity.clockIdentity,
-			CLOCK_IDENTITY_LENGTH)	&& 
-			(ptpClock->parentPortIdentity.portNumber == 
-			 header->sourcePortIdentity.portNumber);
+		isFromCurrentParent = msgViewIsPortIdentity(
+			msgIbuf + 20, &ptpClock->parentPortIdentity);
 	
 		switch (isFromCurrentParent) {	
 		case TRUE:
-	   		msgUnpackAnnounce(ptpClock->msgIbuf,
+	   		msgUnpackHeader(msgIbuf, header);
+	   		msgUnpackAnnounce(msgIbuf,
 					  &ptpClock->announce);
 	   		s1(header,&ptpClock->announce,ptpClock);
+			if (ptpClock->msgTmpSource.len)
+				ptpClock->parentAddr = ptpClock->msgTmpSource;
 	   		
 	   		/*Reset Timer handling Announce receipt timeout*/
 	   		timerStart(ANNOUNCE_RECEIPT_TIMER,
@@ -634,7 +857,7 @@ handleAnnounce(MsgHeader *header, Octet *msgIbuf, ssize_t length,
 	   		
 		case FALSE:
 	   		/*addForeign takes care of AnnounceUnpacking*/
-	   		addForeign(ptpClock->msgIbuf,header,ptpClock);
+	   		addForeign(msgIbuf,ptpClock);
 	   		
 	   		/*Reset Timer handling Announce receipt timeout*/
 	   		timerStart(ANNOUNCE_RECEIPT_TIMER,
@@ -660,7 +883,7 @@ handleAnnounce(MsgHeader *header, Octet *msgIbuf, ssize_t length,
 		}
 		
 		DBGV("Announce message from another foreign master");
-		addForeign(ptpClock->msgIbuf,header,ptpClock);
+		addForeign(msgIbuf,ptpClock);
 		ptpClock->record_update = TRUE;
 		break;
 	   
@@ -669,12 +892,12 @@ handleAnnounce(MsgHeader *header, Octet *msgIbuf, ssize_t length,
 }
 	
 void 
-handleSync(MsgHeader *header, Octet *msgIbuf, ssize_t length, 
+handleSync(Octet *msgIbuf, ssize_t length, 
 	   TimeInternal *time, bool isFromSelf, 
 	   RunTimeOpts *rtOpts, PtpClock *ptpClock)
 {
-	TimeInternal OriginPTP_Timestamp;
-	TimeInternal correctionField;
+	TimeNs OriginPTP_Timestamp;
+	TimeNs correctionField;
 
 	bool isFromCurrentParent = FALSE;
 	DBG("Sync message received : \n");
@@ -699,53 +922,44 @@ handleSync(MsgHeader *header, Octet *msgIbuf, ssize_t length,
 			DBG("HandleSync: Ignore message from self \n");
 			return;
 		}
-		isFromCurrentParent = 
-			!memcmp(ptpClock->parentPortIdentity.clockIdentity,
-				header->sourcePortIdentity.clockIdentity,
-				CLOCK_IDENTITY_LENGTH) && 
-			(ptpClock->parentPortIdentity.portNumber == 
-			 header->sourcePortIdentity.portNumber);
+		isFromCurrentParent = msgViewIsPortIdentity(
+			msgIbuf + 20, &ptpClock->parentPortIdentity);
 		
 		if (isFromCurrentParent) {
-			ptpClock->sync_receive_time.seconds = time->seconds;
-			ptpClock->sync_receive_time.nanoseconds = 
-				time->nanoseconds;
+			/* hybrid mode sends the DelayReq back to it */
+			if (ptpClock->msgTmpSource.len)
+				ptpClock->parentAddr = ptpClock->msgTmpSource;
+
+			ptpClock->sync_receive_time = internalTimeToNs(time);
 				
 			if (rtOpts->recordFP) 
 				fprintf(rtOpts->recordFP, "%d %llu\n", 
-					header->sequenceId, 
-					((time->seconds * 1000000000ULL) + 
-					 time->nanoseconds));
+					msgViewSequenceId(msgIbuf), 
+					(unsigned long long)
+					ptpClock->sync_receive_time);
 
 			/*(if ((header->flagField[0] & 0x02) == TWO_STEP_FLAG) {
 				ptpClock->waitingForFollow = TRUE;
 				ptpClock->recvSyncSequenceId = 
 					header->sequenceId;
-				integer64_to_internalTime(
-					header->correctionfield,
-					&correctionField);
-				ptpClock->lastSyncCorrectionField.seconds = 
-					correctionField.seconds;
-				ptpClock->lastSyncCorrectionField.nanoseconds =
-					correctionField.nanoseconds;
+				ptpClock->lastSyncCorrectionField = 
+					integer64ToNs(header->correctionfield);
 				break;
 			} else {*/
 
 			//Taken out !!! HERE !! HERE !!
 
-				msgUnpackSync(ptpClock->msgIbuf,
-					      &ptpClock->sync);
-				integer64_to_internalTime(
-					ptpClock->msgTmpHeader.correctionfield,
-					&correctionField);
-				timeInternal_display(&correctionField);
+				if (!msgViewTimestamp(msgIbuf + 34,
+						      &OriginPTP_Timestamp))
+					break;
+				correctionField = 
+					msgViewCorrectionField(msgIbuf);
+				timeNs_display(correctionField);
 				ptpClock->waitingForFollow = FALSE;
-				toInternalTime(&OriginPTP_Timestamp,
-					       &ptpClock->sync.originPTP_Timestamp);
-				updateOffset(&OriginPTP_Timestamp,
-					     &ptpClock->sync_receive_time,
+				updateOffset(OriginPTP_Timestamp,
+					     ptpClock->sync_receive_time,
 					     &ptpClock->ofm_filt,rtOpts,
-					     ptpClock,&correctionField);
+					     ptpClock,correctionField);
 				updateClock(rtOpts,ptpClock);
 				break;
 			//}
@@ -759,9 +973,9 @@ handleSync(MsgHeader *header, Octet *msgIbuf, ssize_t length,
 			     "another Master  \n");
 			break;
 		} else {
-			/*Add latency*/
-			addTime(time,time,&rtOpts->outboundLatency);
-			issueFollowup(time,rtOpts,ptpClock);
+			/* looped back: its receive time is our send time */
+			handleTxTimestamp(SYNC, msgViewSequenceId(msgIbuf), time,
+					  rtOpts, ptpClock);
 			break;
 		}	
 	}
@@ -769,13 +983,13 @@ handleSync(MsgHeader *header, Octet *msgIbuf, ssize_t length,
 
 
 void 
-handleFollowUp(MsgHeader *header, Octet *msgIbuf, ssize_t length, 
+handleFollowUp(Octet *msgIbuf, ssize_t length, 
 	       bool isFromSelf, RunTimeOpts *rtOpts, PtpClock *ptpClock)
 {
 	DBG("Handlefollowup : Follow up message received \n");
 	
-	TimeInternal preciseOriginPTP_Timestamp;
-	TimeInternal correctionField;
+	TimeNs preciseOriginPTP_Timestamp;
+	TimeNs correctionField;
 	bool isFromCurrentParent = FALSE;
 	
 	if(length < FOLLOW_UP_LENGTH)
@@ -804,30 +1018,24 @@ handleFollowUp(MsgHeader *header, Octet *msgIbuf, ssize_t length,
 	case PTP_UNCALIBRATED:	
 	case PTP_SLAVE:
 
-		isFromCurrentParent = 
-			!memcmp(ptpClock->parentPortIdentity.clockIdentity,
-				header->sourcePortIdentity.clockIdentity,
-				CLOCK_IDENTITY_LENGTH) && 
-			(ptpClock->parentPortIdentity.portNumber == 
-			 header->sourcePortIdentity.portNumber);
+		isFromCurrentParent = msgViewIsPortIdentity(
+			msgIbuf + 20, &ptpClock->parentPortIdentity);
 	 	
 		if (isFromCurrentParent) {
 			if (ptpClock->waitingForFollow)	{
 				if ((ptpClock->recvSyncSequenceId == 
-				     header->sequenceId)) {
-					msgUnpackFollowUp(ptpClock->msgIbuf,
-							  &ptpClock->follow);
+				     msgViewSequenceId(msgIbuf))) {
 					ptpClock->waitingForFollow = FALSE;
-					toInternalTime(&preciseOriginPTP_Timestamp,
-						       &ptpClock->follow.preciseOriginPTP_Timestamp);
-					integer64_to_internalTime(ptpClock->msgTmpHeader.correctionfield,
-								  &correctionField);
-					addTime(&correctionField,&correctionField,
-						&ptpClock->lastSyncCorrectionField);
-					updateOffset(&preciseOriginPTP_Timestamp,
-						     &ptpClock->sync_receive_time,&ptpClock->ofm_filt,
+					if (!msgViewTimestamp(msgIbuf + 34,
+							      &preciseOriginPTP_Timestamp))
+						break;
+					correctionField = 
+						msgViewCorrectionField(msgIbuf) + 
+						ptpClock->lastSyncCorrectionField;
+					updateOffset(preciseOriginPTP_Timestamp,
+						     ptpClock->sync_receive_time,&ptpClock->ofm_filt,
 						     rtOpts,ptpClock,
-						     &correctionField);
+						     correctionField);
 					updateClock(rtOpts,ptpClock);
 					break;	 		
 				} else 
@@ -852,7 +1060,7 @@ handleFollowUp(MsgHeader *header, Octet *msgIbuf, ssize_t length,
 
 
 void 
-handleDelayReq(MsgHeader *header, Octet *msgIbuf, ssize_t length, 
+handleDelayReq(Octet *msgIbuf, ssize_t length, 
 	       TimeInternal *time, bool isFromSelf,
 	       RunTimeOpts *rtOpts, PtpClock *ptpClock)
 {
@@ -881,26 +1089,23 @@ handleDelayReq(MsgHeader *header, Octet *msgIbuf, ssize_t length,
 
 	case PTP_SLAVE:
 		if (isFromSelf)	{
-			/* 
-			 * Get sending PTP_Timestamp from IP stack
-			 * with So_PTP_Timestamp
-			 */
-			ptpClock->delay_req_send_time.seconds = 
-				time->seconds;
-			ptpClock->delay_req_send_time.nanoseconds = 
-				time->nanoseconds;
-
-			/*Add latency*/
-			addTime(&ptpClock->delay_req_send_time,
-				&ptpClock->delay_req_send_time,
-				&rtOpts->outboundLatency);
+			/* looped back: its receive time is our send time */
+			handleTxTimestamp(DELAY_REQ, msgViewSequenceId(msgIbuf), time,
+					  rtOpts, ptpClock);
 			break;
 		}
 		break;
 
 	case PTP_MASTER:
-		msgUnpackHeader(ptpClock->msgIbuf,
+		msgUnpackHeader(msgIbuf,
 				&ptpClock->delayReqHeader);
+		/* a negotiating master only answers slaves it granted DelayResp */
+		if (rtOpts->unicastNegotiation &&
+		    !unicastHasGrant(&ptpClock->delayReqHeader.sourcePortIdentity,
+				     UNICAST_DELAY_RESP, ptpClock)) {
+			DBGV("HandledelayReq : no unicast grant \n");
+			break;
+		}
 		issueDelayResp(time,&ptpClock->delayReqHeader,
 			       rtOpts,ptpClock);
 		break;
@@ -912,7 +1117,7 @@ handleDelayReq(MsgHeader *header, Octet *msgIbuf, ssize_t length,
 }
 
 void 
-handleDelayResp(MsgHeader *header, Octet *msgIbuf, ssize_t length,
+handleDelayResp(Octet *msgIbuf, ssize_t length,
 		bool isFromSelf, RunTimeOpts *rtOpts, PtpClock *ptpClock)
 {
 	if (! rtOpts->E2E_mode) {
@@ -922,8 +1127,6 @@ handleDelayResp(MsgHeader *header, Octet *msgIbuf, ssize_t length,
 	}
 
 	bool isFromCurrentParent = FALSE;
-	TimeInternal requestReceiptPTP_Timestamp;
-	TimeInternal correctionField;
 
 	DBGV("delayResp message received : \n");
 
@@ -943,39 +1146,24 @@ handleDelayResp(MsgHeader *header, Octet *msgIbuf, ssize_t length,
 		return;
 
 	case PTP_SLAVE:
-		msgUnpackDelayResp(ptpClock->msgIbuf,
-				   &ptpClock->resp);
-
-		if ((memcmp(ptpClock->parentPortIdentity.clockIdentity,
-			    header->sourcePortIdentity.clockIdentity,
-			    CLOCK_IDENTITY_LENGTH) == 0 ) &&
-		    (ptpClock->parentPortIdentity.portNumber == 
-		     header->sourcePortIdentity.portNumber))
-			isFromCurrentParent = TRUE;
+		isFromCurrentParent = msgViewIsPortIdentity(
+			msgIbuf + 20, &ptpClock->parentPortIdentity);
 		
-		if ((memcmp(ptpClock->portIdentity.clockIdentity,
-			    ptpClock->resp.requestingPortIdentity.clockIdentity,
-			    CLOCK_IDENTITY_LENGTH) == 0) &&
+		if (msgViewIsPortIdentity(msgIbuf + 44, 
+					  &ptpClock->portIdentity) &&
 		    ((ptpClock->sentDelayReqSequenceId - 1)== 
-		     header->sequenceId) &&
-		    (ptpClock->portIdentity.portNumber == 
-		     ptpClock->resp.requestingPortIdentity.portNumber)
+		     msgViewSequenceId(msgIbuf))
 		    && isFromCurrentParent) {
-			toInternalTime(&requestReceiptPTP_Timestamp,
-				       &ptpClock->resp.receivePTP_Timestamp);
-			ptpClock->delay_req_receive_time.seconds = 
-				requestReceiptPTP_Timestamp.seconds;
-			ptpClock->delay_req_receive_time.nanoseconds = 
-				requestReceiptPTP_Timestamp.nanoseconds;
-
-			integer64_to_internalTime(
-				header->correctionfield,
-				&correctionField);
+			if (!msgViewTimestamp(msgIbuf + 34,
+					      &ptpClock->delay_req_receive_time))
+				break;
+
 			updateDelay(&ptpClock->owd_filt,
-				    rtOpts,ptpClock, &correctionField);
+				    rtOpts,ptpClock, 
+				    msgViewCorrectionField(msgIbuf));
 
 			ptpClock->logMinDelayReqInterval = 
-				header->logMessageInterval;
+				msgViewLogMessageInterval(msgIbuf);
 		} else {
 			DBGV("HandledelayResp : delayResp doesn't match with the delayReq. \n");
 			break;
@@ -985,10 +1173,12 @@ handleDelayResp(MsgHeader *header, Octet *msgIbuf, ssize_t length,
 
 
 void 
-handlePDelayReq(MsgHeader *header, Octet *msgIbuf, ssize_t length, 
+handlePDelayReq(Octet *msgIbuf, ssize_t length, 
 		TimeInternal *time, bool isFromSelf, 
 		RunTimeOpts *rtOpts, PtpClock *ptpClock)
 {
+	MsgHeader *header = &ptpClock->msgTmpHeader;
+
 	if (rtOpts->E2E_mode) {
 		/* (End to End mode..) */
 		ERROR("Peer Delay messages are disregarded in End to End mode \n");
@@ -1002,6 +1192,7 @@ handlePDelayReq(MsgHeader *header, Octet *msgIbuf, ssize_t length,
 		toState(PTP_FAULTY, rtOpts, ptpClock);
 		return;
 	}	
+	msgUnpackHeader(msgIbuf, header);
 
 	switch(ptpClock->portState ) {
 	case PTP_INITIALIZING:
@@ -1017,22 +1208,12 @@ handlePDelayReq(MsgHeader *header, Octet *msgIbuf, ssize_t length,
 	case PTP_PASSIVE:
 	
 		if (isFromSelf) {
-			/* 
-			 * Get sending PTP_Timestamp from IP stack
-			 * with So_PTP_Timestamp
-			 */
-			ptpClock->pdelay_req_send_time.seconds = 
-				time->seconds;
-			ptpClock->pdelay_req_send_time.nanoseconds = 
-				time->nanoseconds;
-		
-			/*Add latency*/
-			addTime(&ptpClock->pdelay_req_send_time,
-				&ptpClock->pdelay_req_send_time,
-				&rtOpts->outboundLatency);
+			/* looped back: its receive time is our send time */
+			handleTxTimestamp(PDELAY_REQ, header->sequenceId, 
+					  time, rtOpts, ptpClock);
 			break;
 		} else {
-			msgUnpackHeader(ptpClock->msgIbuf,
+			msgUnpackHeader(msgIbuf,
 					&ptpClock->PdelayReqHeader);
 			issuePDelayResp(time, header, rtOpts, 
 					ptpClock);	
@@ -1045,10 +1226,12 @@ handlePDelayReq(MsgHeader *header, Octet *msgIbuf, ssize_t length,
 }
 
 void 
-handlePDelayResp(MsgHeader *header, Octet *msgIbuf, TimeInternal *time,
+handlePDelayResp(Octet *msgIbuf, TimeInternal *time,
 		 ssize_t length, bool isFromSelf, 
 		 RunTimeOpts *rtOpts, PtpClock *ptpClock)
 {
+	MsgHeader *header = &ptpClock->msgTmpHeader;
+
 	if (rtOpts->E2E_mode) {
 		/* (End to End mode..) */
 		ERROR("Peer Delay messages are disregarded in End to End mode \n");
@@ -1056,8 +1239,6 @@ handlePDelayResp(MsgHeader *header, Octet *msgIbuf, TimeInternal *time,
 	}
 
 	bool isFromCurrentParent = FALSE;
-	TimeInternal requestReceiptPTP_Timestamp;
-	TimeInternal correctionField;
 
 	DBGV("PdelayResp message received : \n");
 
@@ -1066,6 +1247,7 @@ handlePDelayResp(MsgHeader *header, Octet *msgIbuf, TimeInternal *time,
 		toState(PTP_FAULTY, rtOpts, ptpClock);
 		return;
 	}	
+	msgUnpackHeader(msgIbuf, header);
 
 	switch(ptpClock->portState ) {
 	case PTP_INITIALIZING:
@@ -1078,13 +1260,11 @@ handlePDelayResp(MsgHeader *header, Octet *msgIbuf, TimeInternal *time,
 	
 	case PTP_SLAVE:
 		if (isFromSelf)	{
-			addTime(time,time,&rtOpts->outboundLatency);
-			issuePDelayRespFollowUp(time,
-						&ptpClock->PdelayReqHeader,
-						rtOpts,ptpClock);
+			handleTxTimestamp(PDELAY_RESP, header->sequenceId, 
+					  time, rtOpts, ptpClock);
 			break;
 		}
-		msgUnpackPDelayResp(ptpClock->msgIbuf,
+		msgUnpackPDelayResp(msgIbuf,
 				    &ptpClock->presp);
 	
 		isFromCurrentParent = !memcmp(ptpClock->parentPortIdentity.clockIdentity,
@@ -1101,26 +1281,20 @@ handlePDelayResp(MsgHeader *header, Octet *msgIbuf, TimeInternal *time,
 			if ((header->flagField[0] & 0x02) == 
 			    TWO_STEP_FLAG) {
 				/*Store t4 (Fig 35)*/
-				ptpClock->pdelay_resp_receive_time.seconds = time->seconds;
-				ptpClock->pdelay_resp_receive_time.nanoseconds = time->nanoseconds;
+				ptpClock->pdelay_resp_receive_time = internalTimeToNs(time);
 				/*store t2 (Fig 35)*/
-				toInternalTime(&requestReceiptPTP_Timestamp,
-					       &ptpClock->presp.requestReceiptPTP_Timestamp);
-				ptpClock->pdelay_req_receive_time.seconds = requestReceiptPTP_Timestamp.seconds;
-				ptpClock->pdelay_req_receive_time.nanoseconds = requestReceiptPTP_Timestamp.nanoseconds;
+				if (!timestampToNs(&ptpClock->presp.requestReceiptPTP_Timestamp,
+						   &ptpClock->pdelay_req_receive_time))
+					break;
 				
-				integer64_to_internalTime(header->correctionfield,&correctionField);
-				ptpClock->lastPdelayRespCorrectionField.seconds = correctionField.seconds;
-				ptpClock->lastPdelayRespCorrectionField.nanoseconds = correctionField.nanoseconds;
+				ptpClock->lastPdelayRespCorrectionField = integer64ToNs(header->correctionfield);
 				break;
 			} else {
 			/* One step Clock */
 				/*Store t4 (Fig 35)*/
-				ptpClock->pdelay_resp_receive_time.seconds = time->seconds;
-				ptpClock->pdelay_resp_receive_time.nanoseconds = time->nanoseconds;
+				ptpClock->pdelay_resp_receive_time = internalTimeToNs(time);
 				
-				integer64_to_internalTime(header->correctionfield,&correctionField);
-				updatePeerDelay (&ptpClock->owd_filt,rtOpts,ptpClock,&correctionField,FALSE);
+				updatePeerDelay (&ptpClock->owd_filt,rtOpts,ptpClock,integer64ToNs(header->correctionfield),FALSE);
 
 				break;
 			}
@@ -1133,16 +1307,11 @@ handlePDelayResp(MsgHeader *header, Octet *msgIbuf, TimeInternal *time,
 	case PTP_MASTER:
 		/*Loopback PTP_Timestamp*/
 		if (isFromSelf) {
-			/*Add latency*/
-			addTime(time,time,&rtOpts->outboundLatency);
-				
-			issuePDelayRespFollowUp(
-				time,
-				&ptpClock->PdelayReqHeader,
-				rtOpts, ptpClock);
+			handleTxTimestamp(PDELAY_RESP, header->sequenceId, 
+					  time, rtOpts, ptpClock);
 			break;
 		}
-		msgUnpackPDelayResp(ptpClock->msgIbuf,
+		msgUnpackPDelayResp(msgIbuf,
 				    &ptpClock->presp);
 	
 		isFromCurrentParent = !memcmp(ptpClock->parentPortIdentity.clockIdentity,header->sourcePortIdentity.clockIdentity,CLOCK_IDENTITY_LENGTH)
@@ -1159,32 +1328,23 @@ handlePDelayResp(MsgHeader *header, Octet *msgIbuf, TimeInternal *time,
 			if ((header->flagField[0] & 0x02) == 
 			    TWO_STEP_FLAG) {
 				/*Store t4 (Fig 35)*/
-				ptpClock->pdelay_resp_receive_time.seconds = time->seconds;
-				ptpClock->pdelay_resp_receive_time.nanoseconds = time->nanoseconds;
+				ptpClock->pdelay_resp_receive_time = internalTimeToNs(time);
 				/*store t2 (Fig 35)*/
-				toInternalTime(&requestReceiptPTP_Timestamp,
-					       &ptpClock->presp.requestReceiptPTP_Timestamp);
-				ptpClock->pdelay_req_receive_time.seconds = 
-					requestReceiptPTP_Timestamp.seconds;
-				ptpClock->pdelay_req_receive_time.nanoseconds = 
-					requestReceiptPTP_Timestamp.nanoseconds;
-				integer64_to_internalTime(
-					header->correctionfield,
-					&correctionField);
-				ptpClock->lastPdelayRespCorrectionField.seconds = correctionField.seconds;
-				ptpClock->lastPdelayRespCorrectionField.nanoseconds = correctionField.nanoseconds;
+				if (!timestampToNs(
+					    &ptpClock->presp.requestReceiptPTP_Timestamp,
+					    &ptpClock->pdelay_req_receive_time))
+					break;
+				ptpClock->lastPdelayRespCorrectionField = 
+					integer64ToNs(header->correctionfield);
 				break;
 			} else { /* One step Clock */
 				/*Store t4 (Fig 35)*/
-				ptpClock->pdelay_resp_receive_time.seconds = time->seconds;
-				ptpClock->pdelay_resp_receive_time.nanoseconds = time->nanoseconds;
+				ptpClock->pdelay_resp_receive_time = internalTimeToNs(time);
 				
-				integer64_to_internalTime(
-					header->correctionfield,
-					&correctionField);
 				updatePeerDelay(&ptpClock->owd_filt,
 						rtOpts,ptpClock,
-						&correctionField,FALSE);
+						integer64ToNs(header->correctionfield),
+						FALSE);
 				break;
 			}
 		}
@@ -1196,9 +1356,11 @@ handlePDelayResp(MsgHeader *header, Octet *msgIbuf, TimeInternal *time,
 }
 
 void 
-handlePDelayRespFollowUp(MsgHeader *header, Octet *msgIbuf, ssize_t length, 
+handlePDelayRespFollowUp(Octet *msgIbuf, ssize_t length, 
 			 bool isFromSelf, RunTimeOpts *rtOpts, 
 			 PtpClock *ptpClock){
+	MsgHeader *header = &ptpClock->msgTmpHeader;
+
 
 	if (rtOpts->E2E_mode) {
 		/* (End to End mode..) */
@@ -1206,8 +1368,7 @@ handlePDelayRespFollowUp(MsgHeader *header, Octet *msgIbuf, ssize_t length,
 		return;
 	}
 
-	TimeInternal responseOriginPTP_Timestamp;
-	TimeInternal correctionField;
+	TimeNs correctionField;
 
 	DBGV("PdelayRespfollowup message received : \n");
 
@@ -1216,6 +1377,7 @@ handlePDelayRespFollowUp(MsgHeader *header, Octet *msgIbuf, ssize_t length,
 		toState(PTP_FAULTY, rtOpts, ptpClock);
 		return;
 	}	
+	msgUnpackHeader(msgIbuf, header);
 
 	switch(ptpClock->portState) {
 	case PTP_INITIALIZING:
@@ -1229,46 +1391,35 @@ handlePDelayRespFollowUp(MsgHeader *header, Octet *msgIbuf, ssize_t length,
 		if (header->sequenceId == 
 		    ptpClock->sentPDelayReqSequenceId-1) {
 			msgUnpackPDelayRespFollowUp(
-				ptpClock->msgIbuf,
+				msgIbuf,
 				&ptpClock->prespfollow);
-			toInternalTime(
-				&responseOriginPTP_Timestamp,
-				&ptpClock->prespfollow.responseOriginPTP_Timestamp);
-			ptpClock->pdelay_resp_send_time.seconds = 
-				responseOriginPTP_Timestamp.seconds;
-			ptpClock->pdelay_resp_send_time.nanoseconds = 
-				responseOriginPTP_Timestamp.nanoseconds;
-			integer64_to_internalTime(
-				ptpClock->msgTmpHeader.correctionfield,
-				&correctionField);
-			addTime(&correctionField,&correctionField,
-				&ptpClock->lastPdelayRespCorrectionField);
+			if (!timestampToNs(
+				    &ptpClock->prespfollow.responseOriginPTP_Timestamp,
+				    &ptpClock->pdelay_resp_send_time))
+				break;
+			correctionField = 
+				integer64ToNs(ptpClock->msgTmpHeader.correctionfield) + 
+				ptpClock->lastPdelayRespCorrectionField;
 			updatePeerDelay (&ptpClock->owd_filt,
 					 rtOpts, ptpClock,
-					 &correctionField,TRUE);
+					 correctionField,TRUE);
 			break;
 		}
 	case PTP_MASTER:
 		if (header->sequenceId == 
 		    ptpClock->sentPDelayReqSequenceId-1) {
 			msgUnpackPDelayRespFollowUp(
-				ptpClock->msgIbuf,
+				msgIbuf,
 				&ptpClock->prespfollow);
-			toInternalTime(&responseOriginPTP_Timestamp,
-				       &ptpClock->prespfollow.responseOriginPTP_Timestamp);
-			ptpClock->pdelay_resp_send_time.seconds = 
-				responseOriginPTP_Timestamp.seconds;
-			ptpClock->pdelay_resp_send_time.nanoseconds = 
-				responseOriginPTP_Timestamp.nanoseconds;
-			integer64_to_internalTime(
-				ptpClock->msgTmpHeader.correctionfield,
-				&correctionField);
-			addTime(&correctionField, 
-				&correctionField,
-				&ptpClock->lastPdelayRespCorrectionField);
+			if (!timestampToNs(&ptpClock->prespfollow.responseOriginPTP_Timestamp,
+					   &ptpClock->pdelay_resp_send_time))
+				break;
+			correctionField = 
+				integer64ToNs(ptpClock->msgTmpHeader.correctionfield) + 
+				ptpClock->lastPdelayRespCorrectionField;
 			updatePeerDelay(&ptpClock->owd_filt,
 					rtOpts, ptpClock,
-					&correctionField,TRUE);
+					correctionField,TRUE);
 			break;
 		}
 	default:
@@ -1277,29 +1428,48 @@ handlePDelayRespFollowUp(MsgHeader *header, Octet *msgIbuf, ssize_t length,
 }
 
 void 
-handleManagement(MsgHeader *header, Octet *msgIbuf, ssize_t length, 
+handleManagement(Octet *msgIbuf, ssize_t length, 
 		 bool isFromSelf, RunTimeOpts *rtOpts, PtpClock *ptpClock)
 {}
 
+/* Signaling only carries unicast negotiation TLVs here, see unicast.c */
 void 
-handleSignaling(MsgHeader *header, Octet *msgIbuf, ssize_t length, 
+handleSignaling(Octet *msgIbuf, ssize_t length, 
 		     bool isFromSelf, RunTimeOpts *rtOpts, 
 		     PtpClock *ptpClock)
-{}
+{
+	MsgHeader *header = &ptpClock->msgTmpHeader;
+
+	if (isFromSelf || !rtOpts->unicastNegotiation)
+		return;
+
+	if (length < SIGNALING_LENGTH) {
+		ERROR("short Signaling message\n");
+		toState(PTP_FAULTY, rtOpts, ptpClock);
+		return;
+	}
+
+	msgUnpackHeader(msgIbuf, header);
+	if (!unicastHandleSignaling(header, msgIbuf, length, rtOpts, ptpClock))
+		toState(PTP_FAULTY, rtOpts, ptpClock);
+}
 
 
 /*Pack and send on general multicast ip adress an Announce message*/
 void 
 issueAnnounce(RunTimeOpts *rtOpts,PtpClock *ptpClock)
 {
-	msgPackAnnounce(ptpClock->msgObuf,ptpClock);
+	Octet *buf = ptpClock->msgTemplate[ANNOUNCE];
+
+	msgPackSequenceId(buf,ptpClock->sentAnnounceSequenceId);
 	
-	if (!netSendGeneral(ptpClock->msgObuf,ANNOUNCE_LENGTH,
+	if (!netSendGeneral(buf,ANNOUNCE_LENGTH,
 			    &ptpClock->netPath)) {
 		toState(PTP_FAULTY,rtOpts,ptpClock);
 		DBGV("Announce message can't be sent -> FAULTY state \n");
 	} else {
 		DBGV("Announce MSG sent ! \n");
+		ptpClock->txMessages[ANNOUNCE]++;
 		ptpClock->sentAnnounceSequenceId++;
 	}
 }
@@ -1310,18 +1480,21 @@ issueAnnounce(RunTimeOpts *rtOpts,PtpClock *ptpClock)
 void 
 issueSync(RunTimeOpts *rtOpts,PtpClock *ptpClock)
 {
+	Octet *buf = ptpClock->msgTemplate[SYNC];
 	PTP_Timestamp originPTP_Timestamp;
 	TimeInternal internalTime;
 	getTime(&internalTime);
 	fromInternalTime(&internalTime,&originPTP_Timestamp);
 	
-	msgPackSync(ptpClock->msgObuf,&originPTP_Timestamp,ptpClock);
+	msgPackSequenceId(buf,ptpClock->sentSyncSequenceId);
+	msgPackTimestamp(buf,&originPTP_Timestamp);
 	
-	if (!netSendEvent(ptpClock->msgObuf,SYNC_LENGTH,&ptpClock->netPath)) {
+	if (!netSendEvent(buf,SYNC_LENGTH,&ptpClock->netPath)) {
 		toState(PTP_FAULTY,rtOpts,ptpClock);
 		DBG("Sync message can't be sent -> FAULTY state \n");
 	} else {
 		DBG("Sync MSG sent ! \n");
+		ptpClock->txMessages[SYNC]++;
 		ptpClock->sentSyncSequenceId++;	
 	}
 }
@@ -1331,38 +1504,61 @@ issueSync(RunTimeOpts *rtOpts,PtpClock *ptpClock)
 void 
 issueFollowup(TimeInternal *time,RunTimeOpts *rtOpts,PtpClock *ptpClock)
 {
+	Octet *buf = ptpClock->msgTemplate[FOLLOW_UP];
 	PTP_Timestamp preciseOriginPTP_Timestamp;
 	fromInternalTime(time,&preciseOriginPTP_Timestamp);
 	
-	msgPackFollowUp(ptpClock->msgObuf,&preciseOriginPTP_Timestamp,ptpClock);
+	/* sentSyncSequenceId has already been incremented in "issueSync" */
+	msgPackSequenceId(buf,ptpClock->sentSyncSequenceId - 1);
+	msgPackTimestamp(buf,&preciseOriginPTP_Timestamp);
 	
-	if (!netSendGeneral(ptpClock->msgObuf,FOLLOW_UP_LENGTH,
+	if (!netSendGeneral(buf,FOLLOW_UP_LENGTH,
 			    &ptpClock->netPath)) {
 		toState(PTP_FAULTY,rtOpts,ptpClock);
 		DBGV("FollowUp message can't be sent -> FAULTY state \n");
 	} else {
 		DBGV("FollowUp MSG sent ! \n");
+		ptpClock->txMessages[FOLLOW_UP]++;
 	}
 }
 
 
-/*Pack and send on event multicast ip adress a DelayReq message*/
+/*
+ * Pack and send on event multicast ip adress a DelayReq message, or
+ * uni-cast to the parent in hybrid mode or with unicast negotiation,
+ * once we know where it is
+ */
 void 
 issueDelayReq(RunTimeOpts *rtOpts,PtpClock *ptpClock)
 {
+	Octet *buf = ptpClock->msgTemplate[DELAY_REQ];
 	PTP_Timestamp originPTP_Timestamp;
 	TimeInternal internalTime;
+	bool unicast = (rtOpts->hybrid_mode || rtOpts->unicastNegotiation) &&
+		ptpClock->parentAddr.len;
+	ssize_t ret;
+
 	getTime(&internalTime);
 	fromInternalTime(&internalTime,&originPTP_Timestamp);
 
-	msgPackDelayReq(ptpClock->msgObuf,&originPTP_Timestamp,ptpClock);
+	msgPackSequenceId(buf,ptpClock->sentDelayReqSequenceId);
+	msgPackTimestamp(buf,&originPTP_Timestamp);
+	msgPackUnicastFlag(buf, unicast);
+
+	if (unicast)
+		ret = netSendEventTo(buf,DELAY_REQ_LENGTH,
+				     &ptpClock->netPath,&ptpClock->parentAddr);
+	else
+		ret = netSendEvent(buf,DELAY_REQ_LENGTH,
+				   &ptpClock->netPath);
+	msgPackUnicastFlag(buf, FALSE);
 
-	if (!netSendEvent(ptpClock->msgObuf,DELAY_REQ_LENGTH,
-			  &ptpClock->netPath)) {
+	if (!ret) {
 		toState(PTP_FAULTY,rtOpts,ptpClock);
 		DBGV("delayReq message can't be sent -> FAULTY state \n");
 	} else {
 		DBGV("DelayReq MSG sent ! \n");
+		ptpClock->txMessages[DELAY_REQ]++;
 		ptpClock->sentDelayReqSequenceId++;
 	}
 }
@@ -1371,19 +1567,22 @@ issueDelayReq(RunTimeOpts *rtOpts,PtpClock *ptpClock)
 void 
 issuePDelayReq(RunTimeOpts *rtOpts,PtpClock *ptpClock)
 {
+	Octet *buf = ptpClock->msgTemplate[PDELAY_REQ];
 	PTP_Timestamp originPTP_Timestamp;
 	TimeInternal internalTime;
 	getTime(&internalTime);
 	fromInternalTime(&internalTime,&originPTP_Timestamp);
 	
-	msgPackPDelayReq(ptpClock->msgObuf,&originPTP_Timestamp,ptpClock);
+	msgPackSequenceId(buf,ptpClock->sentPDelayReqSequenceId);
+	msgPackTimestamp(buf,&originPTP_Timestamp);
 
-	if (!netSendPeerEvent(ptpClock->msgObuf,PDELAY_REQ_LENGTH,
+	if (!netSendPeerEvent(buf,PDELAY_REQ_LENGTH,
 			      &ptpClock->netPath)) {
 		toState(PTP_FAULTY,rtOpts,ptpClock);
 		DBGV("PdelayReq message can't be sent -> FAULTY state \n");
 	} else {
 		DBGV("PDelayReq MSG sent ! \n");
+		ptpClock->txMessages[PDELAY_REQ]++;
 		ptpClock->sentPDelayReqSequenceId++;
 	}
 }
@@ -1393,37 +1592,62 @@ void
 issuePDelayResp(TimeInternal *time,MsgHeader *header,RunTimeOpts *rtOpts,
 		PtpClock *ptpClock)
 {
+	Octet *buf = ptpClock->msgTemplate[PDELAY_RESP];
 	PTP_Timestamp requestReceiptPTP_Timestamp;
 	fromInternalTime(time,&requestReceiptPTP_Timestamp);
-	msgPackPDelayResp(ptpClock->msgObuf,header,
-			  &requestReceiptPTP_Timestamp,ptpClock);
+	msgPackSequenceId(buf,header->sequenceId);
+	msgPackTimestamp(buf,&requestReceiptPTP_Timestamp);
+	msgPackRequestingPortIdentity(buf,&header->sourcePortIdentity);
 
-	if (!netSendPeerEvent(ptpClock->msgObuf,PDELAY_RESP_LENGTH,
+	if (!netSendPeerEvent(buf,PDELAY_RESP_LENGTH,
 			      &ptpClock->netPath)) {
 		toState(PTP_FAULTY,rtOpts,ptpClock);
 		DBGV("PdelayResp message can't be sent -> FAULTY state \n");
 	} else {
 		DBGV("PDelayResp MSG sent ! \n");
+		ptpClock->txMessages[PDELAY_RESP]++;
 	}
 }
 
 
-/*Pack and send on event multicast ip adress a DelayResp message*/
+/*
+ * Pack and send on general multicast ip adress a DelayResp message. a
+ * uni-cast DelayReq (hybrid mode) is answered uni-cast to its sender,
+ * so the other slaves never see the response
+ */
 void 
 issueDelayResp(TimeInternal *time,MsgHeader *header,RunTimeOpts *rtOpts,
 	       PtpClock *ptpClock)
 {
+	Octet *buf = ptpClock->msgTemplate[DELAY_RESP];
 	PTP_Timestamp requestReceiptPTP_Timestamp;
-	fromInternalTime(time,&requestReceiptPTP_Timestamp);
-	msgPackDelayResp(ptpClock->msgObuf,header,&requestReceiptPTP_Timestamp,
-			 ptpClock);
+	bool unicast = (header->flagField[0] & UNICAST_FLAG) &&
+		ptpClock->msgTmpSource.len;
+	ssize_t ret;
 
-	if (!netSendGeneral(ptpClock->msgObuf,PDELAY_RESP_LENGTH,
-			    &ptpClock->netPath)) {
+	fromInternalTime(time,&requestReceiptPTP_Timestamp);
+	/* correctionField of the DelayReq */
+	msgPackSequenceId(buf,header->sequenceId);
+	msgPackCorrectionField(buf,&header->correctionfield);
+	msgPackTimestamp(buf,&requestReceiptPTP_Timestamp);
+	msgPackRequestingPortIdentity(buf,&header->sourcePortIdentity);
+	msgPackUnicastFlag(buf, unicast);
+
+	if (unicast)
+		ret = netSendGeneralTo(buf,DELAY_RESP_LENGTH,
+				       &ptpClock->netPath,
+				       &ptpClock->msgTmpSource);
+	else
+		ret = netSendGeneral(buf,DELAY_RESP_LENGTH,
+				     &ptpClock->netPath);
+	msgPackUnicastFlag(buf, FALSE);
+
+	if (!ret) {
 		toState(PTP_FAULTY,rtOpts,ptpClock);
 		DBGV("delayResp message can't be sent -> FAULTY state \n");
 	} else {
 		DBGV("PDelayResp MSG sent ! \n");
+		ptpClock->txMessages[DELAY_RESP]++;
 	}
 }
 
@@ -1432,19 +1656,24 @@ issueDelayResp(TimeInternal *time,MsgHeader *header,RunTimeOpts *rtOpts,
 void issuePDelayRespFollowUp(TimeInternal *time, MsgHeader *header,
 			     RunTimeOpts *rtOpts, PtpClock *ptpClock)
 {
+	Octet *buf = ptpClock->msgTemplate[PDELAY_RESP_FOLLOW_UP];
 	PTP_Timestamp responseOriginPTP_Timestamp;
 	fromInternalTime(time,&responseOriginPTP_Timestamp);
 
-	msgPackPDelayRespFollowUp(ptpClock->msgObuf,header,
-				  &responseOriginPTP_Timestamp,ptpClock);
+	/* correctionField of the PdelayReq */
+	msgPackSequenceId(buf,ptpClock->PdelayReqHeader.sequenceId);
+	msgPackCorrectionField(buf,&header->correctionfield);
+	msgPackTimestamp(buf,&responseOriginPTP_Timestamp);
+	msgPackRequestingPortIdentity(buf,&header->sourcePortIdentity);
 
-	if (!netSendPeerGeneral(ptpClock->msgObuf,
+	if (!netSendPeerGeneral(buf,
 				PDELAY_RESP_FOLLOW_UP_LENGTH,
 				&ptpClock->netPath)) {
 		toState(PTP_FAULTY,rtOpts,ptpClock);
 		DBGV("PdelayRespFollowUp message can't be sent -> FAULTY state \n");
 	} else {
 		DBGV("PDelayRespFollowUp MSG sent ! \n");
+		ptpClock->txMessages[PDELAY_RESP_FOLLOW_UP]++;
 	}
 }
 
@@ -1454,7 +1683,7 @@ issueManagement(MsgHeader *header,MsgManagement *manage,RunTimeOpts *rtOpts,
 {}
 
 void 
-addForeign(Octet *buf,MsgHeader *header,PtpClock *ptpClock)
+addForeign(Octet *buf,PtpClock *ptpClock)
 {
 	int i,j;
 	bool found = FALSE;
@@ -1463,11 +1692,8 @@ addForeign(Octet *buf,MsgHeader *header,PtpClock *ptpClock)
 	
 	/*Check if Foreign master is already known*/
 	for (i=0;i<ptpClock->number_foreign_records;i++) {
-		if (!memcmp(header->sourcePortIdentity.clockIdentity,
-			    ptpClock->foreign[j].foreignMasterPortIdentity.clockIdentity,
-			    CLOCK_IDENTITY_LENGTH) && 
-		    (header->sourcePortIdentity.portNumber == 
-		     ptpClock->foreign[j].foreignMasterPortIdentity.portNumber))
+		if (msgViewIsPortIdentity(buf + 20,
+			&ptpClock->foreign[j].foreignMasterPortIdentity))
 		{
 			/*Foreign Master is already in Foreignmaster data set*/
 			ptpClock->foreign[j].foreignMasterAnnounceMessages++; 
@@ -1489,20 +1715,17 @@ addForeign(Octet *buf,MsgHeader *header,PtpClock *ptpClock)
 		}
 		j = ptpClock->foreign_record_i;
 		
-		/*Copy new foreign master data set from Announce message*/
-		memcpy(ptpClock->foreign[j].foreignMasterPortIdentity.clockIdentity,
-		       header->sourcePortIdentity.clockIdentity,
-		       CLOCK_IDENTITY_LENGTH);
-		ptpClock->foreign[j].foreignMasterPortIdentity.portNumber = 
-			header->sourcePortIdentity.portNumber;
-		ptpClock->foreign[j].foreignMasterAnnounceMessages = 0;
-		
 		/*
 		 * header and announce field of each Foreign Master are
 		 * usefull to run Best Master Clock Algorithm
 		 */
 		msgUnpackHeader(buf,&ptpClock->foreign[j].header);
 		msgUnpackAnnounce(buf,&ptpClock->foreign[j].announce);
+
+		/*Copy new foreign master data set from Announce message*/
+		ptpClock->foreign[j].foreignMasterPortIdentity = 
+			ptpClock->foreign[j].header.sourcePortIdentity;
+		ptpClock->foreign[j].foreignMasterAnnounceMessages = 0;
 		DBGV("New foreign Master added \n");
 		
 		ptpClock->foreign_record_i = 
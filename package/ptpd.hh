@@ -18,9 +18,11 @@
 #ifndef PTPD_H_
 #define PTPD_H_
 
+#include <click/config.h>
 //#include <click/cxxprotect.h>
 //#include <click/element.hh>
 #include <stdlib.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
@@ -52,15 +54,19 @@
  * -Timing management and arithmetic*/
 /* arith.c */
 /*===============================================================================*/
-/* brief Convert Integer64 into TimeInternal structure */
-void integer64_to_internalTime(Integer64,TimeInternal*);
+/* brief Convert TimeInternal into TimeNs and back */
+TimeNs internalTimeToNs(const TimeInternal*);
+void nsToInternalTime(TimeNs,TimeInternal*);
+
+/* brief Convert a correctionField (Integer64) into TimeNs */
+TimeNs integer64ToNs(Integer64);
+
+/* brief Convert PTP_Timestamp to TimeNs, FALSE if it doesn't fit */
+bool timestampToNs(const PTP_Timestamp*,TimeNs*);
 
 /* brief Convert TimeInternal into PTP_Timestamp structure (defined by the spec)*/
 void fromInternalTime(TimeInternal*,PTP_Timestamp*);
 
-/* brief Convert PTP_Timestamp to TimeInternal structure (defined by the spec) */
-void toInternalTime(TimeInternal*,PTP_Timestamp*);
-
 /*
  * Use to normalize a TimeInternal structure
  * The nanosecondsField member must always be less than 10⁹
@@ -75,9 +81,8 @@ void addTime(TimeInternal*,TimeInternal*,TimeInternal*);
 /* brief Substract two InternalTime structure and normalize */
 void subTime(TimeInternal*,TimeInternal*,TimeInternal*);
 
-
-/* brief Divied an InternalTime by a divisor */
-void divTime(TimeInternal *, int);
+/* brief TRUE if the first normalized InternalTime is before the second */
+bool timeBefore(const TimeInternal*,const TimeInternal*);
 /*===============================================================================*/
 
 
@@ -112,7 +117,30 @@ void initData(RunTimeOpts*,PtpClock*);
  */
 /*===============================================================================*/
 /* protocol.c */
-void protocol(RunTimeOpts*,PtpClock*);
+bool protocolInit(RunTimeOpts*,PtpClock*);
+bool protocolStep(RunTimeOpts*,PtpClock*);
+void protocolRecv(Octet*,ssize_t,TimeInternal*,const NetAddress*,RunTimeOpts*,PtpClock*);
+bool protocolNext(RunTimeOpts*,PtpClock*,TimeInternal*);
+/*===============================================================================*/
+
+
+
+
+/** \name unicast.c
+ * -Unicast negotiation, grant table and send schedule of a master
+ */
+/*===============================================================================*/
+/* unicast.c */
+bool unicastInit(RunTimeOpts*,PtpClock*);
+void unicastShutdown(PtpClock*);
+void unicastReset(RunTimeOpts*,PtpClock*);
+bool unicastHandleSignaling(MsgHeader*,Octet*,ssize_t,RunTimeOpts*,PtpClock*);
+bool unicastRequest(RunTimeOpts*,PtpClock*);
+bool unicastRun(RunTimeOpts*,PtpClock*);
+bool unicastNext(PtpClock*,TimeInternal*);
+bool unicastHasGrant(const PortIdentity*,UInteger8,PtpClock*);
+bool unicastTxSync(UInteger16,TimeInternal*,RunTimeOpts*,PtpClock*);
+/*===============================================================================*/
 
 //Diplay functions usefull to debug
 void displayRunTimeOpts(RunTimeOpts*);
@@ -126,6 +154,7 @@ void displayOthers (PtpClock*);
 void displayBuffer (PtpClock*);
 void displayPtpClock (PtpClock*);
 void timeInternal_display(TimeInternal*);
+void timeNs_display(TimeNs);
 void clockIdentity_display(ClockIdentity);
 void netPath_display(NetPath*);
 void intervalTimer_display(IntervalTimer*);
@@ -149,6 +178,119 @@ void msgPDelayResp_display(MsgPDelayResp * presp);
 void msgUnpackDelayResp(char *,MsgDelayResp *);
 void msgPackDelayReq(char *,PTP_Timestamp *,PtpClock *);
 void msgPackDelayResp(char *,MsgHeader *,PTP_Timestamp *,PtpClock *);
+void msgPackUnicastFlag(char *,bool);
+void msgPackMessageLength(char *,UInteger16);
+void msgPackSequenceId(char *,UInteger16);
+void msgPackCorrectionField(char *,Integer64 *);
+void msgPackTimestamp(char *,PTP_Timestamp *);
+void msgPackRequestingPortIdentity(char *,PortIdentity *);
+void msgPackTemplates(PtpClock *);
+void msgPackSignaling(char *,PortIdentity *,PtpClock *);
+void msgUnpackSignaling(char *,MsgSignaling *);
+UInteger16 msgPackUnicastTLV(char *,MsgUnicastTLV *);
+UInteger16 msgUnpackUnicastTLV(char *,ssize_t,MsgUnicastTLV *);
+
+
+
+/** \name msg.c views
+ * -Read single fields straight from a received message (socket buffer
+ * or Click packet data) instead of unpacking all of it. 'buf' is the
+ * start of the PTP message, or of the field for the port identity and
+ * time stamp views. Nothing is aligned there, so the multi-octet
+ * fields are read through memcpy(), as MsgCodec does. */
+/*===============================================================================*/
+static inline UInteger16 
+msgViewU16(const Octet *buf)
+{
+	UInteger16 u16;
+
+	memcpy(&u16, buf, 2);
+	return flip16(u16);
+}
+
+static inline UInteger32 
+msgViewU32(const Octet *buf)
+{
+	UInteger32 u32;
+
+	memcpy(&u32, buf, 4);
+	return flip32(u32);
+}
+
+static inline Enumeration4 
+msgViewMessageType(const Octet *buf)
+{
+	return *(const UInteger8 *)(buf + 0) & 0x0F;
+}
+
+static inline UInteger4 
+msgViewVersionPTP(const Octet *buf)
+{
+	return *(const UInteger8 *)(buf + 1) & 0x0F;
+}
+
+static inline UInteger8 
+msgViewDomainNumber(const Octet *buf)
+{
+	return *(const UInteger8 *)(buf + 4);
+}
+
+/* first octet of the flagField, TWO_STEP_FLAG and UNICAST_FLAG */
+static inline UInteger8 
+msgViewFlags(const Octet *buf)
+{
+	return *(const UInteger8 *)(buf + 6);
+}
+
+static inline UInteger16 
+msgViewSequenceId(const Octet *buf)
+{
+	return msgViewU16(buf + 30);
+}
+
+static inline Integer8 
+msgViewLogMessageInterval(const Octet *buf)
+{
+	return *(const Integer8 *)(buf + 33);
+}
+
+static inline TimeNs 
+msgViewCorrectionField(const Octet *buf)
+{
+	Integer64 correctionField;
+
+	correctionField.msb = msgViewU32(buf + 8);
+	correctionField.lsb = msgViewU32(buf + 12);
+	return integer64ToNs(correctionField);
+}
+
+/* 
+ * TRUE if the port identity at buf (sourcePortIdentity at 20, or the
+ * requestingPortIdentity of a response at 44) is 'portIdentity'
+ */
+static inline bool 
+msgViewIsPortIdentity(const Octet *buf, const PortIdentity *portIdentity)
+{
+	return msgViewU16(buf + CLOCK_IDENTITY_LENGTH) == 
+		portIdentity->portNumber &&
+		!memcmp(buf, portIdentity->clockIdentity, CLOCK_IDENTITY_LENGTH);
+}
+
+/* 
+ * the time stamp at buf (at 34 in Sync, FollowUp and DelayResp).
+ * FALSE if its seconds don't fit, as with timestampToNs()
+ */
+static inline bool 
+msgViewTimestamp(const Octet *buf, TimeNs *time)
+{
+	PTP_Timestamp timestamp;
+
+	timestamp.secondsField.msb = msgViewU16(buf + 0);
+	timestamp.secondsField.lsb = msgViewU32(buf + 2);
+	timestamp.nanosecondsField = msgViewU32(buf + 6);
+	return timestampToNs(&timestamp, time);
+}
+/*===============================================================================*/
 
 
 
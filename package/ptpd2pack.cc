@@ -22,9 +22,17 @@
 #include "ptpd2pack.hh"
 #include "ptpd.hh"
 #include "datatypes.hh"
+#include <click/args.hh>
+#include <click/confparse.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/standard/scheduleinfo.hh>
+#include <clicknet/ether.h>
 CLICK_DECLS
 
 PTPd2PackageElement::PTPd2PackageElement()
+	: _ptpClock(0), _task(this), _timer(this),
+	  _epollFd(-1), _loop_head(0), _loop_tail(0)
 {
 }
 
@@ -33,63 +41,505 @@ PTPd2PackageElement::~PTPd2PackageElement()
 }
 
 
+int
+PTPd2PackageElement::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+	String iface, latency, unicast_master, servo, kalman_noise, state_file;
+	int domain = DEFAULT_DOMAIN_NUMBER;
+	int sync_interval = DEFAULT_SYNC_INTERVAL;
+	int ap = DEFAULT_AP, ai = DEFAULT_AI;
+	int max_foreign = DEFAULT_MAX_FOREIGN_RECORDS;
+	int rx_batch = DEFAULT_RX_BATCH;
+	int ipv6_scope = DEFAULT_IPV6_SCOPE;
+	int unicast_duration = DEFAULT_UNICAST_DURATION;
+	int max_slaves = DEFAULT_UNICAST_MAX_SLAVES;
+	int process_noise = DEFAULT_KALMAN_PROCESS_NOISE;
+	int measurement_noise = DEFAULT_KALMAN_MEASUREMENT_NOISE;
+	bool e2e = false, hybrid = false, ethernet = false, ipv6 = false;
+	bool negotiation = false, fast_lock = true, kernel_pll = false;
+
+	// initialize run-time options to default values
+	memset(&_rtOpts, 0, sizeof(_rtOpts));
+	_rtOpts.announceInterval = DEFAULT_ANNOUNCE_INTERVAL;
+	_rtOpts.clockQuality.clockAccuracy = DEFAULT_CLOCK_ACCURACY;
+	_rtOpts.clockQuality.clockClass = DEFAULT_CLOCK_CLASS;
+	_rtOpts.clockQuality.offsetScaledLogVariance = DEFAULT_CLOCK_VARIANCE;
+	_rtOpts.priority1 = DEFAULT_PRIORITY1;
+	_rtOpts.priority2 = DEFAULT_PRIORITY2;
+	_rtOpts.currentUtcOffset = DEFAULT_UTC_OFFSET;
+	_rtOpts.noAdjust  = NO_ADJUST;  // false
+	_rtOpts.maxAdjust = DEFAULT_CLOCK_ADJUST_LIMIT;
+	_rtOpts.maxStep   = DEFAULT_CLOCK_STEP_LIMIT;
+	_rtOpts.maxDelay  = DEFAULT_DELAY_LIMIT;
+	_rtOpts.displayPackets = FALSE;
+	_rtOpts.s = DEFAULT_DELAY_S;
+	_rtOpts.inboundLatency.nanoseconds = DEFAULT_INBOUND_LATENCY;
+	_rtOpts.outboundLatency.nanoseconds = DEFAULT_OUTBOUND_LATENCY;
+	_rtOpts.logFd = -1;
+	_rtOpts.recordFP = NULL;
+	_rtOpts.useSysLog = FALSE;
+	_rtOpts.ttl = 1;
+
+	_rtOpts.probe = FALSE;
+	_rtOpts.quickPoll = 0;
+
+	if (Args(conf, this, errh)
+	    .read("IFACE", iface)
+	    .read("DOMAIN", domain)
+	    .read("SYNC_INTERVAL", sync_interval)
+	    .read("E2E", e2e)
+	    .read("HYBRID", hybrid)
+	    .read("ETHERNET", ethernet)
+	    .read("IPV6", ipv6)
+	    .read("IPV6_SCOPE", ipv6_scope)
+	    .read("NEGOTIATION", negotiation)
+	    .read("UNICAST_MASTER", unicast_master)
+	    .read("UNICAST_DURATION", unicast_duration)
+	    .read("MAX_SLAVES", max_slaves)
+	    .read("SERVO", servo)
+	    .read("KALMAN_NOISE", AnyArg(), kalman_noise)
+	    .read("FAST_LOCK", fast_lock)
+	    .read("KERNEL_PLL", kernel_pll)
+	    .read("AP", ap)
+	    .read("AI", ai)
+	    .read("MAX_FOREIGN", max_foreign)
+	    .read("LATENCY", AnyArg(), latency)
+	    .read("RX_BATCH", rx_batch)
+	    .read("STATE_FILE", FilenameArg(), state_file)
+	    .complete() < 0)
+		return -1;
+
+	if (iface.length() >= IFACE_NAME_LENGTH)
+		return errh->error("IFACE name too long");
+	memcpy(_rtOpts.ifaceName, iface.data(), iface.length());
+	if (domain < 0 || domain > 255)
+		return errh->error("DOMAIN must be between 0 and 255");
+	// log2 seconds; same range the ptpd -y option accepts
+	if (sync_interval < -7 || sync_interval > 7)
+		return errh->error("SYNC_INTERVAL must be between -7 and 7");
+	if (servo && servoByName(servo.c_str()) < 0)
+		return errh->error("SERVO must be PI, LINREG or KALMAN");
+	if (ap < 1 || ap > 32767 || ai < 1 || ai > 32767)
+		return errh->error("AP and AI must be between 1 and 32767");
+	if (max_foreign < 1 || max_foreign > 32767)
+		return errh->error("MAX_FOREIGN must be between 1 and 32767");
+	if (hybrid && !e2e)
+		return errh->error("HYBRID needs E2E");
+	if (ethernet && ipv6)
+		return errh->error("ETHERNET and IPV6 are mutually exclusive");
+	// grants are asked for by IP address, see netInitEthernet()
+	if (ethernet && negotiation)
+		return errh->error("NEGOTIATION needs UDP, not ETHERNET");
+	if (ipv6_scope < 1 || ipv6_scope > 15)
+		return errh->error("IPV6_SCOPE must be between 1 and 15");
+	if (unicast_master && !negotiation)
+		return errh->error("UNICAST_MASTER needs NEGOTIATION");
+	if (unicast_master.length() >= MAXHOSTNAMELEN)
+		return errh->error("UNICAST_MASTER name too long");
+	// spec 16.1.4.1.3 recommends 10-1000 seconds
+	if (unicast_duration < 10 || unicast_duration > 1000)
+		return errh->error("UNICAST_DURATION must be between 10 and 1000");
+	if (max_slaves < 1 || max_slaves > 65535)
+		return errh->error("MAX_SLAVES must be between 1 and 65535");
+	if (state_file.length() >= PATH_MAX - 4)
+		return errh->error("STATE_FILE name too long");
+	if (rx_batch < 1 || rx_batch > NET_MAX_BATCH)
+		return errh->error("RX_BATCH must be between 1 and %d", NET_MAX_BATCH);
+
+	// LATENCY "INBOUND [OUTBOUND]", both in nanoseconds
+	if (latency) {
+		int in = 0, out = 0;
+		if (Args(cp_spacevec(latency), this, errh)
+		    .read_mp("INBOUND", in)
+		    .read_p("OUTBOUND", out)
+		    .complete() < 0)
+			return -1;
+		if (in < 0 || in >= 1000000000 || out < 0 || out >= 1000000000)
+			return errh->error("LATENCY values must be below one second");
+		_rtOpts.inboundLatency.nanoseconds = in;
+		_rtOpts.outboundLatency.nanoseconds = out;
+	}
+
+	// KALMAN_NOISE "PROCESS [MEASUREMENT]", ppb/sqrt(s) and ns
+	if (kalman_noise) {
+		if (Args(cp_spacevec(kalman_noise), this, errh)
+		    .read_mp("PROCESS", process_noise)
+		    .read_p("MEASUREMENT", measurement_noise)
+		    .complete() < 0)
+			return -1;
+		if (process_noise < 1 || process_noise > 100000 ||
+		    measurement_noise < 0 || measurement_noise >= 1000000000)
+			return errh->error("KALMAN_NOISE out of range");
+	}
+
+	_rtOpts.domainNumber = domain;
+	_rtOpts.syncInterval = sync_interval;
+	_rtOpts.E2E_mode = e2e;
+	_rtOpts.hybrid_mode = hybrid;
+	_rtOpts.unicastNegotiation = negotiation;
+	memcpy(_rtOpts.unicastAddress, unicast_master.data(),
+	       unicast_master.length());
+	_rtOpts.unicastDuration = unicast_duration;
+	_rtOpts.unicastMaxSlaves = max_slaves;
+	_rtOpts.ethernet_mode = ethernet;
+	_rtOpts.ipv6_mode = ipv6;
+	_rtOpts.ipv6Scope = ipv6_scope;
+	_rtOpts.servo = servo ? servoByName(servo.c_str()) : SERVO_PI;
+	_rtOpts.fastLock = fast_lock;
+	_rtOpts.kernelPll = kernel_pll;
+	_rtOpts.kalmanProcessNoise = process_noise;
+	_rtOpts.kalmanMeasurementNoise = measurement_noise;
+	_rtOpts.ap = ap;
+	_rtOpts.ai = ai;
+	_rtOpts.max_foreign_records = max_foreign;
+	_rtOpts.rxBatch = rx_batch;
+	memcpy(_rtOpts.stateFile, state_file.data(), state_file.length());
+	return 0;
+}
+
 int
 PTPd2PackageElement::initialize(ErrorHandler *errh)
 {
-	printf("Successfully linked with PTPd2 package!");
-    	printf("KENN !!!");
-    	printf("PTPd2 !!!");
-	
-	RunTimeOpts rtOpts;
-	PtpClock *ptpClock;
 	Integer16 ret;	
-	int argc;
-	char **argv;	
 
-	// initialize run-time options to default values
-	memset(&rtOpts, 0, sizeof(rtOpts));
-	rtOpts.announceInterval = DEFAULT_ANNOUNCE_INTERVAL;
-	rtOpts.syncInterval = DEFAULT_SYNC_INTERVAL;
-	rtOpts.clockQuality.clockAccuracy = DEFAULT_CLOCK_ACCURACY;
-	rtOpts.clockQuality.clockClass = DEFAULT_CLOCK_CLASS;
-	rtOpts.clockQuality.offsetScaledLogVariance = DEFAULT_CLOCK_VARIANCE;
-	rtOpts.priority1 = DEFAULT_PRIORITY1;
-	rtOpts.priority2 = DEFAULT_PRIORITY2;
-	rtOpts.domainNumber = DEFAULT_DOMAIN_NUMBER;
-	rtOpts.currentUtcOffset = DEFAULT_UTC_OFFSET;
-	rtOpts.noAdjust  = NO_ADJUST;  // false
-	rtOpts.maxAdjust = DEFAULT_CLOCK_ADJUST_LIMIT;
-	rtOpts.maxStep   = DEFAULT_CLOCK_STEP_LIMIT;
-	rtOpts.maxDelay  = DEFAULT_DELAY_LIMIT;
-	rtOpts.displayPackets = FALSE;
-	rtOpts.ap = DEFAULT_AP;
-	rtOpts.ai = DEFAULT_AI;
-	rtOpts.s = DEFAULT_DELAY_S;
-	rtOpts.inboundLatency.nanoseconds = DEFAULT_INBOUND_LATENCY;
-	rtOpts.outboundLatency.nanoseconds = DEFAULT_OUTBOUND_LATENCY;
-	rtOpts.max_foreign_records = DEFAULT_MAX_FOREIGN_RECORDS;
-	rtOpts.logFd = -1;
-	rtOpts.recordFP = NULL;
-	rtOpts.useSysLog = FALSE;
-	rtOpts.ttl = 1;
-
-	rtOpts.probe = FALSE;
-	rtOpts.quickPoll = 0;
-
-	// Initialize run time options with command line arguments
-	if (!(ptpClock = ptpdStartup(argc, argv, &ret, &rtOpts)))
-		return ret;
+	if (ninputs() != noutputs() / 2 || noutputs() % 2)
+		return errh->error("connect either no ports, or 1 input and 2 outputs");
+
+	// options come from configure(), so there is no command line
+	if (!(_ptpClock = ptpdStartup(0, 0, &ret, &_rtOpts)))
+		return errh->error("failed to allocate protocol engine data");
+	if (ninputs())
+		_ptpClock->netPath.element = this;
 
        	NOTIFY("ptpd %s started\n", VERSION_STRING);
-	// do the protocol engine
-	protocol(&rtOpts, ptpClock);
-	// forever loop..
-	
-        ptpdShutdown();
-	NOTIFY("self shutdown, probably due to an error\n");
-	
+	// bring up the protocol engine; it then runs from run_task()
+	if (!protocolInit(&_rtOpts, _ptpClock))
+		return errh->error("failed to initialize the protocol engine");
+
+	update_select();
+	ScheduleInfo::initialize_task(this, &_task, errh);
+	_timer.initialize(this);
+	update_timer();
 	return 0;
+}
+
+void
+PTPd2PackageElement::cleanup(CleanupStage)
+{
+	while (Packet *p = _loop_head) {
+		_loop_head = p->next();
+		p->kill();
+	}
+	if (_epollFd >= 0) {
+		remove_select(_epollFd, SELECT_READ);
+		_epollFd = -1;
+	}
+	if (_ptpClock) {
+		ptpdShutdown(_ptpClock, &_rtOpts);
+		_ptpClock = 0;
+	}
+}
+
+enum {
+	h_offset_from_master, h_mean_path_delay, h_observed_drift,
+	h_port_state, h_parent_identity, h_grandmaster_identity, h_counters,
+	h_servo, h_uncertainty, h_convergence_time, h_ap, h_ai, h_max_step, h_sync_interval, h_announce_interval
+};
+
+String
+PTPd2PackageElement::read_handler(Element *e, void *thunk)
+{
+	PTPd2PackageElement *pe = static_cast<PTPd2PackageElement *>(e);
+	PtpClock *ptpClock = pe->_ptpClock;
+	char buf[64];
+
+	switch (reinterpret_cast<intptr_t>(thunk)) {
+	case h_offset_from_master:
+		snprint_TimeNs(buf, sizeof(buf), ptpClock->offsetFromMaster);
+		return String(buf);
+	case h_mean_path_delay:
+		snprint_TimeNs(buf, sizeof(buf), ptpClock->meanPathDelay);
+		return String(buf);
+	case h_observed_drift:
+		return String(ptpClock->observed_drift);
+	case h_port_state:
+		return String(translatePortState(ptpClock));
+	case h_parent_identity:
+		snprint_PortIdentity(buf, sizeof(buf),
+				     &ptpClock->parentPortIdentity, NULL);
+		return String(buf);
+	case h_grandmaster_identity:
+		snprint_ClockIdentity(buf, sizeof(buf),
+				      ptpClock->grandmasterIdentity, NULL);
+		return String(buf);
+	case h_counters: {
+		static const struct { int type; const char *name; } types[] = {
+			{ ANNOUNCE, "announce" }, { SYNC, "sync" },
+			{ FOLLOW_UP, "follow_up" }, { DELAY_REQ, "delay_req" },
+			{ DELAY_RESP, "delay_resp" }, { PDELAY_REQ, "pdelay_req" },
+			{ PDELAY_RESP, "pdelay_resp" },
+			{ PDELAY_RESP_FOLLOW_UP, "pdelay_resp_follow_up" },
+			{ MANAGEMENT, "management" }, { SIGNALING, "signaling" }
+		};
+		StringAccum sa;
+		// one line per message type: name, received, sent
+		for (unsigned i = 0; i < sizeof(types) / sizeof(types[0]); i++)
+			sa << types[i].name << ' '
+			   << ptpClock->rxMessages[types[i].type] << ' '
+			   << ptpClock->txMessages[types[i].type] << '\n';
+		return sa.take_string();
+	}
+	case h_servo:
+		return String(servoName(&pe->_rtOpts));
+	case h_uncertainty: {
+		double phase, freq;
+		if (!servoUncertainty(&pe->_rtOpts, ptpClock, &phase, &freq))
+			return String();
+		snprintf(buf, sizeof(buf), "%.1f %.3f", phase, freq);
+		return String(buf);
+	}
+	case h_convergence_time: {
+		double seconds;
+		if (!servoConvergenceTime(ptpClock, &seconds))
+			return String();
+		snprintf(buf, sizeof(buf), "%.3f", seconds);
+		return String(buf);
+	}
+	case h_ap:
+		return String(pe->_rtOpts.ap);
+	case h_ai:
+		return String(pe->_rtOpts.ai);
+	case h_max_step:
+		return String(pe->_rtOpts.maxStep);
+	case h_sync_interval:
+		return String((int) pe->_rtOpts.syncInterval);
+	case h_announce_interval:
+		return String((int) pe->_rtOpts.announceInterval);
+	default:
+		return String();
+	}
+}
+
+int
+PTPd2PackageElement::write_handler(const String &str, Element *e,
+				   void *thunk, ErrorHandler *errh)
+{
+	PTPd2PackageElement *pe = static_cast<PTPd2PackageElement *>(e);
+	RunTimeOpts *rtOpts = &pe->_rtOpts;
+	PtpClock *ptpClock = pe->_ptpClock;
+	int v;
+
+	if (!IntArg().parse(cp_uncomment(str), v))
+		return errh->error("expected integer");
+
+	switch (reinterpret_cast<intptr_t>(thunk)) {
+	case h_ap:
+	case h_ai:
+		if (v < 1 || v > 32767)
+			return errh->error("value must be between 1 and 32767");
+		if (reinterpret_cast<intptr_t>(thunk) == h_ap)
+			rtOpts->ap = v;
+		else
+			rtOpts->ai = v;
+		return 0;
+	case h_max_step:
+		if (v < 0)
+			return errh->error("value must not be negative");
+		rtOpts->maxStep = v;
+		return 0;
+	case h_sync_interval:
+		if (v < -7 || v > 7)
+			return errh->error("value must be between -7 and 7");
+		rtOpts->syncInterval = ptpClock->logSyncInterval = v;
+		msgPackTemplates(ptpClock);
+		// a master picks up the new rate at once, not after a re-init
+		if (ptpClock->portState == PTP_MASTER) {
+			timerStart(SYNC_INTERVAL_TIMER,
+				   pow(2, ptpClock->logSyncInterval),
+				   ptpClock->itimer);
+			pe->update_timer();
+		}
+		return 0;
+	case h_announce_interval:
+		if (v < -7 || v > 7)
+			return errh->error("value must be between -7 and 7");
+		rtOpts->announceInterval = ptpClock->logAnnounceInterval = v;
+		msgPackTemplates(ptpClock);
+		if (ptpClock->portState == PTP_MASTER) {
+			timerStart(ANNOUNCE_INTERVAL_TIMER,
+				   pow(2, ptpClock->logAnnounceInterval),
+				   ptpClock->itimer);
+			pe->update_timer();
+		}
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
 
+void
+PTPd2PackageElement::add_handlers()
+{
+	add_read_handler("offset_from_master", read_handler, h_offset_from_master);
+	add_read_handler("mean_path_delay", read_handler, h_mean_path_delay);
+	add_read_handler("observed_drift", read_handler, h_observed_drift);
+	add_read_handler("port_state", read_handler, h_port_state);
+	add_read_handler("parent_identity", read_handler, h_parent_identity);
+	add_read_handler("grandmaster_identity", read_handler, h_grandmaster_identity);
+	add_read_handler("counters", read_handler, h_counters);
+	add_read_handler("servo", read_handler, h_servo);
+	add_read_handler("uncertainty", read_handler, h_uncertainty);
+	add_read_handler("convergence_time", read_handler, h_convergence_time);
+	add_read_handler("ap", read_handler, h_ap);
+	add_write_handler("ap", write_handler, h_ap);
+	add_read_handler("ai", read_handler, h_ai);
+	add_write_handler("ai", write_handler, h_ai);
+	add_read_handler("max_step", read_handler, h_max_step);
+	add_write_handler("max_step", write_handler, h_max_step);
+	add_read_handler("sync_interval", read_handler, h_sync_interval);
+	add_write_handler("sync_interval", write_handler, h_sync_interval);
+	add_read_handler("announce_interval", read_handler, h_announce_interval);
+	add_write_handler("announce_interval", write_handler, h_announce_interval);
+}
+
+/* netInit() opens a fresh epoll instance each time the engine
+   re-initializes (e.g. after PTP_FAULTY), so keep the driver's select
+   set in step. the epoll fd covers the sockets and the deadline timer */
+void
+PTPd2PackageElement::update_select()
+{
+	NetPath *netPath = &_ptpClock->netPath;
+
+	if (_epollFd != netPath->epollFd) {
+		if (_epollFd >= 0)
+			remove_select(_epollFd, SELECT_READ);
+		_epollFd = netPath->epollFd;
+		if (_epollFd >= 0)
+			add_select(_epollFd, SELECT_READ);
+	}
+}
+
+bool
+PTPd2PackageElement::run_task(Task *)
+{
+	while (Packet *p = _loop_head) {
+		_loop_head = p->next();
+		p->set_next(0);
+		recv_packet(p);
+	}
+
+	bool activity = protocolStep(&_rtOpts, _ptpClock);
+
+	update_select();
+	update_timer();
+	// drain pending messages before going back to sleep
+	if (activity)
+		_task.fast_reschedule();
+	return activity;
+}
+
+void
+PTPd2PackageElement::run_timer(Timer *)
+{
+	// retry a failed re-initialization
+	_task.reschedule();
+}
+
+/* arm the engine's timerfd for the earliest protocol timer deadline.
+   without an epoll instance (netInit() failed) there is nothing to
+   wake us, so fall back to retrying from the Click Timer */
+void
+PTPd2PackageElement::update_timer()
+{
+	NetPath *netPath = &_ptpClock->netPath;
+	TimeInternal delay;
+
+	if (netPath->timerFd < 0) {
+		if (!_timer.scheduled())
+			_timer.schedule_after_sec(1);
+		return;
+	}
+	_timer.unschedule();
+	if (protocolNext(&_rtOpts, _ptpClock, &delay))
+		netArmTimer(&delay, netPath);
+	else
+		netArmTimer(NULL, netPath);
+}
+
+void
+PTPd2PackageElement::selected(int, int)
+{
+	_task.reschedule();
+}
+
+void
+PTPd2PackageElement::recv_packet(Packet *p)
+{
+	TimeInternal time;
+	NetAddress from;
+	const unsigned char *data = p->data();
+	uint32_t length = p->length();
+
+	from.len = 0;
+	/* on Ethernet the frames come with their header */
+	if (_rtOpts.ethernet_mode) {
+		const click_ether *ethh = reinterpret_cast<const click_ether *>(data);
+		if (length < sizeof(click_ether)
+		    || ethh->ether_type != htons(PTP_ETHER_TYPE)) {
+			DBG("not a PTP frame\n");
+			p->kill();
+			return;
+		}
+		netEtherAddress(&from, ethh->ether_shost, 0);
+		data += sizeof(click_ether);
+		length -= sizeof(click_ether);
+	} else if (p->has_network_header()) {
+		/* the sender, for replies in hybrid mode */
+		const unsigned char *nh = p->network_header();
+		if ((nh[0] >> 4) == 4)
+			netInetAddress(&from, p->ip_header()->ip_src.s_addr);
+		else if ((nh[0] >> 4) == 6)
+			netInet6Address(&from, reinterpret_cast<const struct in6_addr *>(nh + 8), 0);
+	}
+
+	/* same policy as the sockets: no time stamp, no message */
+	if (p->timestamp_anno()) {
+		time.seconds = p->timestamp_anno().sec();
+		time.nanoseconds = p->timestamp_anno().nsec();
+		protocolRecv((Octet *) data, length, &time,
+			     from.len ? &from : 0, &_rtOpts, _ptpClock);
+	} else
+		DBG("no receive time stamp\n");
+	p->kill();
+}
+
+void
+PTPd2PackageElement::push(int, Packet *p)
+{
+	recv_packet(p);
+	_task.reschedule();
+}
+
+/* called by netSend() in packet mode */
+void
+PTPd2PackageElement::send_packet(int port, WritablePacket *p)
+{
+	/* there is no multicast loopback on an output port, so loop event
+	   messages back with the time they are handed to the graph; the
+	   engine takes its Sync/DelayReq/PDelay send times from them.
+	   they are handled from run_task(), after the issuing code is done */
+	if (port == 0)
+		if (Packet *q = p->clone()) {
+			q->set_timestamp_anno(Timestamp::now());
+			q->set_next(0);
+			if (_loop_head)
+				_loop_tail->set_next(q);
+			else
+				_loop_head = q;
+			_loop_tail = q;
+			_task.reschedule();
+		}
+	output(port).push(p);
 }
 
 CLICK_ENDDECLS
@@ -1,17 +1,138 @@
 #ifndef SocketPACKAGEELEMENT_HH
 #define SocketPACKAGEELEMENT_HH
 #include <click/element.hh>
+#include <click/task.hh>
+#include <click/timer.hh>
+#include "ptpd.hh"
 
 CLICK_DECLS
 
+/*
+ * The PTP engine runs as a Click Task: every run_task() performs one
+ * non-blocking protocolStep(). The engine's epoll descriptor, which
+ * watches its PTP sockets and a timerfd armed for the earliest protocol
+ * timer deadline, is the only fd registered with the driver; the task
+ * wakes when a message arrives or a timer is due, and never otherwise.
+ * The Click Timer is only used to retry a failed re-initialization.
+ *
+ * With no ports connected the engine uses its own UDP sockets. With one
+ * input and two outputs it runs in packet mode instead: input 0 takes
+ * PTP messages (UDP payload, receive time in the timestamp annotation),
+ * output 0 emits event messages (port 319) and output 1 general
+ * messages (port 320), each with the destination IP address annotation
+ * set (the IPv6 one with IPV6), so the configuration does the UDP/IP
+ * encapsulation and I/O.
+ *
+ * With ETHERNET the messages travel in Ethernet frames of type 0x88F7
+ * to 01-1B-19-00-00-00, or 01-80-C2-00-00-0E for the peer delay
+ * messages: on a packet socket, or in packet mode as whole frames on
+ * the ports, e.g. from FromDevice and to ToDevice.
+ *
+ * Keyword arguments (all optional):
+ *   IFACE		interface to run PTP on (default: first suitable)
+ *   DOMAIN		PTP domain number, 0-255
+ *   SYNC_INTERVAL	log2 of the Sync interval in seconds, -7..7
+ *   E2E		bool; end-to-end instead of peer-to-peer delay
+ *   HYBRID		bool; with E2E, send DelayReq uni-cast to the parent
+ *   ETHERNET		bool; Ethernet (layer 2) transport instead of UDP/IPv4
+ *   IPV6		bool; UDP/IPv6 transport instead of UDP/IPv4
+ *   IPV6_SCOPE		scope X of the FF0X::181 group, 1-15 (default 14)
+ *   NEGOTIATION	bool; unicast negotiation instead of multicast
+ *   UNICAST_MASTER	with NEGOTIATION, address of the master to ask
+ *   UNICAST_DURATION	grant duration in s asked for, or the most granted,
+ *			10-1000 (default 300)
+ *   MAX_SLAVES		unicast slaves a master grants at once (default 1024)
+ *   SERVO		clock servo: PI (default), the proportional-integral
+ *			loop, LINREG, a least squares fit of the last 16
+ *			offsets against local time, which settles within a
+ *			few samples and follows frequency with less jitter,
+ *			or KALMAN, a Kalman filter of offset and frequency
+ *   KALMAN_NOISE	"PROCESS [MEASUREMENT]" of the KALMAN servo: frequency
+ *			wander in ppb/sqrt(s) (default 1) and offset noise in
+ *			ns (default 0, learned from the delay variance)
+ *   FAST_LOCK		bool; before the servo runs, estimate the frequency
+ *			error from the first 8 Syncs, correct it at once and
+ *			step the clock once (default true)
+ *   KERNEL_PLL		bool; after the fast lock, pass each offset to the
+ *			kernel PLL (adjtimex ADJ_OFFSET, STA_PLL), which
+ *			slews the clock between Syncs and keeps the
+ *			frequency, instead of running SERVO (default false).
+ *			While it runs, the system clock is in nanosecond
+ *			mode (ADJ_NANO) and marked synchronized (STA_UNSYNC
+ *			cleared); cleanup stops the PLL and puts these
+ *			status bits back as they were
+ *   AP, AI		PI servo proportional and integral attenuation
+ *   MAX_FOREIGN	size of the foreign master record table
+ *   LATENCY		"INBOUND [OUTBOUND]" latency correction in ns
+ *   RX_BATCH		messages received per socket per wakeup (default 8)
+ *   STATE_FILE		file a slave checkpoints its drift, path delay and
+ *			parent to every minute and on cleanup. It is read at
+ *			initialization: the drift is applied at once, and if
+ *			the parent is the same the delay is used and the fast
+ *			lock skipped. Ignored when older than a day
+ *
+ * ETHERNET and IPV6 need IFACE unless the interface has an IPv4 address.
+ * A master answers a uni-cast DelayReq uni-cast. In packet mode it
+ * takes the address from the IP header (network header annotation) or
+ * the Ethernet header.
+ *
+ * With NEGOTIATION a master sends Announce, Sync/FollowUp and DelayResp
+ * only to the slaves that asked for them in Signaling messages (spec
+ * 16.1), each at its granted rate until the grant runs out, and nothing
+ * multicast. A slave with UNICAST_MASTER asks that master for them and
+ * renews the grants half way through. NEGOTIATION runs over UDP/IPv4 or
+ * IPv6 only, not with ETHERNET.
+ *
+ * Read handlers: offset_from_master, mean_path_delay, observed_drift,
+ * port_state, parent_identity, grandmaster_identity, servo, counters (one
+ * "type received sent" line per message type) and uncertainty ("OFFSET
+ * FREQUENCY", the standard deviations in ns and ppb the KALMAN servo
+ * estimates; empty with the others) and convergence_time (seconds from the
+ * start of synchronization until the offset stayed within 10 us for 4
+ * Syncs; empty until then). ap, ai, max_step, sync_interval and
+ * announce_interval can be read and written at run time.
+ */
 class PTPd2PackageElement : public Element { public:
 
     PTPd2PackageElement();		
     ~PTPd2PackageElement();		
 
     const char *class_name() const	{ return "PTPd2PackageElement"; }
+    const char *port_count() const	{ return "0-1/0-2"; }
+    const char *processing() const	{ return PUSH; }
 
+    int configure(Vector<String> &conf, ErrorHandler *errh);
     int initialize(ErrorHandler *errh);
+    void cleanup(CleanupStage stage);
+    void add_handlers();
+
+    bool run_task(Task *task);
+    void run_timer(Timer *timer);
+    void selected(int fd, int mask);
+
+    void push(int port, Packet *p);
+    void send_packet(int port, WritablePacket *p);
+
+  private:
+
+    RunTimeOpts _rtOpts;
+    PtpClock *_ptpClock;
+
+    Task _task;
+    Timer _timer;
+
+    int _epollFd;		// engine fd currently registered with add_select
+
+    Packet *_loop_head;		// event messages looped back in packet mode
+    Packet *_loop_tail;
+
+    static String read_handler(Element *e, void *thunk);
+    static int write_handler(const String &str, Element *e, void *thunk,
+			     ErrorHandler *errh);
+
+    void update_select();
+    void update_timer();
+    void recv_packet(Packet *p);
 
 };
 
@@ -118,12 +118,20 @@ void msgDebugManagement(MsgManagement *manage);
 bool netInit(NetPath*,RunTimeOpts*,PtpClock*);
 bool netShutdown(NetPath*);
 int netSelect(TimeInternal*,NetPath*);
-ssize_t netRecvEvent(Octet*,TimeInternal*,NetPath*);
-ssize_t netRecvGeneral(Octet*,TimeInternal*,NetPath*);
+bool netArmTimer(TimeInternal*,NetPath*);
+bool netSetFilter(NetPath*,RunTimeOpts*,PtpClock*);
+int netRecvBatch(Integer32,NetPath*,int);
+int netRecvTxTimestamp(NetPath*,TimeInternal*,UInteger8*,UInteger16*);
 ssize_t netSendEvent(Octet*,UInteger16,NetPath*);
 ssize_t netSendGeneral(Octet*,UInteger16,NetPath*);
 ssize_t netSendPeerGeneral(Octet*,UInteger16,NetPath*);
 ssize_t netSendPeerEvent(Octet*,UInteger16,NetPath*);
+ssize_t netSendEventTo(Octet*,UInteger16,NetPath*,const NetAddress*);
+ssize_t netSendGeneralTo(Octet*,UInteger16,NetPath*,const NetAddress*);
+void netInetAddress(NetAddress*,in_addr_t);
+void netInet6Address(NetAddress*,const struct in6_addr*,int);
+void netEtherAddress(NetAddress*,const UInteger8*,int);
+bool netFlush(NetPath*);
 
 
 
@@ -131,20 +139,27 @@ ssize_t netSendPeerEvent(Octet*,UInteger16,NetPath*);
 /** \name servo.c
  * -Clock servo*/
 void initClock(RunTimeOpts*,PtpClock*);
-void updatePeerDelay (one_way_delay_filter*, RunTimeOpts*,PtpClock*,TimeInternal*,bool);
-void updateDelay (one_way_delay_filter*, RunTimeOpts*, PtpClock*,TimeInternal*);
-void updateOffset(TimeInternal*,TimeInternal*,
-  offset_from_master_filter*,RunTimeOpts*,PtpClock*,TimeInternal*);
+void updatePeerDelay (one_way_delay_filter*, RunTimeOpts*,PtpClock*,TimeNs,bool);
+void updateDelay (one_way_delay_filter*, RunTimeOpts*, PtpClock*,TimeNs);
+void updateOffset(TimeNs,TimeNs,
+  offset_from_master_filter*,RunTimeOpts*,PtpClock*,TimeNs);
 void updateClock(RunTimeOpts*,PtpClock*);
+int servoByName(const char*);
+const char *servoName(RunTimeOpts*);
+bool servoUncertainty(RunTimeOpts*,PtpClock*,double*,double*);
+bool servoConvergenceTime(PtpClock*,double*);
 
 
 
 /** \name startup.c (Unix API dependent)
  * -Handle with runtime options*/
-int logToFile(void);
-int recordToFile(void);
+int logToFile(RunTimeOpts*);
+int recordToFile(RunTimeOpts*);
 PtpClock * ptpdStartup(int,char**,Integer16*,RunTimeOpts*);
-void ptpdShutdown(void);
+void ptpdShutdown(PtpClock*,RunTimeOpts*);
+bool stateSave(RunTimeOpts*,PtpClock*);
+bool stateLoad(RunTimeOpts*,PtpClock*);
+void stateWarmStart(RunTimeOpts*,PtpClock*);
 
 
 
@@ -152,21 +167,34 @@ void ptpdShutdown(void);
 /** \name sys.c (Unix API dependent)
  * -Manage timing system API*/
 
+int snprint_TimeInternal(char*,int,const TimeInternal*);
+int snprint_TimeNs(char*,int,TimeNs);
+int snprint_ClockIdentity(char*,int,const ClockIdentity,const char*);
+int snprint_PortIdentity(char*,int,const PortIdentity*,const char*);
+int snprint_NetAddress(char*,int,const NetAddress*);
+const char *translatePortState(PtpClock*);
+void logUseSysLog(void);
 void message(int priority, const char *format, ...);
 void displayStats(RunTimeOpts *rtOpts, PtpClock *ptpClock);
 bool nanoSleep(TimeInternal*);
 void getTime(TimeInternal*);
+void getMonotonicTime(TimeInternal*);
 void setTime(TimeInternal*);
 double getRand(void);
 bool adjFreq(Integer32);
+bool adjOffset(TimeNs,Integer32*);
+bool clearKernelOffset(void);
+bool stopKernelPll(void);
+bool getKernelStatus(Integer32*);
+bool restoreKernelStatus(Integer32);
 
 
 
 
 /** \name timer.c (Unix API dependent)
  * -Handle with timers*/
-void initTimer(void);
 void timerUpdate(IntervalTimer*);
+bool timerNext(IntervalTimer*,TimeInternal*);
 void timerStop(UInteger16,IntervalTimer*);
 //void timerStart(UInteger16,UInteger16,IntervalTimer*);
 void timerStart(UInteger16,float,IntervalTimer*);
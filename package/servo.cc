@@ -9,18 +9,404 @@
 
 #include "ptpd.hh"
 
+/*
+ * A servo turns the offset from master, measured at local time 'time',
+ * into a frequency adjustment: the ppb the clock is to be slowed by, as
+ * given to adjFreq() negated. Limits and steps of the clock are left to
+ * updateClock() and are the same for all of them. reset() is called when
+ * the clock was stepped or a new master is followed. A servo that does
+ * its own filtering takes the offsets without the two sample average
+ * (rawOffset), and one that knows how good its estimate is tells it by
+ * uncertainty(), NULL otherwise.
+ */
+typedef struct {
+	const char *name;
+	bool rawOffset;
+	void (*reset)(RunTimeOpts*,PtpClock*);
+	Integer32 (*sample)(TimeNs,TimeNs,RunTimeOpts*,PtpClock*);
+	bool (*uncertainty)(PtpClock*,double*,double*);
+} Servo;
+
+static void 
+servoPiReset(RunTimeOpts * rtOpts, PtpClock * ptpClock)
+{
+	/* the I term, observed_drift, is kept, see initClock() */
+}
+
+/* the PI controller */
+static Integer32 
+servoPiSample(TimeNs offset, TimeNs time, RunTimeOpts * rtOpts, 
+	      PtpClock * ptpClock)
+{
+	/* no negative or zero attenuation */
+	if (rtOpts->ap < 1)
+		rtOpts->ap = 1;
+	if (rtOpts->ai < 1)
+		rtOpts->ai = 1;
+
+	/* the accumulator for the I component */
+	ptpClock->observed_drift += offset / rtOpts->ai;
+
+	/* clamp the accumulator to ADJ_FREQ_MAX for sanity */
+	if (ptpClock->observed_drift > ADJ_FREQ_MAX)
+		ptpClock->observed_drift = ADJ_FREQ_MAX;
+	else if (ptpClock->observed_drift < -ADJ_FREQ_MAX)
+		ptpClock->observed_drift = -ADJ_FREQ_MAX;
+
+	return offset / rtOpts->ap + ptpClock->observed_drift;
+}
+
+static void 
+servoLinregReset(RunTimeOpts * rtOpts, PtpClock * ptpClock)
+{
+	linreg_servo *lr = &ptpClock->linreg;
+
+	lr->count = lr->next = 0;
+	lr->correction = 0;
+}
+
+/*
+ * least squares fit of the last SERVO_LINREG_WINDOW samples. The slope,
+ * kept in observed_drift, is followed at once, and the offset the fit
+ * gives for now is taken off over one sample interval
+ */
+static Integer32 
+servoLinregSample(TimeNs offset, TimeNs time, RunTimeOpts * rtOpts, 
+		  PtpClock * ptpClock)
+{
+	linreg_servo *lr = &ptpClock->linreg;
+	double mx = 0, my = 0, sxx = 0, sxy = 0, dx, slope, phase, interval;
+	Integer32 i, oldest;
+
+	/* what the adjustment in force since the last sample took off */
+	if (lr->count)
+		lr->correction += (double)ptpClock->adjustment * 
+			(time - lr->lastTime) / 1000000000;
+	lr->lastTime = time;
+
+	lr->time[lr->next] = time;
+	lr->offset[lr->next] = offset + lr->correction;
+	lr->next = (lr->next + 1) % SERVO_LINREG_WINDOW;
+	if (lr->count < SERVO_LINREG_WINDOW)
+		++lr->count;
+
+	/* (x, y) relative to the newest sample, x in ns */
+	for (i = 0; i < lr->count; i++) {
+		mx += lr->time[i] - time;
+		my += lr->offset[i];
+	}
+	mx /= lr->count;
+	my /= lr->count;
+	for (i = 0; i < lr->count; i++) {
+		dx = lr->time[i] - time - mx;
+		sxx += dx * dx;
+		sxy += dx * (lr->offset[i] - my);
+	}
+	if (sxx <= 0) {
+		/* a single sample, keep the frequency we have */
+		return ptpClock->observed_drift;
+	}
+	slope = sxy / sxx;
+	phase = my - slope * mx - lr->correction;
+
+	ptpClock->observed_drift = slope * 1000000000;
+	if (ptpClock->observed_drift > ADJ_FREQ_MAX)
+		ptpClock->observed_drift = ADJ_FREQ_MAX;
+	else if (ptpClock->observed_drift < -ADJ_FREQ_MAX)
+		ptpClock->observed_drift = -ADJ_FREQ_MAX;
+
+	/* the mean spacing of the samples */
+	oldest = lr->count < SERVO_LINREG_WINDOW ? 0 : lr->next;
+	interval = (double)(time - lr->time[oldest]) / (lr->count - 1);
+
+	DBGV("linreg servo slope %.3f ppb, phase %.1f ns, %d samples\n",
+	     slope * 1000000000, phase, lr->count);
+
+	phase = phase * 1000000000 / interval;
+	if (phase > ADJ_FREQ_MAX)
+		phase = ADJ_FREQ_MAX;
+	else if (phase < -ADJ_FREQ_MAX)
+		phase = -ADJ_FREQ_MAX;
+	return ptpClock->observed_drift + (Integer32)phase;
+}
+
+static void 
+servoKalmanReset(RunTimeOpts * rtOpts, PtpClock * ptpClock)
+{
+	ptpClock->kalman.count = 0;
+}
+
+/*
+ * Kalman filter of offset and frequency. Between samples the offset
+ * moves by the frequency error less the adjustment in force, and the
+ * frequency wanders by kalmanProcessNoise per sqrt(s). The estimated
+ * frequency is followed, and the estimated offset taken off over the
+ * last sample interval
+ */
+static Integer32 
+servoKalmanSample(TimeNs offset, TimeNs time, RunTimeOpts * rtOpts, 
+		  PtpClock * ptpClock)
+{
+	kalman_servo *k = &ptpClock->kalman;
+	double dt, q, r, s, k0, k1, y, d, w, p01;
+
+	if (!k->count) {
+		/* nothing to go by but the adjustment in force */
+		k->phase = offset;
+		k->freq = ptpClock->adjustment;
+		k->p00 = rtOpts->kalmanMeasurementNoise ?
+			(double)rtOpts->kalmanMeasurementNoise * 
+			rtOpts->kalmanMeasurementNoise : 
+			(double)offset * offset;
+		k->p01 = 0;
+		k->p11 = (double)ADJ_FREQ_MAX * ADJ_FREQ_MAX;
+		k->delayMean = ptpClock->master_to_slave_delay - offset;
+		k->delayVar = 0;
+		k->count = 1;
+		k->lastTime = time;
+		return ptpClock->adjustment;
+	}
+	dt = (double)(time - k->lastTime) / 1000000000;
+	if (dt <= 0)
+		return ptpClock->adjustment;
+	k->lastTime = time;
+
+	/* predict */
+	q = (double)rtOpts->kalmanProcessNoise * rtOpts->kalmanProcessNoise;
+	k->phase += (k->freq - ptpClock->adjustment) * dt;
+	k->p00 += dt * (2 * k->p01 + dt * k->p11) + q * dt * dt * dt / 3;
+	k->p01 += dt * k->p11 + q * dt * dt / 2;
+	k->p11 += q * dt;
+
+	/* 
+	 * the measurement noise: the variance of the master to slave delay,
+	 * as far as the offset is known, averaged over about 16 samples
+	 */
+	if (k->count < 16)
+		++k->count;
+	w = 1.0 / k->count;
+	d = ptpClock->master_to_slave_delay - k->phase - k->delayMean;
+	k->delayMean += w * d;
+	k->delayVar = (1 - w) * (k->delayVar + w * d * d);
+	if (rtOpts->kalmanMeasurementNoise)
+		r = (double)rtOpts->kalmanMeasurementNoise * 
+			rtOpts->kalmanMeasurementNoise;
+	else
+		r = k->delayVar > 1 ? k->delayVar : 1;
+
+	/* update */
+	y = offset - k->phase;
+	s = k->p00 + r;
+	k0 = k->p00 / s;
+	k1 = k->p01 / s;
+	k->phase += k0 * y;
+	k->freq += k1 * y;
+	p01 = k->p01;
+	k->p00 -= k0 * k->p00;
+	k->p01 -= k0 * p01;
+	k->p11 -= k1 * p01;
+
+	DBGV("kalman servo offset %.1f +- %.1f ns, frequency %.3f +- %.3f ppb, "
+	     "noise %.1f ns\n", k->phase, sqrt(k->p00), k->freq, sqrt(k->p11),
+	     sqrt(r));
+
+	if (k->freq > ADJ_FREQ_MAX)
+		k->freq = ADJ_FREQ_MAX;
+	else if (k->freq < -ADJ_FREQ_MAX)
+		k->freq = -ADJ_FREQ_MAX;
+	ptpClock->observed_drift = k->freq;
+	return k->freq + k->phase / dt;
+}
+
+static bool 
+servoKalmanUncertainty(PtpClock * ptpClock, double *phase, double *freq)
+{
+	kalman_servo *k = &ptpClock->kalman;
+
+	if (k->count < 2)
+		return FALSE;
+	*phase = sqrt(k->p00);
+	*freq = sqrt(k->p11);
+	return TRUE;
+}
+
+static const Servo servos[SERVO_TYPES] = {
+	{ "PI", FALSE, servoPiReset, servoPiSample, NULL },
+	{ "LINREG", FALSE, servoLinregReset, servoLinregSample, NULL },
+	{ "KALMAN", TRUE, servoKalmanReset, servoKalmanSample,
+	  servoKalmanUncertainty }
+};
+
+/* SERVO_PI, SERVO_LINREG, ... by name, -1 if there is none */
+int 
+servoByName(const char *name)
+{
+	int i;
+
+	for (i = 0; i < SERVO_TYPES; i++)
+		if (!strcasecmp(servos[i].name, name))
+			return i;
+	return -1;
+}
+
+const char * 
+servoName(RunTimeOpts * rtOpts)
+{
+	return servos[rtOpts->servo].name;
+}
+
+/* 
+ * standard deviation of the servo's offset (ns) and frequency (ppb)
+ * estimates, FALSE if it has none (yet)
+ */
+bool 
+servoUncertainty(RunTimeOpts * rtOpts, PtpClock * ptpClock, 
+		 double *phase, double *freq)
+{
+	const Servo *servo = &servos[rtOpts->servo];
+
+	if (rtOpts->kernelPll)
+		return FALSE;
+	return servo->uncertainty && servo->uncertainty(ptpClock, phase, freq);
+}
+
+/*
+ * the fast initial lock: the frequency is held for FAST_LOCK_SAMPLES
+ * Syncs (more in case the path delay is not known yet), then corrected
+ * by the slope of their master to slave delays, and the clock stepped
+ * once by the offset the fit gives for the last of them
+ */
+static void 
+servoStartup(RunTimeOpts * rtOpts, PtpClock * ptpClock)
+{
+	servo_startup *st = &ptpClock->startup;
+	double mx = 0, my = 0, sxx = 0, sxy = 0, dx, slope, phase;
+	TimeNs now = ptpClock->sync_receive_time;
+	TimeNs delay;
+	TimeInternal timeTmp;
+	Integer32 i, n, adj;
+
+	i = st->count++ % FAST_LOCK_SAMPLES;
+	st->time[i] = now;
+	st->delay[i] = ptpClock->master_to_slave_delay;
+	if (st->count < FAST_LOCK_SAMPLES)
+		return;
+
+	/* the offset needs the path delay, so wait a while for it */
+	delay = rtOpts->E2E_mode ? 
+		ptpClock->meanPathDelay : ptpClock->peerMeanPathDelay;
+	if (!delay && st->count < 4 * FAST_LOCK_SAMPLES)
+		return;
+
+	/* (x, y) relative to the last Sync, x in ns */
+	n = FAST_LOCK_SAMPLES;
+	for (i = 0; i < n; i++) {
+		mx += st->time[i] - now;
+		my += st->delay[i];
+	}
+	mx /= n;
+	my /= n;
+	for (i = 0; i < n; i++) {
+		dx = st->time[i] - now - mx;
+		sxx += dx * dx;
+		sxy += dx * (st->delay[i] - my);
+	}
+	if (sxx <= 0) {
+		st->count = 0;
+		return;
+	}
+	slope = sxy / sxx;
+	phase = my - slope * mx - delay;
+
+	adj = ptpClock->adjustment + slope * 1000000000;
+	if (adj > ADJ_FREQ_MAX)
+		adj = ADJ_FREQ_MAX;
+	else if (adj < -ADJ_FREQ_MAX)
+		adj = -ADJ_FREQ_MAX;
+	ptpClock->observed_drift = adj;
+
+	INFO("frequency error estimated at %d ppb, offset %.0f ns\n", 
+	     adj, phase);
+	if (!rtOpts->noAdjust) {
+		adjFreq(-adj);
+		ptpClock->adjustment = adj;
+		/* as with maxStep, 0 means never step */
+		if (rtOpts->maxStep) {
+			if (rtOpts->kernelPll)
+				clearKernelOffset();
+			getTime(&timeTmp);
+			nsToInternalTime(internalTimeToNs(&timeTmp) - 
+					 (TimeNs)phase, &timeTmp);
+			setTime(&timeTmp);
+			ptpClock->ofm_filt.nsec_prev = 0;
+		}
+	}
+
+	/* hand over to the servo */
+	servos[rtOpts->servo].reset(rtOpts, ptpClock);
+	st->locked = TRUE;
+}
+
+/* time until the offset stays within CONVERGED_OFFSET */
+static void 
+servoConvergence(PtpClock * ptpClock)
+{
+	servo_startup *st = &ptpClock->startup;
+	TimeInternal now;
+
+	if (st->convergence)
+		return;
+	if (!st->locked || 
+	    llabs(ptpClock->offsetFromMaster) >= CONVERGED_OFFSET) {
+		st->converged = 0;
+		return;
+	}
+	if (++st->converged < CONVERGED_SAMPLES)
+		return;
+
+	getMonotonicTime(&now);
+	st->convergence = internalTimeToNs(&now) - st->start;
+	NOTIFY("clock converged in %.3f seconds\n", 
+	       (double)st->convergence / 1000000000);
+}
+
+/* 
+ * seconds from initClock() until the offset stayed within
+ * CONVERGED_OFFSET, FALSE until it has
+ */
+bool 
+servoConvergenceTime(PtpClock * ptpClock, double *seconds)
+{
+	if (!ptpClock->startup.convergence)
+		return FALSE;
+	*seconds = (double)ptpClock->startup.convergence / 1000000000;
+	return TRUE;
+}
+
 void 
 initClock(RunTimeOpts * rtOpts, PtpClock * ptpClock)
 {
+	TimeInternal now;
+
 	DBG("initClock\n");
 	/* clear vars */
-	ptpClock->master_to_slave_delay.seconds = 
-		ptpClock->master_to_slave_delay.nanoseconds = 0;
-	ptpClock->slave_to_master_delay.seconds = 
-		ptpClock->slave_to_master_delay.nanoseconds = 0;
+	ptpClock->master_to_slave_delay = 0;
+	ptpClock->slave_to_master_delay = 0;
 	// Removed reset of observed drift so will eventually calibrate even if way off initially
 	//ptpClock->observed_drift = 0;	/* clears clock servo accumulator (the I term) */
 	ptpClock->owd_filt.s_exp = 0;	/* clears one-way delay filter */
+	servos[rtOpts->servo].reset(rtOpts, ptpClock);
+
+	/* estimate the frequency first, see servoStartup() */
+	ptpClock->startup.locked = !rtOpts->fastLock;
+	ptpClock->startup.count = 0;
+	ptpClock->startup.converged = 0;
+	/* a step on the way there doesn't restart the convergence time */
+	if (!ptpClock->startup.start || ptpClock->startup.convergence) {
+		getMonotonicTime(&now);
+		ptpClock->startup.start = internalTimeToNs(&now);
+		ptpClock->startup.convergence = 0;
+	}
 
 	/* level clock */
 	if (!rtOpts->noAdjust) {
@@ -29,33 +415,34 @@ initClock(RunTimeOpts * rtOpts, PtpClock * ptpClock)
 		 * This dramatically decreases the time it takes the drift to pull in and
 		 * for the clock to stabilize when the master changes */
 		adjFreq(-ptpClock->observed_drift);
+		ptpClock->adjustment = ptpClock->observed_drift;
 	}
 }
 
 void 
-updateDelay(one_way_delay_filter * owd_filt, RunTimeOpts * rtOpts, PtpClock * ptpClock, TimeInternal * correctionField)
+updateDelay(one_way_delay_filter * owd_filt, RunTimeOpts * rtOpts, PtpClock * ptpClock, TimeNs correctionField)
 {
 
-	TimeInternal slave_to_master_delay;
+	TimeNs slave_to_master_delay;
 
 	DBGV("updateDelay\n");
 
 	/* calc 'slave_to_master_delay' */
-	subTime(&slave_to_master_delay, &ptpClock->delay_req_receive_time, 
-		&ptpClock->delay_req_send_time);
+	slave_to_master_delay = ptpClock->delay_req_receive_time - 
+		ptpClock->delay_req_send_time;
 
 	if (rtOpts->maxDelay) { /* If maxDelay is 0 then it's OFF */
-		if (slave_to_master_delay.seconds && rtOpts->maxDelay) {
+		if (llabs(slave_to_master_delay) >= 1000000000) {
 			INFO("updateDelay aborted, delay greater than 1"
 			     " second.");
 			msgDump(ptpClock);
 			return;
 		}
 
-		if (slave_to_master_delay.nanoseconds > rtOpts->maxDelay) {
-			INFO("updateDelay aborted, delay %d greater than "
+		if (slave_to_master_delay > rtOpts->maxDelay) {
+			INFO("updateDelay aborted, delay %lld greater than "
 			     "administratively set maximum %d\n",
-			     slave_to_master_delay.nanoseconds, 
+			     (long long)slave_to_master_delay, 
 			     rtOpts->maxDelay);
 			msgDump(ptpClock);
 			return;
@@ -69,21 +456,16 @@ updateDelay(one_way_delay_filter * owd_filt, RunTimeOpts * rtOpts, PtpClock * pt
 		 * calc 'slave_to_master_delay' (Master to Slave delay is
 		 * already computed in updateOffset )
 		 */
-		subTime(&ptpClock->delaySM, &ptpClock->delay_req_receive_time, 
-			&ptpClock->delay_req_send_time);
-
-		/* update 'one_way_delay' */
-		addTime(&ptpClock->meanPathDelay, &ptpClock->delaySM, 
-			&ptpClock->delayMS);
+		ptpClock->delaySM = slave_to_master_delay;
 
-		/* Substract correctionField */
-		subTime(&ptpClock->meanPathDelay, &ptpClock->meanPathDelay, 
-			correctionField);
+		/* update 'one_way_delay', substracting the correctionField */
+		ptpClock->meanPathDelay = ptpClock->delaySM + 
+			ptpClock->delayMS - correctionField;
 
 		/* Compute one-way delay */
-		divTime(&ptpClock->meanPathDelay, 2);
+		ptpClock->meanPathDelay /= 2;
 
-		if (ptpClock->meanPathDelay.seconds) {
+		if (llabs(ptpClock->meanPathDelay) >= 1000000000) {
 			/* cannot filter with secs, clear filter */
 			owd_filt->s_exp = owd_filt->nsec_prev = 0;
 			return;
@@ -104,11 +486,11 @@ updateDelay(one_way_delay_filter * owd_filt, RunTimeOpts * rtOpts, PtpClock * pt
 		/* filter 'meanPathDelay' */
 		owd_filt->y = (owd_filt->s_exp - 1) * 
 			owd_filt->y / owd_filt->s_exp +
-			(ptpClock->meanPathDelay.nanoseconds / 2 + 
+			(ptpClock->meanPathDelay / 2 + 
 			 owd_filt->nsec_prev / 2) / owd_filt->s_exp;
 
-		owd_filt->nsec_prev = ptpClock->meanPathDelay.nanoseconds;
-		ptpClock->meanPathDelay.nanoseconds = owd_filt->y;
+		owd_filt->nsec_prev = ptpClock->meanPathDelay;
+		ptpClock->meanPathDelay = owd_filt->y;
 
 		DBGV("delay filter %d, %d\n", owd_filt->y, owd_filt->s_exp);
 	}
@@ -116,7 +498,7 @@ updateDelay(one_way_delay_filter * owd_filt, RunTimeOpts * rtOpts, PtpClock * pt
 
 
 void 
-updatePeerDelay(one_way_delay_filter * owd_filt, RunTimeOpts * rtOpts, PtpClock * ptpClock, TimeInternal * correctionField, bool twoStep)
+updatePeerDelay(one_way_delay_filter * owd_filt, RunTimeOpts * rtOpts, PtpClock * ptpClock, TimeNs correctionField, bool twoStep)
 {
 	Integer16 s;
 
@@ -124,42 +506,26 @@ updatePeerDelay(one_way_delay_filter * owd_filt, RunTimeOpts * rtOpts, PtpClock
 
 	if (twoStep) {
 		/* calc 'slave_to_master_delay' */
-		subTime(&ptpClock->pdelayMS, 
-			&ptpClock->pdelay_resp_receive_time, 
-			&ptpClock->pdelay_resp_send_time);
-		subTime(&ptpClock->pdelaySM, 
-			&ptpClock->pdelay_req_receive_time, 
-			&ptpClock->pdelay_req_send_time);
-
-		/* update 'one_way_delay' */
-		addTime(&ptpClock->peerMeanPathDelay, 
-			&ptpClock->pdelayMS, 
-			&ptpClock->pdelaySM);
-
-		/* Substract correctionField */
-		subTime(&ptpClock->peerMeanPathDelay, 
-			&ptpClock->peerMeanPathDelay, correctionField);
-
-		/* Compute one-way delay */
-		ptpClock->peerMeanPathDelay.seconds /= 2;
-		ptpClock->peerMeanPathDelay.nanoseconds /= 2;
+		ptpClock->pdelayMS = ptpClock->pdelay_resp_receive_time - 
+			ptpClock->pdelay_resp_send_time;
+		ptpClock->pdelaySM = ptpClock->pdelay_req_receive_time - 
+			ptpClock->pdelay_req_send_time;
+
+		/* update 'one_way_delay', substracting the correctionField */
+		ptpClock->peerMeanPathDelay = ptpClock->pdelayMS + 
+			ptpClock->pdelaySM - correctionField;
 	} else {
 		/* One step clock */
 
-		subTime(&ptpClock->peerMeanPathDelay, 
-			&ptpClock->pdelay_resp_receive_time, 
-			&ptpClock->pdelay_req_send_time);
-
-		/* Substract correctionField */
-		subTime(&ptpClock->peerMeanPathDelay, 
-			&ptpClock->peerMeanPathDelay, correctionField);
-
-		/* Compute one-way delay */
-		ptpClock->peerMeanPathDelay.seconds /= 2;
-		ptpClock->peerMeanPathDelay.nanoseconds /= 2;
+		ptpClock->peerMeanPathDelay = 
+			ptpClock->pdelay_resp_receive_time - 
+			ptpClock->pdelay_req_send_time - correctionField;
 	}
 
-	if (ptpClock->peerMeanPathDelay.seconds) {
+	/* Compute one-way delay */
+	ptpClock->peerMeanPathDelay /= 2;
+
+	if (llabs(ptpClock->peerMeanPathDelay) >= 1000000000) {
 		/* cannot filter with secs, clear filter */
 		owd_filt->s_exp = owd_filt->nsec_prev = 0;
 		return;
@@ -180,77 +546,75 @@ updatePeerDelay(one_way_delay_filter * owd_filt, RunTimeOpts * rtOpts, PtpClock
 	/* filter 'meanPathDelay' */
 	owd_filt->y = (owd_filt->s_exp - 1) * 
 		owd_filt->y / owd_filt->s_exp +
-		(ptpClock->peerMeanPathDelay.nanoseconds / 2 + 
+		(ptpClock->peerMeanPathDelay / 2 + 
 		 owd_filt->nsec_prev / 2) / owd_filt->s_exp;
 
-	owd_filt->nsec_prev = ptpClock->peerMeanPathDelay.nanoseconds;
-	ptpClock->peerMeanPathDelay.nanoseconds = owd_filt->y;
+	owd_filt->nsec_prev = ptpClock->peerMeanPathDelay;
+	ptpClock->peerMeanPathDelay = owd_filt->y;
 
 	DBGV("delay filter %d, %d\n", owd_filt->y, owd_filt->s_exp);
 }
 
 void 
-updateOffset(TimeInternal * send_time, TimeInternal * recv_time,
-    offset_from_master_filter * ofm_filt, RunTimeOpts * rtOpts, PtpClock * ptpClock, TimeInternal * correctionField)
+updateOffset(TimeNs send_time, TimeNs recv_time,
+    offset_from_master_filter * ofm_filt, RunTimeOpts * rtOpts, PtpClock * ptpClock, TimeNs correctionField)
 {
-	TimeInternal master_to_slave_delay;
+	TimeNs master_to_slave_delay;
 
 	DBGV("updateOffset\n");
 
 	/* calc 'master_to_slave_delay' */
-	subTime(&master_to_slave_delay, recv_time, send_time);
+	master_to_slave_delay = recv_time - send_time;
 
 	if (rtOpts->maxDelay) { /* If maxDelay is 0 then it's OFF */
-		if (master_to_slave_delay.seconds && rtOpts->maxDelay) {
+		if (llabs(master_to_slave_delay) >= 1000000000) {
 			INFO("updateOffset aborted, delay greater than 1"
 			     " second.");
 			msgDump(ptpClock);
 			return;
 		}
 
-		if (master_to_slave_delay.nanoseconds > rtOpts->maxDelay) {
-			INFO("updateOffset aborted, delay %d greater than "
+		if (master_to_slave_delay > rtOpts->maxDelay) {
+			INFO("updateOffset aborted, delay %lld greater than "
 			     "administratively set maximum %d\n",
-			     master_to_slave_delay.nanoseconds, 
+			     (long long)master_to_slave_delay, 
 			     rtOpts->maxDelay);
 			msgDump(ptpClock);
 			return;
 		}
 	}
 
-	ptpClock->master_to_slave_delay = master_to_slave_delay;
-
-	subTime(&ptpClock->delayMS, recv_time, send_time);
 	/* Used just for End to End mode. */
+	ptpClock->delayMS = master_to_slave_delay;
 
 	/* Take care about correctionField */
-	subTime(&ptpClock->master_to_slave_delay, 
-		&ptpClock->master_to_slave_delay, correctionField);
+	ptpClock->master_to_slave_delay = master_to_slave_delay - 
+		correctionField;
 
 	/* update 'offsetFromMaster' */
 	if (!rtOpts->E2E_mode) {
-		subTime(&ptpClock->offsetFromMaster, 
-			&ptpClock->master_to_slave_delay, 
-			&ptpClock->peerMeanPathDelay);
+		ptpClock->offsetFromMaster = ptpClock->master_to_slave_delay - 
+			ptpClock->peerMeanPathDelay;
 	} else {
 		/* (End to End mode) */
-		subTime(&ptpClock->offsetFromMaster, 
-			&ptpClock->master_to_slave_delay, 
-			&ptpClock->meanPathDelay);
+		ptpClock->offsetFromMaster = ptpClock->master_to_slave_delay - 
+			ptpClock->meanPathDelay;
 	}
 
-	if (ptpClock->offsetFromMaster.seconds) {
+	if (llabs(ptpClock->offsetFromMaster) >= 1000000000) {
 		/* cannot filter with secs, clear filter */
 		ofm_filt->nsec_prev = 0;
 		return;
 	}
-	/* filter 'offsetFromMaster' */
-	ofm_filt->y = ptpClock->offsetFromMaster.nanoseconds / 2 + 
-		ofm_filt->nsec_prev / 2;
-	ofm_filt->nsec_prev = ptpClock->offsetFromMaster.nanoseconds;
-	ptpClock->offsetFromMaster.nanoseconds = ofm_filt->y;
-
-	DBGV("offset filter %d\n", ofm_filt->y);
+	/* filter 'offsetFromMaster', unless the servo does */
+	if (!servos[rtOpts->servo].rawOffset) {
+		ofm_filt->y = ptpClock->offsetFromMaster / 2 + 
+			ofm_filt->nsec_prev / 2;
+		ofm_filt->nsec_prev = ptpClock->offsetFromMaster;
+		ptpClock->offsetFromMaster = ofm_filt->y;
+
+		DBGV("offset filter %d\n", ofm_filt->y);
+	}
 
 	/*
 	 * Offset must have been computed at least one time before 
@@ -271,7 +635,7 @@ updateClock(RunTimeOpts * rtOpts, PtpClock * ptpClock)
 
         /* If maxAdjust is 0 then there is no limit */
 	if (!rtOpts->noAdjust && rtOpts->maxAdjust) {
-		if (ptpClock->offsetFromMaster.seconds || abs(ptpClock->offsetFromMaster.nanoseconds) > rtOpts->maxAdjust) {
+		if (llabs(ptpClock->offsetFromMaster) > rtOpts->maxAdjust) {
 			INFO("updateClock aborted, offset exceeds administratively set maximum %dns\n",
 				rtOpts->maxAdjust);
 			msgDump(ptpClock);
@@ -281,52 +645,63 @@ updateClock(RunTimeOpts * rtOpts, PtpClock * ptpClock)
 
 	/* if got here, maxAdjust is either unlimited or we are not past the limit */
 	/* if over limit, reset clock or set freq adjustment to max */
-	if (rtOpts->maxStep && (ptpClock->offsetFromMaster.seconds || abs(ptpClock->offsetFromMaster.nanoseconds) > rtOpts->maxStep)) {
+	if (rtOpts->maxStep && llabs(ptpClock->offsetFromMaster) > rtOpts->maxStep) {
 		/* the offset is past the step limit, so step the clock */
 		if (!rtOpts->noAdjust) {
+			if (rtOpts->kernelPll)
+				clearKernelOffset();
 			getTime(&timeTmp);
-			subTime(&timeTmp, &timeTmp, &ptpClock->offsetFromMaster);
+			nsToInternalTime(internalTimeToNs(&timeTmp) - 
+					 ptpClock->offsetFromMaster, &timeTmp);
 			setTime(&timeTmp);
 			initClock(rtOpts, ptpClock);
 
-			double offset = ((double)ptpClock->offsetFromMaster.nanoseconds / 1000000000) + ptpClock->offsetFromMaster.seconds;
+			double offset = (double)ptpClock->offsetFromMaster / 1000000000;
 			NOTIFY("clock stepped, off by %.6lf seconds", offset);
 
 		}
 	}
-	else if (ptpClock->offsetFromMaster.seconds) {
+	else if (llabs(ptpClock->offsetFromMaster) >= 1000000000) {
 		/* options don't allow stepping the clock, so set to max frequency offset */
 		if (!rtOpts->noAdjust) {
-			adj = ptpClock->offsetFromMaster.nanoseconds > 0 ? ADJ_FREQ_MAX : -ADJ_FREQ_MAX;
+			/* the PLL would fight it, adjOffset() starts it again */
+			if (rtOpts->kernelPll)
+				stopKernelPll();
+			adj = ptpClock->offsetFromMaster > 0 ? ADJ_FREQ_MAX : -ADJ_FREQ_MAX;
 			adjFreq(-adj);
+			ptpClock->adjustment = adj;
 		}
 
+	} else if (!ptpClock->startup.locked) {
+		servoStartup(rtOpts, ptpClock);
+	} else if (rtOpts->kernelPll) {
+		/* 
+		 * the kernel slews the offset out between Syncs and
+		 * corrects the frequency itself, the servo is not run
+		 */
+		if (!rtOpts->noAdjust) {
+			if (adjOffset(ptpClock->offsetFromMaster, &adj)) {
+				ptpClock->adjustment = -adj;
+				ptpClock->observed_drift = -adj;
+			} else
+				PERROR("failed to pass the offset to the kernel PLL");
+		}
 	} else {
-		/* the PI controller */
-
-		/* no negative or zero attenuation */
-		if (rtOpts->ap < 1)
-			rtOpts->ap = 1;
-		if (rtOpts->ai < 1)
-			rtOpts->ai = 1;
-
-		/* the accumulator for the I component */
-		ptpClock->observed_drift += 
-			ptpClock->offsetFromMaster.nanoseconds / rtOpts->ai;
-
-		/* clamp the accumulator to ADJ_FREQ_MAX for sanity */
-		if (ptpClock->observed_drift > ADJ_FREQ_MAX)
-			ptpClock->observed_drift = ADJ_FREQ_MAX;
-		else if (ptpClock->observed_drift < -ADJ_FREQ_MAX)
-			ptpClock->observed_drift = -ADJ_FREQ_MAX;
-
-		adj = ptpClock->offsetFromMaster.nanoseconds / rtOpts->ap + 
-			ptpClock->observed_drift;
+		adj = servos[rtOpts->servo].sample(ptpClock->offsetFromMaster,
+						   ptpClock->sync_receive_time,
+						   rtOpts, ptpClock);
+		if (adj > ADJ_FREQ_MAX)
+			adj = ADJ_FREQ_MAX;
+		else if (adj < -ADJ_FREQ_MAX)
+			adj = -ADJ_FREQ_MAX;
 
 		/* apply controller output as a clock tick rate adjustment */
-		if (!rtOpts->noAdjust)
+		if (!rtOpts->noAdjust) {
 			adjFreq(-adj);
+			ptpClock->adjustment = adj;
+		}
 	}
+	servoConvergence(ptpClock);
 
 display:
 	if (rtOpts->displayStats)
@@ -334,24 +709,20 @@ display:
 
 
 	DBG("\n--Offset Correction-- \n");
-	DBG("Raw offset from master:  %10ds %11dns\n",
-	    ptpClock->master_to_slave_delay.seconds, 
-	    ptpClock->master_to_slave_delay.nanoseconds);
+	DBG("Raw offset from master:  %14lldns\n",
+	    (long long)ptpClock->master_to_slave_delay);
 
 	DBG("\n--Offset and Delay filtered-- \n");
 
 	if (!rtOpts->E2E_mode) {
-		DBG("one-way delay averaged (P2P):  %10ds %11dns\n",
-		    ptpClock->peerMeanPathDelay.seconds, 
-		    ptpClock->peerMeanPathDelay.nanoseconds);
+		DBG("one-way delay averaged (P2P):  %14lldns\n",
+		    (long long)ptpClock->peerMeanPathDelay);
 	} else {
-		DBG("one-way delay averaged (E2E):  %10ds %11dns\n",
-		    ptpClock->meanPathDelay.seconds, 
-		    ptpClock->meanPathDelay.nanoseconds);
+		DBG("one-way delay averaged (E2E):  %14lldns\n",
+		    (long long)ptpClock->meanPathDelay);
 	}
 
-	DBG("offset from master:      %10ds %11dns\n",
-	    ptpClock->offsetFromMaster.seconds, 
-	    ptpClock->offsetFromMaster.nanoseconds);
+	DBG("offset from master:      %14lldns\n",
+	    (long long)ptpClock->offsetFromMaster);
 	DBG("observed drift:          %10d\n", ptpClock->observed_drift);
 }
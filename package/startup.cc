@@ -10,95 +10,203 @@
 
 #include "ptpd.hh"
 
-PtpClock *ptpClock;
-
-void 
-catch_close(int sig)
+/** 
+ * Log output to a file
+ * 
+ * 
+ * @return True if success, False if failure
+ */
+int 
+logToFile(RunTimeOpts * rtOpts)
 {
-	ptpdShutdown();
-
-	switch (sig) {
-	case SIGINT:
-		NOTIFY("shutdown on interrupt signal\n");
-		break;
-	case SIGTERM:
-		NOTIFY("shutdown on terminate signal\n");
-		break;
-	default:
-		NOTIFY("shutdown on ? signal\n");
+	if(rtOpts->logFd != -1)
+		close(rtOpts->logFd);
+	
+	if((rtOpts->logFd = creat(rtOpts->logFile, 0444)) != -1) {
+		dup2(rtOpts->logFd, STDOUT_FILENO);
+		dup2(rtOpts->logFd, STDERR_FILENO);
 	}
-	exit(0);
+	return rtOpts->logFd != -1;
 }
 
 /** 
- * Signal handler for HUP which tells us to swap the log file.
+ * Record quality data for later correlation
+ * 
  * 
- * @param sig 
+ * @return True if success, False if failure
  */
-void 
-catch_sighup(int sig)
+int
+recordToFile(RunTimeOpts * rtOpts)
 {
-	if(!logToFile())
-		NOTIFY("SIGHUP logToFile failed\n");
-	if(!recordToFile())
-		NOTIFY("SIGHUP recordToFile failed\n");
+	if (rtOpts->recordFP != NULL)
+		fclose(rtOpts->recordFP);
 
-	NOTIFY("I've been SIGHUP'd\n");
+	if ((rtOpts->recordFP = fopen(rtOpts->recordFile, "w")) == NULL)
+		PERROR("could not open sync recording file");
+	else
+		setlinebuf(rtOpts->recordFP);
+	return (rtOpts->recordFP != NULL);
 }
 
 /** 
- * Log output to a file
- * 
+ * Checkpoint what a restart needs to get back in sync quickly: the
+ * frequency adjustment, the path delay and whose it is. Only a slave
+ * whose servo is in charge has anything worth keeping. The file is
+ * written beside the old one, synced and renamed over it, so a crash
+ * of the process or the host leaves the old or the new one, never half
+ * of it.
  * 
  * @return True if success, False if failure
  */
-int 
-logToFile()
+bool 
+stateSave(RunTimeOpts * rtOpts, PtpClock * ptpClock)
 {
-	extern RunTimeOpts rtOpts;
-	if(rtOpts.logFd != -1)
-		close(rtOpts.logFd);
-	
-	if((rtOpts.logFd = creat(rtOpts.logFile, 0444)) != -1) {
-		dup2(rtOpts.logFd, STDOUT_FILENO);
-		dup2(rtOpts.logFd, STDERR_FILENO);
+	char tmp[PATH_MAX + 4], buf[160], parent[64];
+	int fd, len;
+	bool ok;
+
+	if (ptpClock->portState != PTP_SLAVE || !ptpClock->startup.locked)
+		return TRUE;
+
+	snprint_PortIdentity(parent, sizeof(parent), 
+			     &ptpClock->parentPortIdentity, NULL);
+	len = snprintf(buf, sizeof(buf), 
+		       "time %ld\ndrift %d\ndelay %lld\nparent %s\n",
+		       (long)time(NULL), ptpClock->observed_drift,
+		       (long long)(rtOpts->E2E_mode ? ptpClock->meanPathDelay : 
+				   ptpClock->peerMeanPathDelay),
+		       parent);
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", rtOpts->stateFile);
+	if ((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+		PERROR("could not write state file %s", tmp);
+		return FALSE;
 	}
-	return rtOpts.logFd != -1;
+	ok = write(fd, buf, len) == len;
+	/* on disk before the rename, or a power loss may leave it empty */
+	ok = ok && !fsync(fd);
+	ok = !close(fd) && ok;
+	if (!ok || rename(tmp, rtOpts->stateFile) < 0) {
+		PERROR("could not write state file %s", rtOpts->stateFile);
+		unlink(tmp);
+		return FALSE;
+	}
+	DBGV("state saved to %s\n", rtOpts->stateFile);
+	return TRUE;
 }
 
 /** 
- * Record quality data for later correlation
+ * Read back what stateSave() wrote, unless it is missing, malformed or
+ * older than STATE_MAX_AGE. The drift is applied at once by initClock(),
+ * the rest by stateWarmStart() once there is a parent.
  * 
- * 
- * @return True if success, False if failure
+ * @return True if there was a state to start from
  */
-int
-recordToFile()
+bool 
+stateLoad(RunTimeOpts * rtOpts, PtpClock * ptpClock)
 {
-	extern RunTimeOpts rtOpts;
+	FILE *fp;
+	long saved, now;
+	int drift;
+	long long delay;
+	unsigned int id[CLOCK_IDENTITY_LENGTH], port;
+	int i;
 
-	if (rtOpts.recordFP != NULL)
-		fclose(rtOpts.recordFP);
+	if (!(fp = fopen(rtOpts->stateFile, "r"))) {
+		if (errno != ENOENT)
+			PERROR("could not read state file %s", rtOpts->stateFile);
+		return FALSE;
+	}
+	i = fscanf(fp, "time %ld drift %d delay %lld "
+		   "parent %2x%2x%2x%2x%2x%2x%2x%2x/%x", 
+		   &saved, &drift, &delay, &id[0], &id[1], &id[2], &id[3],
+		   &id[4], &id[5], &id[6], &id[7], &port);
+	fclose(fp);
+	if (i != 12) {
+		WARNING("ignoring malformed state file %s\n", rtOpts->stateFile);
+		return FALSE;
+	}
+	now = time(NULL);
+	if (saved > now || now - saved > STATE_MAX_AGE) {
+		INFO("ignoring state file %s from %ld s ago\n", 
+		     rtOpts->stateFile, now - saved);
+		return FALSE;
+	}
 
-	if ((rtOpts.recordFP = fopen(rtOpts.recordFile, "w")) == NULL)
-		PERROR("could not open sync recording file");
+	if (drift > ADJ_FREQ_MAX)
+		drift = ADJ_FREQ_MAX;
+	else if (drift < -ADJ_FREQ_MAX)
+		drift = -ADJ_FREQ_MAX;
+	ptpClock->observed_drift = drift;
+	ptpClock->warmStartDelay = delay;
+	for (i = 0; i < CLOCK_IDENTITY_LENGTH; i++)
+		ptpClock->warmStartParent.clockIdentity[i] = id[i];
+	ptpClock->warmStartParent.portNumber = port;
+	ptpClock->warmStart = TRUE;
+
+	NOTIFY("warm start from %s: drift %d ppb, delay %lld ns\n", 
+	       rtOpts->stateFile, drift, delay);
+	return TRUE;
+}
+
+/** 
+ * On becoming a slave for the first time: with the parent of the state
+ * file, start from its path delay and with the servo in charge, as the
+ * frequency is already known. Anything else starts cold.
+ */
+void 
+stateWarmStart(RunTimeOpts * rtOpts, PtpClock * ptpClock)
+{
+	if (!ptpClock->warmStart)
+		return;
+	ptpClock->warmStart = FALSE;
+
+	if (memcmp(ptpClock->warmStartParent.clockIdentity,
+		   ptpClock->parentPortIdentity.clockIdentity,
+		   CLOCK_IDENTITY_LENGTH) ||
+	    ptpClock->warmStartParent.portNumber != 
+	    ptpClock->parentPortIdentity.portNumber) {
+		INFO("parent changed since the state file was written\n");
+		return;
+	}
+	if (rtOpts->E2E_mode)
+		ptpClock->meanPathDelay = ptpClock->warmStartDelay;
 	else
-		setlinebuf(rtOpts.recordFP);
-	return (rtOpts.recordFP != NULL);
+		ptpClock->peerMeanPathDelay = ptpClock->warmStartDelay;
+	ptpClock->startup.locked = TRUE;
 }
 
 void 
-ptpdShutdown()
+ptpdShutdown(PtpClock * ptpClock, RunTimeOpts * rtOpts)
 {
+	if (rtOpts->stateFile[0])
+		stateSave(rtOpts, ptpClock);
+	if (rtOpts->kernelPll && !rtOpts->noAdjust) {
+		stopKernelPll();
+		restoreKernelStatus(ptpClock->kernelStatus);
+	}
+
 	netShutdown(&ptpClock->netPath);
 
+	if (rtOpts->recordFP != NULL) {
+		fclose(rtOpts->recordFP);
+		rtOpts->recordFP = NULL;
+	}
+
+	unicastShutdown(ptpClock);
 	free(ptpClock->foreign);
 	free(ptpClock);
 }
 
+/** 
+ * Allocate the engine data for one instance. Everything the engine
+ * keeps lives in the returned PtpClock and in 'rtOpts', so any number
+ * of instances can run side by side in one process.
+ */
 PtpClock *
 ptpdStartup(int argc, char **argv, Integer16 * ret, RunTimeOpts * rtOpts)
 {
+	PtpClock *ptpClock;
 	int c, nondaemon = 1; //SET TO ONE BY KENO
 	int noclose = 0;
 
@@ -136,15 +244,43 @@ ptpdStartup(int argc, char **argv, Integer16 * ret, RunTimeOpts * rtOpts)
 		}
 	}
 
+	if (!unicastInit(rtOpts, ptpClock)) {
+		*ret = 2;
+		free(ptpClock->foreign);
+		free(ptpClock);
+		return 0;
+	}
+
 	/* Init to 0 net buffer */
 	memset(ptpClock->msgIbuf, 0, PACKET_SIZE);
 	memset(ptpClock->msgObuf, 0, PACKET_SIZE);
 
 	ptpClock->observed_drift = 0;
+	if (rtOpts->stateFile[0])
+		stateLoad(rtOpts, ptpClock);
+	if (rtOpts->kernelPll && !rtOpts->noAdjust &&
+	    !getKernelStatus(&ptpClock->kernelStatus)) {
+		PERROR("failed to read the kernel clock status");
+		*ret = 2;
+		unicastShutdown(ptpClock);
+		free(ptpClock->foreign);
+		free(ptpClock);
+		return 0;
+	}
 
-	signal(SIGINT, catch_close);
-	signal(SIGTERM, catch_close);
-	signal(SIGHUP, catch_sighup);
+	/* 
+	 * signals belong to the process hosting the engine (the Click
+	 * driver), so no SIGINT/SIGTERM/SIGHUP handlers are installed
+	 */
+	if (rtOpts->useSysLog)
+		logUseSysLog();
+	if (rtOpts->recordFile[0] && !recordToFile(rtOpts)) {
+		*ret = 3;
+		unicastShutdown(ptpClock);
+		free(ptpClock->foreign);
+		free(ptpClock);
+		return 0;
+	}
 
 	*ret = 0;
 
@@ -32,6 +32,21 @@ snprint_TimeInternal(char *s, int max_len, const TimeInternal * p)
 }
 
 
+int 
+snprint_TimeNs(char *s, int max_len, TimeNs ns)
+{
+	int len = 0;
+
+	if (ns < 0)
+		len += snprintf(&s[len], max_len - len, "-");
+
+	len += snprintf(&s[len], max_len - len, "%lld.%09lld",
+	    llabs(ns) / 1000000000, llabs(ns) % 1000000000);
+
+	return len;
+}
+
+
 int 
 snprint_ClockIdentity(char *s, int max_len, const ClockIdentity id, const char *info)
 {
@@ -69,18 +84,58 @@ snprint_PortIdentity(char *s, int max_len, const PortIdentity *id, const char *i
 }
 
 
+int 
+snprint_NetAddress(char *s, int max_len, const NetAddress *addr)
+{
+	int len = 0;
+	int i;
+
+	if (!addr->len)
+		return snprintf(s, max_len, "none");
+
+	switch (addr->sa.sa_family) {
+	case AF_INET:
+		len += snprintf(&s[len], max_len - len, "%s", 
+				inet_ntoa(addr->in.sin_addr));
+		break;
+	case AF_INET6:
+		if (inet_ntop(AF_INET6, &addr->in6.sin6_addr, &s[len], max_len - len))
+			len += strlen(&s[len]);
+		break;
+	case AF_PACKET:
+		for (i = 0; i < addr->ll.sll_halen; i++)
+			len += snprintf(&s[len], max_len - len, i ? ":%02x" : "%02x", 
+					addr->ll.sll_addr[i]);
+		break;
+	default:
+		len += snprintf(&s[len], max_len - len, "?");
+		break;
+	}
+	return len;
+}
+
+
+/* 
+ * syslog is a per-process resource, so the log sink is shared by all
+ * engine instances; once one instance asks for syslog it stays on
+ */
+static bool logToSysLog = FALSE;
+
+void
+logUseSysLog(void)
+{
+	if (!logToSysLog) {
+		openlog("ptpd", 0, LOG_USER);
+		logToSysLog = TRUE;
+	}
+}
+
 void
 message(int priority, const char * format, ...)
 {
-	extern RunTimeOpts rtOpts;
 	va_list ap;
 	va_start(ap, format);
-	if(rtOpts.useSysLog) {
-		static bool logOpened;
-		if(!logOpened) {
-			openlog("ptpd", 0, LOG_USER);
-			logOpened = TRUE;
-		}
+	if(logToSysLog) {
 		vsyslog(priority, format, ap);
 	} else {
 		fprintf(stderr, "(ptpd %s) ",
@@ -120,14 +175,13 @@ translatePortState(PtpClock *ptpClock)
 void 
 displayStats(RunTimeOpts * rtOpts, PtpClock * ptpClock)
 {
-	static int start = 1;
-	static char sbuf[SCREEN_BUFSZ];
+	char sbuf[SCREEN_BUFSZ];
 	int len = 0;
 	struct timeval now;
 	char time_str[MAXTIMESTR];
 
-	if (start && rtOpts->csvStats) {
-		start = 0;
+	if (!ptpClock->csvHeaderPrinted && rtOpts->csvStats) {
+		ptpClock->csvHeaderPrinted = TRUE;
 		printf("PTP_Timestamp, state, clock ID, one way delay, offset from master, "
 		       "slave to master, master to slave, drift, variance");
 		fflush(stdout);
@@ -165,8 +219,8 @@ displayStats(RunTimeOpts * rtOpts, PtpClock * ptpClock)
 			len += snprintf(sbuf + len, 
 					sizeof(sbuf) - len, "owd: ");
 
-		len += snprint_TimeInternal(sbuf + len, sizeof(sbuf) - len,
-		    &ptpClock->meanPathDelay);
+		len += snprint_TimeNs(sbuf + len, sizeof(sbuf) - len,
+		    ptpClock->meanPathDelay);
 
 		len += snprintf(sbuf + len, sizeof(sbuf) - len, ", ");
 
@@ -174,17 +228,17 @@ displayStats(RunTimeOpts * rtOpts, PtpClock * ptpClock)
 			len += snprintf(sbuf + len, sizeof(sbuf) - len, 
 					"ofm: ");
 
-		len += snprint_TimeInternal(sbuf + len, sizeof(sbuf) - len,
-		    &ptpClock->offsetFromMaster);
-
-		len += sprintf(sbuf + len,
-			       ", %s%d.%09d" ", %s%d.%09d",
-			       rtOpts->csvStats ? "" : "stm: ",
-			       ptpClock->delaySM.seconds,
-			       abs(ptpClock->delaySM.nanoseconds),
-			       rtOpts->csvStats ? "" : "mts: ",
-			       ptpClock->delayMS.seconds,
-			       abs(ptpClock->delayMS.nanoseconds));
+		len += snprint_TimeNs(sbuf + len, sizeof(sbuf) - len,
+		    ptpClock->offsetFromMaster);
+
+		len += snprintf(sbuf + len, sizeof(sbuf) - len, ", %s",
+				rtOpts->csvStats ? "" : "stm: ");
+		len += snprint_TimeNs(sbuf + len, sizeof(sbuf) - len,
+		    ptpClock->delaySM);
+		len += snprintf(sbuf + len, sizeof(sbuf) - len, ", %s",
+				rtOpts->csvStats ? "" : "mts: ");
+		len += snprint_TimeNs(sbuf + len, sizeof(sbuf) - len,
+		    ptpClock->delayMS);
 		
 		len += sprintf(sbuf + len, ", %s%d",
 		    rtOpts->csvStats ? "" : "drift: ", 
@@ -231,6 +285,19 @@ getTime(TimeInternal * time)
 
 }
 
+/* clock for timer deadlines, immune to setTime() and clock steps */
+void 
+getMonotonicTime(TimeInternal * time)
+{
+	struct timespec tp;
+	if (clock_gettime(CLOCK_MONOTONIC, &tp) < 0) {
+		PERROR("clock_gettime() failed, exiting.");
+		exit(0);
+	}
+	time->seconds = tp.tv_sec;
+	time->nanoseconds = tp.tv_nsec;
+}
+
 void 
 setTime(TimeInternal * time)
 {
@@ -260,7 +327,99 @@ adjFreq(Integer32 adj)
 		adj = -ADJ_FREQ_MAX;
 
 	t.modes = MOD_FREQUENCY;
-	t.freq = adj * ((1 << 16) / 1000);
+	/* scaled ppm, 2^-16 ppm */
+	t.freq = (long long)adj * (1 << 16) / 1000;
 
 	return !adjtimex(&t);
 }
+
+/*
+ * hand the offset from master to the kernel PLL, which slews it out
+ * over the next seconds and corrects the frequency by it (ADJ_OFFSET
+ * in ns, STA_PLL); 'adj' is set to the frequency the kernel now runs
+ * at, in ppb as given to adjFreq()
+ */
+bool 
+adjOffset(TimeNs offset, Integer32 * adj)
+{
+	struct timex t;
+
+	memset(&t, 0, sizeof(t));
+	if (adjtimex(&t) < 0)
+		return FALSE;
+
+	/* the kernel clamps the offset to +-0.5 s itself */
+	t.modes = ADJ_OFFSET | ADJ_NANO | ADJ_STATUS | ADJ_TIMECONST;
+	t.status = (t.status | STA_PLL) & ~(STA_FLL | STA_UNSYNC);
+	t.offset = -offset;
+	t.constant = KERNEL_PLL_CONSTANT;
+	if (adjtimex(&t) < 0)
+		return FALSE;
+
+	*adj = (long long)t.freq * 1000 / (1 << 16);
+	return TRUE;
+}
+
+/* 
+ * drop the offset the kernel PLL has left to slew, before the clock is
+ * stepped or the frequency set by hand; the kernel only takes it while
+ * STA_PLL is set
+ */
+bool 
+clearKernelOffset(void)
+{
+	struct timex t;
+
+	memset(&t, 0, sizeof(t));
+	t.modes = ADJ_OFFSET | ADJ_NANO;
+	t.offset = 0;
+	return adjtimex(&t) >= 0;
+}
+
+/* stop the kernel PLL, leaving the frequency where it had it */
+bool 
+stopKernelPll(void)
+{
+	struct timex t;
+
+	if (!clearKernelOffset())
+		return FALSE;
+
+	memset(&t, 0, sizeof(t));
+	if (adjtimex(&t) < 0)
+		return FALSE;
+	t.modes = ADJ_STATUS;
+	t.status &= ~STA_PLL;
+	return adjtimex(&t) >= 0;
+}
+
+/* the kernel clock status, to be given back to restoreKernelStatus() */
+bool 
+getKernelStatus(Integer32 * status)
+{
+	struct timex t;
+
+	memset(&t, 0, sizeof(t));
+	if (adjtimex(&t) < 0)
+		return FALSE;
+	*status = t.status;
+	return TRUE;
+}
+
+/* 
+ * undo what adjOffset() changed for the whole system: the PLL, FLL and
+ * unsynchronized bits and the ns or us units of the offset
+ */
+bool 
+restoreKernelStatus(Integer32 status)
+{
+	const Integer32 bits = STA_PLL | STA_FLL | STA_UNSYNC;
+	struct timex t;
+
+	memset(&t, 0, sizeof(t));
+	if (adjtimex(&t) < 0)
+		return FALSE;
+	t.modes = ADJ_STATUS | (status & STA_NANO ? ADJ_NANO : ADJ_MICRO);
+	t.status = (t.status & ~bits) | (status & bits);
+	return adjtimex(&t) >= 0;
+}
@@ -1,69 +1,75 @@
 /**
  * @file   timer.c
  * @date   Wed Jun 23 09:41:26 2010
- * 
+ *
  * @brief  The timers which run the state machine.
- * 
- * Timers in the PTP daemon are run off of the signal system.  
+ *
+ * Each timer holds an absolute deadline on the monotonic clock.
+ * timerUpdate() marks the timers whose deadline has passed, and
+ * timerNext() tells the caller how long it may sleep before the
+ * earliest deadline, so nothing needs to tick in between.
  */
 
 #include "ptpd.hh"
 
-/* This allows subsecond timer precision without an overwhelming number of interrupts */
-#define TIMERS_PER_SECOND 100     // normally 20
-#define TIMER_INTERVAL (1000000.0 / TIMERS_PER_SECOND)  /* Result is in microseconds */
-
-unsigned int elapsed;
-
-void 
-catch_alarm(int sig)
-{
-	elapsed++;
-	DBG("catch_alarm: elapsed %d\n", elapsed);
-}
-
 void 
-initTimer(void)
+timerUpdate(IntervalTimer * itimer)
 {
-	struct itimerval itimer;
-
-	DBG("initTimer\n");
-
-	signal(SIGALRM, SIG_IGN);
+	int i;
+	TimeInternal now;
 
-	elapsed = 0;
-	itimer.it_value.tv_sec = itimer.it_interval.tv_sec = floor(TIMER_INTERVAL / 1000000);
-	itimer.it_value.tv_usec = itimer.it_interval.tv_usec = fmod(TIMER_INTERVAL, 1000000);
+	getMonotonicTime(&now);
 
-	signal(SIGALRM, catch_alarm);
-	setitimer(ITIMER_REAL, &itimer, 0);
+	for (i = 0; i < TIMER_ARRAY_SIZE; ++i) {
+		if (!itimer[i].running || timeBefore(&now, &itimer[i].deadline))
+			continue;
+
+		/*
+		 * re-arm relative to the missed deadline to keep the
+		 * period, unless we fell more than a whole period behind
+		 */
+		addTime(&itimer[i].deadline, &itimer[i].deadline,
+			&itimer[i].interval);
+		if (timeBefore(&itimer[i].deadline, &now))
+			addTime(&itimer[i].deadline, &now, &itimer[i].interval);
+		itimer[i].expire = TRUE;
+		DBG("timerUpdate: timer %u expired\n", i);
+	}
 }
 
-void 
-timerUpdate(IntervalTimer * itimer)
+/**
+ * Time left until the earliest running timer expires
+ *
+ * @param itimer timer array
+ * @param delay  set to the time left, zero if a deadline has passed
+ *
+ * An expired timer is already re-armed for its next deadline, so a
+ * flag the current state never polls does not keep the caller awake.
+ *
+ * @return FALSE if no timer is running
+ */
+bool 
+timerNext(IntervalTimer * itimer, TimeInternal * delay)
 {
-	int i, kenken;
-	int delta;	
-	DBG("timerUpdate\n");
-	delta = elapsed;
-	elapsed = 0;
-        DBG("timer left      %f\n", itimer[2].left);
-        DBG("timer Interval  %f\n", itimer[2].interval);
-	DBG("Delta/Elapsed:  %d\n", delta);	
-	kenken = (itimer[2].left - delta);
-        DBG("66timer sub:      %d\n", kenken);
-	if (delta <= 0)
-	return;
-		
+	int i;
+	TimeInternal now;
+	IntervalTimer *next = NULL;
+
 	for (i = 0; i < TIMER_ARRAY_SIZE; ++i) {
-		if ((itimer[i].interval) > 0 && ((itimer[i].left) -= delta) <= 0) {
-			itimer[i].left = itimer[i].interval;
-			itimer[i].expire = TRUE;
-			DBG("timerUpdate: timer %u expired\n", i);
-		
-		}
+		if (!itimer[i].running)
+			continue;
+		if (!next || timeBefore(&itimer[i].deadline, &next->deadline))
+			next = &itimer[i];
 	}
+	if (!next)
+		return FALSE;
 
+	getMonotonicTime(&now);
+	if (timeBefore(&now, &next->deadline))
+		subTime(delay, &next->deadline, &now);
+	else
+		delay->seconds = delay->nanoseconds = 0;
+	return TRUE;
 }
 
 void 
@@ -72,18 +78,25 @@ timerStop(UInteger16 index, IntervalTimer * itimer)
 	if (index >= TIMER_ARRAY_SIZE)
 		return;
 
-	itimer[index].interval = 0;
+	itimer[index].running = FALSE;
+	itimer[index].expire = FALSE;
 }
 
 void 
 timerStart(UInteger16 index, float interval, IntervalTimer * itimer)
 {
+	TimeInternal now;
+
 	if (index >= TIMER_ARRAY_SIZE)
 		return;
 
+	itimer[index].interval.seconds = (Integer32) interval;
+	itimer[index].interval.nanoseconds =
+		(Integer32) ((interval - itimer[index].interval.seconds) * 1e9);
+	getMonotonicTime(&now);
+	addTime(&itimer[index].deadline, &now, &itimer[index].interval);
 	itimer[index].expire = FALSE;
-	itimer[index].left = interval * TIMERS_PER_SECOND;
-	itimer[index].interval = itimer[index].left;
+	itimer[index].running = TRUE;
 
 	DBG("timerStart: set timer %d to %.3f\n", index, interval);
 }
@@ -91,8 +104,6 @@ timerStart(UInteger16 index, float interval, IntervalTimer * itimer)
 bool 
 timerExpired(UInteger16 index, IntervalTimer * itimer)
 {
-	timerUpdate(itimer);
-
 	if (index >= TIMER_ARRAY_SIZE)
 		return FALSE;
 
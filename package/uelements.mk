@@ -12,6 +12,7 @@ servo.uo \
 startup.uo \
 sys.uo \
 timer.uo \
+unicast.uo \
 
 ELEMENT_OBJS__1 = \
  \
@@ -0,0 +1,710 @@
+/**
+ * @file   unicast.c
+ *
+ * @brief  Unicast negotiation (spec 16.1)
+ *
+ * Master side: slaves ask for Announce, Sync and DelayResp streams with
+ * REQUEST_UNICAST_TRANSMISSION TLVs, and every granted stream is sent to
+ * that slave alone until its grant runs out. The slaves are kept in a
+ * table found by port identity through an open addressing hash, and the
+ * next Announce or Sync of each grant (the expiry, for a DelayResp
+ * grant) is an entry of a binary min-heap, so a request, a send or an
+ * expiry costs O(log N) however many slaves there are.
+ *
+ * Slave side: the streams are asked for from rtOpts->unicastAddress,
+ * again every UNICAST_RETRY_INTERVAL until all are granted, then again
+ * half way through the granted duration.
+ */
+
+#include "ptpd.hh"
+
+
+/* FNV-1a over the port identity */
+static UInteger32
+unicastHashKey(const PortIdentity * portIdentity)
+{
+	UInteger32 h = 2166136261u;
+	int i;
+
+	for (i = 0; i < CLOCK_IDENTITY_LENGTH; i++)
+		h = (h ^ (UInteger8)portIdentity->clockIdentity[i]) * 16777619u;
+	h = (h ^ (portIdentity->portNumber & 0xFF)) * 16777619u;
+	h = (h ^ (portIdentity->portNumber >> 8)) * 16777619u;
+	return h;
+}
+
+static bool
+unicastSamePort(const PortIdentity * a, const PortIdentity * b)
+{
+	return a->portNumber == b->portNumber &&
+		!memcmp(a->clockIdentity, b->clockIdentity,
+			CLOCK_IDENTITY_LENGTH);
+}
+
+/* hash slot of 'portIdentity', or of the empty slot it would go in */
+static Integer32
+unicastSlot(const PortIdentity * portIdentity, PtpClock * ptpClock)
+{
+	Integer32 i = unicastHashKey(portIdentity) & ptpClock->unicastHashMask;
+
+	while (ptpClock->unicastHash[i] >= 0 &&
+	       !unicastSamePort(&ptpClock->unicastSlaves[ptpClock->unicastHash[i]].portIdentity,
+				portIdentity))
+		i = (i + 1) & ptpClock->unicastHashMask;
+	return i;
+}
+
+/* take slave entry 'slave' out of the hash, shifting back the entries after it */
+static void
+unicastUnhash(Integer32 slave, PtpClock * ptpClock)
+{
+	Integer32 *hash = ptpClock->unicastHash;
+	Integer32 mask = ptpClock->unicastHashMask;
+	Integer32 i, j, home;
+
+	i = unicastSlot(&ptpClock->unicastSlaves[slave].portIdentity, ptpClock);
+	for (;;) {
+		hash[i] = -1;
+		j = i;
+		do {
+			j = (j + 1) & mask;
+			if (hash[j] < 0)
+				return;
+			home = unicastHashKey(&ptpClock->unicastSlaves[hash[j]].portIdentity) & mask;
+			/* an entry whose home is cyclically in (i, j] stays */
+		} while (i <= j ? (i < home && home <= j) : (i < home || home <= j));
+		hash[i] = hash[j];
+		i = j;
+	}
+}
+
+
+/*
+ * the send schedule. heapPos of the grant of every entry is kept
+ * up to date so that a grant can be taken out or moved in O(log N)
+ */
+static void
+unicastHeapSet(Integer32 pos, UnicastEvent * ev, PtpClock * ptpClock)
+{
+	ptpClock->unicastHeap[pos] = *ev;
+	ptpClock->unicastSlaves[ev->slave].grant[ev->grant].heapPos = pos;
+}
+
+static void
+unicastHeapFix(Integer32 pos, PtpClock * ptpClock)
+{
+	UnicastEvent *heap = ptpClock->unicastHeap;
+	UnicastEvent ev = heap[pos];
+	Integer32 child;
+
+	/* up */
+	while (pos > 0 &&
+	       timeBefore(&ev.deadline, &heap[(pos - 1) / 2].deadline)) {
+		unicastHeapSet(pos, &heap[(pos - 1) / 2], ptpClock);
+		pos = (pos - 1) / 2;
+	}
+	/* down */
+	while ((child = 2 * pos + 1) < ptpClock->unicastHeapSize) {
+		if (child + 1 < ptpClock->unicastHeapSize &&
+		    timeBefore(&heap[child + 1].deadline, &heap[child].deadline))
+			child++;
+		if (!timeBefore(&heap[child].deadline, &ev.deadline))
+			break;
+		unicastHeapSet(pos, &heap[child], ptpClock);
+		pos = child;
+	}
+	unicastHeapSet(pos, &ev, ptpClock);
+}
+
+static void
+unicastHeapPush(TimeInternal * deadline, Integer32 slave, UInteger8 grant,
+		PtpClock * ptpClock)
+{
+	UnicastEvent *ev = &ptpClock->unicastHeap[ptpClock->unicastHeapSize];
+
+	ev->deadline = *deadline;
+	ev->slave = slave;
+	ev->grant = grant;
+	unicastHeapFix(ptpClock->unicastHeapSize++, ptpClock);
+}
+
+static void
+unicastHeapRemove(Integer32 pos, PtpClock * ptpClock)
+{
+	UnicastEvent *ev = &ptpClock->unicastHeap[pos];
+
+	ptpClock->unicastSlaves[ev->slave].grant[ev->grant].heapPos = -1;
+	if (pos == --ptpClock->unicastHeapSize)
+		return;
+	unicastHeapSet(pos, &ptpClock->unicastHeap[ptpClock->unicastHeapSize],
+		       ptpClock);
+	unicastHeapFix(pos, ptpClock);
+}
+
+
+/* 2^logInterMessagePeriod seconds */
+static void
+unicastPeriod(Integer8 logInterMessagePeriod, TimeInternal * period)
+{
+	if (logInterMessagePeriod >= 0) {
+		period->seconds = 1 << logInterMessagePeriod;
+		period->nanoseconds = 0;
+	} else {
+		period->seconds = 0;
+		period->nanoseconds = 1000000000 >> -logInterMessagePeriod;
+	}
+}
+
+/* the grant type of a messageType, UNICAST_GRANT_TYPES if it has none */
+static UInteger8
+unicastGrantType(Enumeration4 messageType)
+{
+	switch (messageType) {
+	case ANNOUNCE:
+		return UNICAST_ANNOUNCE;
+	case SYNC:
+		return UNICAST_SYNC;
+	case DELAY_RESP:
+		return UNICAST_DELAY_RESP;
+	default:
+		return UNICAST_GRANT_TYPES;
+	}
+}
+
+/* end grant 'type' of 'slave', and free the slave once it has none left */
+static void
+unicastRelease(Integer32 slave, UInteger8 type, PtpClock * ptpClock)
+{
+	UnicastSlave *s = &ptpClock->unicastSlaves[slave];
+	int i;
+
+	if (!s->grant[type].granted)
+		return;
+	if (s->grant[type].heapPos >= 0)
+		unicastHeapRemove(s->grant[type].heapPos, ptpClock);
+	s->grant[type].granted = FALSE;
+
+	for (i = 0; i < UNICAST_GRANT_TYPES; i++)
+		if (s->grant[i].granted)
+			return;
+	unicastUnhash(slave, ptpClock);
+	ptpClock->unicastFreeList[ptpClock->unicastFreeCount++] = slave;
+	DBG("unicast slave %d released\n", slave);
+}
+
+
+/**
+ * Allocate the grant table and send schedule of a negotiating master
+ *
+ * @return FALSE if out of memory
+ */
+bool
+unicastInit(RunTimeOpts * rtOpts, PtpClock * ptpClock)
+{
+	Integer32 hashSize = 1;
+
+	if (!rtOpts->unicastNegotiation)
+		return TRUE;
+
+	/* at most half full keeps the probe sequences short */
+	while (hashSize < 2 * rtOpts->unicastMaxSlaves)
+		hashSize <<= 1;
+	ptpClock->unicastHashMask = hashSize - 1;
+
+	ptpClock->unicastSlaves = (UnicastSlave *)
+		calloc(rtOpts->unicastMaxSlaves, sizeof(UnicastSlave));
+	ptpClock->unicastFreeList = (Integer32 *)
+		calloc(rtOpts->unicastMaxSlaves, sizeof(Integer32));
+	ptpClock->unicastHash = (Integer32 *)
+		calloc(hashSize, sizeof(Integer32));
+	ptpClock->unicastHeap = (UnicastEvent *)
+		calloc(rtOpts->unicastMaxSlaves * UNICAST_GRANT_TYPES,
+		       sizeof(UnicastEvent));
+	if (!ptpClock->unicastSlaves || !ptpClock->unicastFreeList ||
+	    !ptpClock->unicastHash || !ptpClock->unicastHeap) {
+		PERROR("failed to allocate memory for unicast grant table");
+		unicastShutdown(ptpClock);
+		return FALSE;
+	}
+	DBG("allocated unicast grant table for %d slaves\n",
+	    rtOpts->unicastMaxSlaves);
+
+	unicastReset(rtOpts, ptpClock);
+	return TRUE;
+}
+
+void
+unicastShutdown(PtpClock * ptpClock)
+{
+	free(ptpClock->unicastSlaves);
+	free(ptpClock->unicastFreeList);
+	free(ptpClock->unicastHash);
+	free(ptpClock->unicastHeap);
+	ptpClock->unicastSlaves = NULL;
+	ptpClock->unicastFreeList = NULL;
+	ptpClock->unicastHash = NULL;
+	ptpClock->unicastHeap = NULL;
+}
+
+/* drop all grants, on leaving PTP_MASTER the slaves have to ask again */
+void
+unicastReset(RunTimeOpts * rtOpts, PtpClock * ptpClock)
+{
+	Integer32 i;
+
+	memset(ptpClock->unicastGranted, 0, sizeof(ptpClock->unicastGranted));
+	ptpClock->unicastGrantedDuration = 0;
+
+	if (!ptpClock->unicastSlaves)
+		return;
+
+	for (i = 0; i <= ptpClock->unicastHashMask; i++)
+		ptpClock->unicastHash[i] = -1;
+	/* lowest entries are handed out first */
+	for (i = 0; i < rtOpts->unicastMaxSlaves; i++) {
+		memset(&ptpClock->unicastSlaves[i], 0, sizeof(UnicastSlave));
+		ptpClock->unicastFreeList[i] = rtOpts->unicastMaxSlaves - 1 - i;
+	}
+	ptpClock->unicastFreeCount = rtOpts->unicastMaxSlaves;
+	ptpClock->unicastHeapSize = 0;
+	for (i = 0; i < UNICAST_SYNC_RING; i++)
+		ptpClock->unicastSyncSlave[i] = -1;
+}
+
+
+/*
+ * answer a REQUEST_UNICAST_TRANSMISSION TLV from the sender of the
+ * message being handled. return the duration granted, 0 if denied
+ */
+static UInteger32
+unicastGrant(MsgHeader * header, MsgUnicastTLV * tlv,
+	     RunTimeOpts * rtOpts, PtpClock * ptpClock)
+{
+	UInteger8 type = unicastGrantType(tlv->messageType);
+	Integer8 logMin;
+	UInteger32 duration;
+	Integer32 slot, slave;
+	UnicastSlave *s;
+	UnicastGrant *grant;
+	TimeInternal now, interval;
+
+	if (type == UNICAST_GRANT_TYPES || !ptpClock->unicastSlaves ||
+	    !ptpClock->msgTmpSource.len)
+		return 0;
+	/* only a clock that is, or is about to be, master grants */
+	if (ptpClock->slaveOnly || ptpClock->clockQuality.clockClass == 255 ||
+	    (ptpClock->portState != PTP_MASTER &&
+	     ptpClock->portState != PTP_LISTENING)) {
+		DBGV("unicast request denied, not a master\n");
+		return 0;
+	}
+
+	switch (type) {
+	case UNICAST_ANNOUNCE:
+		logMin = ptpClock->logAnnounceInterval;
+		break;
+	case UNICAST_SYNC:
+		logMin = ptpClock->logSyncInterval;
+		break;
+	default:
+		logMin = ptpClock->logMinDelayReqInterval;
+		break;
+	}
+	if (tlv->logInterMessagePeriod < logMin ||
+	    tlv->logInterMessagePeriod > 16) {
+		DBGV("unicast request denied, period 2^%d\n",
+		     tlv->logInterMessagePeriod);
+		return 0;
+	}
+	duration = tlv->durationField;
+	if (duration > rtOpts->unicastDuration)
+		duration = rtOpts->unicastDuration;
+	if (!duration)
+		return 0;
+
+	slot = unicastSlot(&header->sourcePortIdentity, ptpClock);
+	slave = ptpClock->unicastHash[slot];
+	if (slave < 0) {
+		if (!ptpClock->unicastFreeCount) {
+			DBG("unicast request denied, grant table full\n");
+			return 0;
+		}
+		slave = ptpClock->unicastFreeList[--ptpClock->unicastFreeCount];
+		ptpClock->unicastHash[slot] = slave;
+		s = &ptpClock->unicastSlaves[slave];
+		memset(s, 0, sizeof(UnicastSlave));
+		s->portIdentity = header->sourcePortIdentity;
+		DBG("unicast slave %d added\n", slave);
+	}
+	s = &ptpClock->unicastSlaves[slave];
+	/* the slave may have moved */
+	s->addr = ptpClock->msgTmpSource;
+
+	grant = &s->grant[type];
+	getMonotonicTime(&now);
+	interval.seconds = duration;
+	interval.nanoseconds = 0;
+	addTime(&grant->expiry, &now, &interval);
+	grant->logInterMessagePeriod = tlv->logInterMessagePeriod;
+
+	if (!grant->granted) {
+		grant->granted = TRUE;
+		/* Announce and Sync go out right away, DelayResp only expires */
+		unicastHeapPush(type == UNICAST_DELAY_RESP ? &grant->expiry : &now,
+				slave, type, ptpClock);
+	} else if (type == UNICAST_DELAY_RESP) {
+		ptpClock->unicastHeap[grant->heapPos].deadline = grant->expiry;
+		unicastHeapFix(grant->heapPos, ptpClock);
+	}
+	return duration;
+}
+
+/* a GRANT_UNICAST_TRANSMISSION TLV from the master we asked */
+static void
+unicastGranted(MsgUnicastTLV * tlv, RunTimeOpts * rtOpts, PtpClock * ptpClock)
+{
+	UInteger8 type = unicastGrantType(tlv->messageType);
+
+	if (type == UNICAST_GRANT_TYPES || !ptpClock->netPath.unicastAddr.len)
+		return;
+	if (!tlv->durationField) {
+		DBG("unicast request for message type %d denied\n",
+		    tlv->messageType);
+		return;
+	}
+	DBG("unicast message type %d granted for %u s\n",
+	    tlv->messageType, tlv->durationField);
+	ptpClock->unicastGranted[type] = TRUE;
+	if (!ptpClock->unicastGrantedDuration ||
+	    tlv->durationField < ptpClock->unicastGrantedDuration)
+		ptpClock->unicastGrantedDuration = tlv->durationField;
+}
+
+/**
+ * Handle the unicast negotiation TLVs of a Signaling message
+ *
+ * Requests and cancels are answered with one Signaling message holding
+ * a TLV for each of them, sent back to where the message came from.
+ *
+ * @return FALSE if the answer can't be sent
+ */
+bool
+unicastHandleSignaling(MsgHeader * header, Octet * msgIbuf, ssize_t length,
+		       RunTimeOpts * rtOpts, PtpClock * ptpClock)
+{
+	MsgSignaling signaling;
+	MsgUnicastTLV tlv;
+	UInteger16 tlvLength, replyLength = SIGNALING_LENGTH;
+	UInteger8 type, all = 0xFF;
+	Octet *tlvBuf;
+	Integer32 slave;
+	ssize_t ret;
+	int i;
+
+	msgUnpackSignaling(msgIbuf, &signaling);
+	/* addressed to us or to all ports (all ones) */
+	for (i = 0; i < CLOCK_IDENTITY_LENGTH; i++)
+		all &= signaling.targetPortIdentity.clockIdentity[i];
+	if (!(all == 0xFF && signaling.targetPortIdentity.portNumber == 0xFFFF) &&
+	    !unicastSamePort(&signaling.targetPortIdentity, &ptpClock->portIdentity)) {
+		DBGV("Signaling message for another port\n");
+		return TRUE;
+	}
+
+	msgPackSignaling(ptpClock->msgObuf, &header->sourcePortIdentity,
+			 ptpClock);
+
+	for (tlvBuf = signaling.tlv;
+	     (tlvLength = msgUnpackUnicastTLV(tlvBuf, msgIbuf + length - tlvBuf, &tlv));
+	     tlvBuf += tlvLength) {
+		switch (tlv.tlvType) {
+		case REQUEST_UNICAST_TRANSMISSION:
+			tlv.durationField = unicastGrant(header, &tlv, rtOpts,
+							 ptpClock);
+			tlv.tlvType = GRANT_UNICAST_TRANSMISSION;
+			tlv.flags = tlv.durationField ? GRANT_RENEWAL_INVITED : 0;
+			break;
+
+		case CANCEL_UNICAST_TRANSMISSION:
+			type = unicastGrantType(tlv.messageType);
+			if (ptpClock->unicastSlaves && type != UNICAST_GRANT_TYPES) {
+				slave = ptpClock->unicastHash[unicastSlot(&header->sourcePortIdentity, ptpClock)];
+				if (slave >= 0)
+					unicastRelease(slave, type, ptpClock);
+			}
+			tlv.tlvType = ACKNOWLEDGE_CANCEL_UNICAST_TRANSMISSION;
+			break;
+
+		case GRANT_UNICAST_TRANSMISSION:
+			unicastGranted(&tlv, rtOpts, ptpClock);
+			continue;
+
+		default:
+			continue;
+		}
+		/* the answer must fit in one message */
+		if (replyLength + TLV_HEADER_LENGTH + GRANT_UNICAST_TLV_LENGTH <= PACKET_SIZE)
+			replyLength += msgPackUnicastTLV(ptpClock->msgObuf + replyLength,
+							 &tlv);
+	}
+
+	/* all streams we asked for granted: renew half way through */
+	if (ptpClock->unicastGranted[UNICAST_ANNOUNCE] &&
+	    ptpClock->unicastGranted[UNICAST_SYNC] &&
+	    (!rtOpts->E2E_mode || ptpClock->unicastGranted[UNICAST_DELAY_RESP]) &&
+	    ptpClock->unicastGrantedDuration) {
+		timerStart(UNICAST_REQUEST_TIMER,
+			   ptpClock->unicastGrantedDuration / 2.0,
+			   ptpClock->itimer);
+		ptpClock->unicastGrantedDuration = 0;
+	}
+
+	if (replyLength == SIGNALING_LENGTH || !ptpClock->msgTmpSource.len)
+		return TRUE;
+
+	msgPackMessageLength(ptpClock->msgObuf, replyLength);
+	msgPackUnicastFlag(ptpClock->msgObuf, TRUE);
+	ret = netSendGeneralTo(ptpClock->msgObuf, replyLength,
+			       &ptpClock->netPath, &ptpClock->msgTmpSource);
+	msgPackUnicastFlag(ptpClock->msgObuf, FALSE);
+	if (!ret) {
+		DBGV("Signaling message can't be sent -> FAULTY state \n");
+		return FALSE;
+	}
+	ptpClock->txMessages[SIGNALING]++;
+	ptpClock->sentSignalingSequenceId++;
+	return TRUE;
+}
+
+/**
+ * Ask the master at rtOpts->unicastAddress for Announce, Sync and, end
+ * to end, DelayResp, and retry in UNICAST_RETRY_INTERVAL unless the
+ * grants come back
+ *
+ * @return FALSE if the request can't be sent
+ */
+bool
+unicastRequest(RunTimeOpts * rtOpts, PtpClock * ptpClock)
+{
+	PortIdentity target;
+	MsgUnicastTLV tlv;
+	UInteger16 length = SIGNALING_LENGTH;
+	ssize_t ret;
+
+	if (!ptpClock->netPath.unicastAddr.len)
+		return TRUE;
+
+	/* we don't know the port identity of the master yet */
+	memset(target.clockIdentity, 0xFF, CLOCK_IDENTITY_LENGTH);
+	target.portNumber = 0xFFFF;
+	msgPackSignaling(ptpClock->msgObuf, &target, ptpClock);
+
+	memset(&tlv, 0, sizeof(tlv));
+	tlv.tlvType = REQUEST_UNICAST_TRANSMISSION;
+	tlv.durationField = rtOpts->unicastDuration;
+
+	tlv.messageType = ANNOUNCE;
+	tlv.logInterMessagePeriod = ptpClock->logAnnounceInterval;
+	length += msgPackUnicastTLV(ptpClock->msgObuf + length, &tlv);
+	tlv.messageType = SYNC;
+	tlv.logInterMessagePeriod = ptpClock->logSyncInterval;
+	length += msgPackUnicastTLV(ptpClock->msgObuf + length, &tlv);
+	if (rtOpts->E2E_mode) {
+		tlv.messageType = DELAY_RESP;
+		tlv.logInterMessagePeriod = ptpClock->logMinDelayReqInterval;
+		length += msgPackUnicastTLV(ptpClock->msgObuf + length, &tlv);
+	}
+
+	memset(ptpClock->unicastGranted, 0, sizeof(ptpClock->unicastGranted));
+	ptpClock->unicastGrantedDuration = 0;
+	timerStart(UNICAST_REQUEST_TIMER, UNICAST_RETRY_INTERVAL,
+		   ptpClock->itimer);
+
+	msgPackMessageLength(ptpClock->msgObuf, length);
+	msgPackUnicastFlag(ptpClock->msgObuf, TRUE);
+	ret = netSendGeneralTo(ptpClock->msgObuf, length, &ptpClock->netPath,
+			       &ptpClock->netPath.unicastAddr);
+	msgPackUnicastFlag(ptpClock->msgObuf, FALSE);
+	if (!ret) {
+		DBGV("Signaling message can't be sent -> FAULTY state \n");
+		return FALSE;
+	}
+	DBGV("unicast request sent\n");
+	ptpClock->txMessages[SIGNALING]++;
+	ptpClock->sentSignalingSequenceId++;
+	return TRUE;
+}
+
+
+/* send the Announce or Sync of grant 'type' to 'slave' */
+static bool
+unicastSend(Integer32 slave, UInteger8 type, RunTimeOpts * rtOpts,
+	    PtpClock * ptpClock)
+{
+	UnicastSlave *s = &ptpClock->unicastSlaves[slave];
+	Octet *buf;
+	PTP_Timestamp originPTP_Timestamp;
+	TimeInternal internalTime;
+	UInteger16 i;
+	ssize_t ret;
+
+	if (type == UNICAST_ANNOUNCE) {
+		buf = ptpClock->msgTemplate[ANNOUNCE];
+		msgPackSequenceId(buf, ptpClock->sentAnnounceSequenceId);
+		msgPackUnicastFlag(buf, TRUE);
+		ret = netSendGeneralTo(buf, ANNOUNCE_LENGTH,
+				       &ptpClock->netPath, &s->addr);
+		msgPackUnicastFlag(buf, FALSE);
+		if (!ret) {
+			DBGV("Announce message can't be sent -> FAULTY state \n");
+			return FALSE;
+		}
+		ptpClock->txMessages[ANNOUNCE]++;
+		ptpClock->sentAnnounceSequenceId++;
+		return TRUE;
+	}
+
+	getTime(&internalTime);
+	fromInternalTime(&internalTime, &originPTP_Timestamp);
+	buf = ptpClock->msgTemplate[SYNC];
+	msgPackSequenceId(buf, ptpClock->sentSyncSequenceId);
+	msgPackTimestamp(buf, &originPTP_Timestamp);
+
+	/* whose FollowUp it is, once the send time stamp is back */
+	i = ptpClock->sentSyncSequenceId & (UNICAST_SYNC_RING - 1);
+	ptpClock->unicastSyncSlave[i] = slave;
+	ptpClock->unicastSyncSeq[i] = ptpClock->sentSyncSequenceId;
+
+	msgPackUnicastFlag(buf, TRUE);
+	ret = netSendEventTo(buf, SYNC_LENGTH,
+			     &ptpClock->netPath, &s->addr);
+	msgPackUnicastFlag(buf, FALSE);
+	if (!ret) {
+		DBG("Sync message can't be sent -> FAULTY state \n");
+		return FALSE;
+	}
+	ptpClock->txMessages[SYNC]++;
+	ptpClock->sentSyncSequenceId++;
+	return TRUE;
+}
+
+/**
+ * Send the unicast Announce and Sync messages that are due, and drop
+ * the grants that ran out
+ *
+ * At most UNICAST_MAX_BURST messages go out per call; if more are due
+ * the engine is flagged as busy so that it runs again right away.
+ *
+ * @return FALSE if a message can't be sent
+ */
+bool
+unicastRun(RunTimeOpts * rtOpts, PtpClock * ptpClock)
+{
+	UnicastEvent *ev = ptpClock->unicastHeap;
+	UnicastGrant *grant;
+	TimeInternal now, period;
+	int sent = 0;
+
+	getMonotonicTime(&now);
+	while (ptpClock->unicastHeapSize && !timeBefore(&now, &ev->deadline)) {
+		grant = &ptpClock->unicastSlaves[ev->slave].grant[ev->grant];
+		if (!timeBefore(&now, &grant->expiry)) {
+			DBG("unicast grant %d of slave %d expired\n",
+			    ev->grant, ev->slave);
+			unicastRelease(ev->slave, ev->grant, ptpClock);
+			continue;
+		}
+		if (sent == UNICAST_MAX_BURST) {
+			ptpClock->message_activity = TRUE;
+			break;
+		}
+		if (!unicastSend(ev->slave, ev->grant, rtOpts, ptpClock))
+			return FALSE;
+		sent++;
+
+		/* keep the period, unless we fell a whole period behind */
+		unicastPeriod(grant->logInterMessagePeriod, &period);
+		addTime(&ev->deadline, &ev->deadline, &period);
+		if (timeBefore(&ev->deadline, &now))
+			addTime(&ev->deadline, &now, &period);
+		unicastHeapFix(0, ptpClock);
+	}
+	return TRUE;
+}
+
+/**
+ * Time left until unicastRun() has something to do
+ *
+ * @return FALSE if no grant is running
+ */
+bool
+unicastNext(PtpClock * ptpClock, TimeInternal * delay)
+{
+	TimeInternal now;
+
+	if (!ptpClock->unicastHeapSize)
+		return FALSE;
+
+	getMonotonicTime(&now);
+	if (timeBefore(&now, &ptpClock->unicastHeap[0].deadline))
+		subTime(delay, &ptpClock->unicastHeap[0].deadline, &now);
+	else
+		delay->seconds = delay->nanoseconds = 0;
+	return TRUE;
+}
+
+/* TRUE if 'portIdentity' holds a running grant of 'type' */
+bool
+unicastHasGrant(const PortIdentity * portIdentity, UInteger8 type,
+		PtpClock * ptpClock)
+{
+	Integer32 slave;
+
+	if (!ptpClock->unicastSlaves)
+		return FALSE;
+	slave = ptpClock->unicastHash[unicastSlot(portIdentity, ptpClock)];
+	return slave >= 0 && ptpClock->unicastSlaves[slave].grant[type].granted;
+}
+
+/**
+ * Send the FollowUp of unicast Sync 'sequenceId', which left at 'time',
+ * to the slave it went to
+ *
+ * @return FALSE if the FollowUp can't be sent
+ */
+bool
+unicastTxSync(UInteger16 sequenceId, TimeInternal * time,
+	      RunTimeOpts * rtOpts, PtpClock * ptpClock)
+{
+	Octet *buf = ptpClock->msgTemplate[FOLLOW_UP];
+	PTP_Timestamp preciseOriginPTP_Timestamp;
+	UInteger16 i = sequenceId & (UNICAST_SYNC_RING - 1);
+	Integer32 slave = ptpClock->unicastSyncSlave[i];
+	ssize_t ret;
+
+	if (slave < 0 || ptpClock->unicastSyncSeq[i] != sequenceId ||
+	    !ptpClock->unicastSlaves[slave].grant[UNICAST_SYNC].granted) {
+		DBG("unicastTxSync: stale time stamp for sequenceId %d\n",
+		    sequenceId);
+		return TRUE;
+	}
+	ptpClock->unicastSyncSlave[i] = -1;
+
+	/*Add latency*/
+	addTime(time, time, &rtOpts->outboundLatency);
+	fromInternalTime(time, &preciseOriginPTP_Timestamp);
+	msgPackSequenceId(buf, sequenceId);
+	msgPackTimestamp(buf, &preciseOriginPTP_Timestamp);
+
+	msgPackUnicastFlag(buf, TRUE);
+	ret = netSendGeneralTo(buf, FOLLOW_UP_LENGTH,
+			       &ptpClock->netPath,
+			       &ptpClock->unicastSlaves[slave].addr);
+	msgPackUnicastFlag(buf, FALSE);
+	if (!ret) {
+		DBGV("FollowUp message can't be sent -> FAULTY state \n");
+		return FALSE;
+	}
+	ptpClock->txMessages[FOLLOW_UP]++;
+	return TRUE;
+}